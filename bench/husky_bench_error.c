@@ -0,0 +1,129 @@
+/* Per-call cost of the helpers natives and embedders use: stack push/pop,
+ * memory read/write, frame enter/leave and state set on their success
+ * path, and a failing pop with how many times it calls `err_func`. Build
+ * from the repository root with
+ *
+ *   cc -O2 -Isrc -o husky_bench_error bench/husky_bench_error.c \
+ *      $(ls src/husky*.c | grep -v husky_main) -ldl -lpthread
+ *
+ * and run with an optional iteration count. Each figure is the best of
+ * `BENCH_ROUNDS` rounds. */
+
+#include "husky.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include <inttypes.h>
+
+#define BENCH_ROUNDS 7
+
+static u32_t bench_err_func (husky_t * husky)
+{
+  ++*(u64_t *)husky->ptr ;
+
+  return HUSKY_FAILURE ;
+}
+
+static u64_t bench_clock (void)
+{
+  struct timespec now ;
+
+  clock_gettime(CLOCK_MONOTONIC, &now) ;
+
+  return (u64_t)now.tv_sec * 1000000000 + now.tv_nsec ;
+}
+
+static void bench_report (const char * name, u64_t * times, u64_t ops)
+{
+  u64_t best = times[0] ;
+  int   i ;
+
+  for (i = 1 ; i < BENCH_ROUNDS ; ++i) {
+    if (times[i] < best)
+      best = times[i] ;
+  }
+
+  printf("%-16s %8.2f ns/op\n", name, (double)best / ops) ;
+}
+
+int main (int argc, char ** argv)
+{
+  u64_t          count = 1 < argc ? strtoull(argv[1], NULL, 0) : 10000000 ;
+  husky_t *      husky = husky_create(NULL) ;
+  husky_object_t object ;
+  u64_t          times [5][BENCH_ROUNDS] ;
+  u64_t          start, i, sum = 0, errors = 0 ;
+  int            round ;
+
+  if (NULL == husky) {
+    fprintf(stderr, "Error: Cannot create the instance.\n") ;
+    return EXIT_FAILURE ;
+  }
+
+  husky->sp = husky->fp = 0x1000 ;
+  object.u  = 1 ;
+
+  for (round = 0 ; round < BENCH_ROUNDS ; ++round) {
+    start = bench_clock() ;
+
+    for (i = 0 ; i < count ; ++i) {
+      husky_stack_push(husky, object) ;
+      husky_stack_pop(husky, &object) ;
+      sum += object.u ;
+    }
+
+    times[0][round] = bench_clock() - start ;
+    start = bench_clock() ;
+
+    for (i = 0 ; i < count ; ++i) {
+      husky_memory_write(husky, 0x800 + (i & 0xF8), sizeof(object), &object) ;
+      husky_memory_read(husky, 0x800 + (i & 0xF8), sizeof(object), &object) ;
+      sum += object.u ;
+    }
+
+    times[1][round] = bench_clock() - start ;
+    start = bench_clock() ;
+
+    for (i = 0 ; i < count ; ++i) {
+      husky_frame_enter(husky, 2) ;
+      husky_frame_leave(husky) ;
+    }
+
+    times[2][round] = bench_clock() - start ;
+    start = bench_clock() ;
+
+    for (i = 0 ; i < count ; ++i) {
+      sum += husky_state_set(husky, HUSKY_STATE_READY) ;
+    }
+
+    times[3][round] = bench_clock() - start ;
+
+    husky->sp       = 0 ;
+    husky->ptr      = &errors ;
+    husky->err_func = bench_err_func ;
+    errors          = 0 ;
+    start           = bench_clock() ;
+
+    for (i = 0 ; i < count ; ++i) {
+      sum += husky_stack_pop(husky, &object) ;
+      husky->err_code = HUSKY_SUCCESS ;
+    }
+
+    times[4][round] = bench_clock() - start ;
+
+    husky->sp       = husky->fp = 0x1000 ;
+    husky->err_func = NULL ;
+  }
+
+  bench_report("push + pop", times[0], count) ;
+  bench_report("write + read", times[1], count) ;
+  bench_report("enter + leave", times[2], count) ;
+  bench_report("state set", times[3], count) ;
+  bench_report("failed pop", times[4], count) ;
+
+  printf("%-16s %8.2f per failure\n", "err_func calls", (double)errors / count) ;
+
+  husky_destroy(husky) ;
+
+  return 0 != sum ? EXIT_SUCCESS : EXIT_FAILURE ;
+}
@@ -0,0 +1,959 @@
+/* Reference workloads for the interpreter, each a small image generated
+ * here: a dispatch-heavy loop, recursive `fib`, deep `CALL`/`RETURN`
+ * recursion, `ENTER`/`LEAVE` frame churn, a `LOAD`/`STORE` stream, string
+ * and number `PRINT`, untyped and typed native calls and `MEMORY_*` block
+ * copies, fills and compares, in range and out of it. Build from the
+ * repository root with
+ *
+ *   cc -O2 -rdynamic -Isrc -o husky_bench_suite bench/husky_bench_suite.c \
+ *      $(ls src/husky*.c | grep -v husky_main) -ldl -lpthread -lm
+ *
+ * where `-rdynamic` lets the images bind the natives defined below, and
+ * run as
+ *
+ *   husky_bench_suite [--jit] [--rounds N] [--write DIR] [NAME...]
+ *
+ * Each workload runs `N` rounds, 5 by default, on a fresh instance in a
+ * child process of its own and prints one JSON object per line: the
+ * steps of a round, the best time, steps per second, nanoseconds per step,
+ * the resident memory of the instance and the peak resident memory of the
+ * process. Images and counts are fixed, so runs are comparable across
+ * builds; `check` is false when the result on the stack is wrong. With
+ * `--write` the images are also saved as `DIR/NAME.img` for `husky`, which
+ * cannot run the native ones as it does not export their natives.
+ *
+ * `clone` serves requests from a 256 MiB instance that fills a 2 MiB table
+ * and stops on a breakpoint: each request reads a word of every page of
+ * the table, writes one and halts. It prints a line for a clone of the
+ * template per request and one for a fresh instance that loads the image
+ * from a file and fills the table first, with the time of a request
+ * including creating and destroying its instance. */
+
+#include "husky.h"
+#include "husky_bind.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <inttypes.h>
+#include <unistd.h>
+#include <sys/resource.h>
+#include <sys/wait.h>
+
+#define BENCH_ROUNDS      5
+#define BENCH_CODE_SIZE   1024
+#define BENCH_LABELS      8
+#define BENCH_FIXUPS      16
+
+#define BENCH_MEMORY_SIZE (8 << 20)
+#define BENCH_TEXT_ADDR   0x001000
+#define BENCH_DATA_ADDR   0x008000
+#define BENCH_STACK_ADDR  0x010000
+#define BENCH_ARRAY_ADDR  0x400000
+#define BENCH_ARRAY_SIZE  (512 << 10)
+
+#define BENCH_CLONE_MEMORY   (256 << 20)
+#define BENCH_CLONE_TABLE    (2 << 20)
+#define BENCH_CLONE_REQUESTS 32
+
+typedef struct bench_code_s bench_code_t ;
+typedef struct bench_s      bench_t      ;
+
+struct bench_code_s {
+  u8_t  data   [BENCH_CODE_SIZE] ;
+  u64_t size                     ;
+  u64_t labels [BENCH_LABELS]    ;
+  u64_t fixups [BENCH_FIXUPS][2] ;
+  u64_t fixup_count              ;
+  u32_t natives                  ;
+} ;
+
+struct bench_s {
+  const char * name ;
+  u64_t ( * build ) (bench_code_t *) ;
+  int ( * run ) (const bench_t *, u32_t, int, const char *) ;
+  u32_t recover ;
+} ;
+
+/* Untyped native: adds 1 to the top of the stack in place. */
+u32_t bench_native (husky_t * husky)
+{
+  husky_object_t * object = husky_stack_peek(husky, -1) ;
+
+  if (NULL != object)
+    ++object->u ;
+
+  return husky_error_check(husky) ;
+}
+
+/* Typed native: returns its argument plus 1. */
+u64_t bench_typed (husky_t * husky, husky_object_t * args)
+{
+  (void)husky ;
+
+  return args[0].u + 1 ;
+}
+
+const husky_signature_t bench_typed_signature = {
+  HUSKY_TYPE_U64       ,
+  1                    ,
+  { HUSKY_TYPE_U64 }   ,
+  HUSKY_SIGNATURE_PURE
+} ;
+
+/* Lets a workload with `recover` set carry on after an out-of-range block,
+ * leaving the error for it to read back with `ERROR_GET` and clear. */
+static u32_t bench_recover (husky_t * husky)
+{
+  return HUSKY_ERROR_OUT_OF_MEMORY == husky->err_code ? HUSKY_SUCCESS : HUSKY_FAILURE ;
+}
+
+/* Drops the output, so that `print` measures the interpreter rather than
+ * the terminal. */
+static void bench_sink (husky_t * husky, const char * data, u64_t size)
+{
+  (void)husky ;
+  (void)data  ;
+  (void)size  ;
+}
+
+static u64_t bench_clock (void)
+{
+  struct timespec now ;
+
+  clock_gettime(CLOCK_MONOTONIC, &now) ;
+
+  return (u64_t)now.tv_sec * 1000000000 + now.tv_nsec ;
+}
+
+static void bench_emit (bench_code_t * code, u8_t opr_code, u64_t opr_data, u32_t opr_size)
+{
+  code->data[code->size++] = opr_code ;
+
+  memcpy(code->data + code->size, &opr_data, opr_size) ;
+  code->size += opr_size ;
+}
+
+#define bench_op(__code, __name)           bench_emit(__code, HUSKY_INST_##__name, 0, 0)
+#define bench_op_8(__code, __name, __data)  bench_emit(__code, HUSKY_INST_##__name, (u64_t)(__data), 1)
+#define bench_op_16(__code, __name, __data) bench_emit(__code, HUSKY_INST_##__name, (u64_t)(__data), 2)
+#define bench_op_32(__code, __name, __data) bench_emit(__code, HUSKY_INST_##__name, (u64_t)(__data), 4)
+
+static void bench_label (bench_code_t * code, u32_t label)
+{
+  code->labels[label] = BENCH_TEXT_ADDR + code->size ;
+}
+
+/* Jumps and calls take a 32-bit offset from the next instruction, filled
+ * in by `bench_link` once every label is placed. */
+static void bench_branch (bench_code_t * code, u8_t opr_code, u32_t label)
+{
+  bench_emit(code, opr_code, 0, sizeof(u32_t)) ;
+
+  code->fixups[code->fixup_count][0] = code->size ;
+  code->fixups[code->fixup_count][1] = label ;
+  ++code->fixup_count ;
+}
+
+static void bench_link (bench_code_t * code)
+{
+  u64_t i ;
+
+  for (i = 0 ; i < code->fixup_count ; ++i) {
+    u64_t end = code->fixups[i][0] ;
+    i32_t rel = (i32_t)(code->labels[code->fixups[i][1]] - (BENCH_TEXT_ADDR + end)) ;
+
+    memcpy(code->data + end - sizeof(u32_t), &rel, sizeof(u32_t)) ;
+  }
+}
+
+/* `n - 1` for the counter on top, then loops to `label` while it is not
+ * 0 and drops it. */
+static void bench_count_down (bench_code_t * code, u32_t label)
+{
+  bench_op_8(code, PUSH_8, 1) ;
+  bench_op_16(code, EXCHANGE, -1) ;
+  bench_op(code, SUBTRACT) ;
+  bench_op_16(code, GET_AT_SP, -1) ;
+  bench_branch(code, HUSKY_INST_JUMP_IF_TRUE, label) ;
+  bench_op(code, POP) ;
+}
+
+/* Integer arithmetic with stack shuffling: `acc = ((acc * 3) + 7) ^ 0x5A`. */
+static u64_t bench_dispatch (bench_code_t * code)
+{
+  u64_t count = 5000000, acc = 1, i ;
+
+  bench_op_8(code, PUSH_8, 1) ;
+  bench_op_32(code, PUSH_32, count) ;
+  bench_label(code, 0) ;
+  bench_op_16(code, GET_AT_SP, -2) ;
+  bench_op_8(code, PUSH_8, 3) ;
+  bench_op(code, MULTIPLY) ;
+  bench_op_8(code, PUSH_8, 7) ;
+  bench_op(code, ADD) ;
+  bench_op_8(code, PUSH_8, 0x5A) ;
+  bench_op(code, BIT_XOR) ;
+  bench_op_16(code, SET_AT_SP, -2) ;
+  bench_count_down(code, 0) ;
+  bench_op(code, HALT) ;
+
+  for (i = 0 ; i < count ; ++i)
+    acc = ((acc * 3) + 7) ^ 0x5A ;
+
+  return acc ;
+}
+
+/* `fib(n)` with the argument replaced by the result, on the stack only. */
+static void bench_fib_body (bench_code_t * code, u32_t fib, u32_t base)
+{
+  bench_label(code, fib) ;
+  bench_op_16(code, GET_AT_SP, -2) ;
+  bench_op_8(code, PUSH_8, 2) ;
+  bench_op(code, IS_GREATER) ;
+  bench_branch(code, HUSKY_INST_JUMP_IF_TRUE, base) ;
+  bench_op_16(code, GET_AT_SP, -2) ;
+  bench_op_8(code, PUSH_8, 1) ;
+  bench_op_16(code, EXCHANGE, -1) ;
+  bench_op(code, SUBTRACT) ;
+  bench_branch(code, HUSKY_INST_CALL, fib) ;
+  bench_op_16(code, GET_AT_SP, -3) ;
+  bench_op_8(code, PUSH_8, 2) ;
+  bench_op_16(code, EXCHANGE, -1) ;
+  bench_op(code, SUBTRACT) ;
+  bench_branch(code, HUSKY_INST_CALL, fib) ;
+  bench_op(code, ADD) ;
+  bench_op_16(code, SET_AT_SP, -2) ;
+  bench_label(code, base) ;
+  bench_op(code, RETURN) ;
+}
+
+static u64_t bench_fib (bench_code_t * code)
+{
+  bench_op_8(code, PUSH_8, 30) ;
+  bench_branch(code, HUSKY_INST_CALL, 0) ;
+  bench_op(code, HALT) ;
+  bench_fib_body(code, 0, 1) ;
+
+  return 832040 ;
+}
+
+/* `sum(n) = n + sum(n - 1)` 100000 calls deep, 30 times over. */
+static u64_t bench_recursion (bench_code_t * code)
+{
+  u64_t depth = 100000 ;
+
+  bench_op_8(code, PUSH_8, 30) ;
+  bench_label(code, 0) ;
+  bench_op_32(code, PUSH_32, depth) ;
+  bench_branch(code, HUSKY_INST_CALL, 1) ;
+  bench_op(code, POP) ;
+  bench_count_down(code, 0) ;
+  bench_op_32(code, PUSH_32, depth) ;
+  bench_branch(code, HUSKY_INST_CALL, 1) ;
+  bench_op(code, HALT) ;
+
+  bench_label(code, 1) ;
+  bench_op_16(code, GET_AT_SP, -2) ;
+  bench_branch(code, HUSKY_INST_JUMP_IF_FALSE, 2) ;
+  bench_op_16(code, GET_AT_SP, -2) ;
+  bench_op_8(code, PUSH_8, 1) ;
+  bench_op_16(code, EXCHANGE, -1) ;
+  bench_op(code, SUBTRACT) ;
+  bench_branch(code, HUSKY_INST_CALL, 1) ;
+  bench_op_16(code, GET_AT_SP, -3) ;
+  bench_op(code, ADD) ;
+  bench_op_16(code, SET_AT_SP, -2) ;
+  bench_label(code, 2) ;
+  bench_op(code, RETURN) ;
+
+  return depth * (depth + 1) / 2 ;
+}
+
+/* A call per iteration to a function that goes through two locals. */
+static u64_t bench_frames (bench_code_t * code)
+{
+  u64_t count = 3000000 ;
+
+  bench_op_8(code, PUSH_8, 0) ;
+  bench_op_32(code, PUSH_32, count) ;
+  bench_label(code, 0) ;
+  bench_op_16(code, GET_AT_SP, -2) ;
+  bench_branch(code, HUSKY_INST_CALL, 1) ;
+  bench_op_16(code, SET_AT_SP, -2) ;
+  bench_count_down(code, 0) ;
+  bench_op(code, HALT) ;
+
+  bench_label(code, 1) ;
+  bench_op_16(code, ENTER, 2) ;
+  bench_op_16(code, GET_AT_FP, -3) ;
+  bench_op_16(code, SET_AT_FP, 0) ;
+  bench_op_16(code, GET_AT_FP, 0) ;
+  bench_op_8(code, PUSH_8, 1) ;
+  bench_op(code, ADD) ;
+  bench_op_16(code, SET_AT_FP, 1) ;
+  bench_op_16(code, GET_AT_FP, 1) ;
+  bench_op_16(code, SET_AT_FP, -3) ;
+  bench_op(code, LEAVE) ;
+  bench_op(code, RETURN) ;
+
+  return count ;
+}
+
+/* `a[i] += 8 * i` over 512 KiB of 64-bit words, 40 passes. */
+static u64_t bench_memory (bench_code_t * code)
+{
+  u64_t passes = 40 ;
+
+  bench_op_8(code, PUSH_8, passes) ;
+  bench_label(code, 0) ;
+  bench_op_8(code, PUSH_8, 0) ;
+  bench_label(code, 1) ;
+  bench_op_16(code, GET_AT_SP, -1) ;
+  bench_op_32(code, PUSH_32, BENCH_ARRAY_ADDR) ;
+  bench_op(code, ADD) ;
+  bench_op_16(code, GET_AT_SP, -1) ;
+  bench_op(code, LOAD_64) ;
+  bench_op_16(code, GET_AT_SP, -3) ;
+  bench_op(code, ADD) ;
+  bench_op_16(code, EXCHANGE, -1) ;
+  bench_op(code, STORE_64) ;
+  bench_op_8(code, PUSH_8, 8) ;
+  bench_op(code, ADD) ;
+  bench_op_16(code, GET_AT_SP, -1) ;
+  bench_op_32(code, PUSH_32, BENCH_ARRAY_SIZE) ;
+  bench_op(code, IS_NOT_EQUAL) ;
+  bench_branch(code, HUSKY_INST_JUMP_IF_TRUE, 1) ;
+  bench_op(code, POP) ;
+  bench_count_down(code, 0) ;
+  bench_op_32(code, PUSH_32, BENCH_ARRAY_ADDR + BENCH_ARRAY_SIZE - 8) ;
+  bench_op(code, LOAD_64) ;
+  bench_op(code, HALT) ;
+
+  return passes * (BENCH_ARRAY_SIZE - 8) ;
+}
+
+/* A string, a number and a newline per iteration, to a sink that only
+ * counts the bytes. */
+static u64_t bench_print (bench_code_t * code)
+{
+  u64_t count = 1000000 ;
+
+  bench_op_32(code, PUSH_32, count) ;
+  bench_label(code, 0) ;
+  bench_op_32(code, PUSH_32, BENCH_DATA_ADDR) ;
+  bench_op_8(code, PUSH_8, 5) ;
+  bench_op(code, PRINT) ;
+  bench_op_16(code, GET_AT_SP, -1) ;
+  bench_op_8(code, PUSH_8, 0) ;
+  bench_op(code, PRINT) ;
+  bench_op_8(code, PUSH_8, '\n') ;
+  bench_op_8(code, PUSH_8, 4) ;
+  bench_op(code, PRINT) ;
+  bench_count_down(code, 0) ;
+  bench_op_8(code, PUSH_8, 0) ;
+  bench_op(code, HALT) ;
+
+  return 0 ;
+}
+
+static u64_t bench_native_loop (bench_code_t * code, u64_t native)
+{
+  u64_t count = 5000000 ;
+
+  bench_op_8(code, PUSH_8, 0) ;
+  bench_op_32(code, PUSH_32, count) ;
+  bench_label(code, 0) ;
+  bench_op_16(code, GET_AT_SP, -2) ;
+  bench_op_8(code, PUSH_8, native) ;
+  bench_op(code, NATIVE_CALL) ;
+  bench_op_16(code, SET_AT_SP, -2) ;
+  bench_count_down(code, 0) ;
+  bench_op(code, HALT) ;
+
+  code->natives = 1 ;
+
+  return count ;
+}
+
+static u64_t bench_native_untyped (bench_code_t * code)
+{
+  return bench_native_loop(code, 1) ;
+}
+
+static u64_t bench_native_typed (bench_code_t * code)
+{
+  return bench_native_loop(code, 2) ;
+}
+
+/* `acc = acc * 3 + order + 1` for the order `MEMORY_COMPARE` left on top
+ * of `[acc, n]`, so that every order counts. */
+static void bench_order (bench_code_t * code)
+{
+  bench_op_8(code, PUSH_8, 1) ;
+  bench_op(code, ADD) ;
+  bench_op_16(code, GET_AT_SP, -3) ;
+  bench_op_8(code, PUSH_8, 3) ;
+  bench_op(code, MULTIPLY) ;
+  bench_op(code, ADD) ;
+  bench_op_16(code, SET_AT_SP, -2) ;
+}
+
+/* Per iteration, fills 64 bytes at `a` with the counter and stores it at
+ * `a + 16`, shifts the block up a byte and down 8 with overlapping copies,
+ * compares it with `b`, which holds the block of the iteration before,
+ * copies it there and compares the two again. The result, checked against
+ * the same steps on a host buffer, folds in every order, so a copy that
+ * goes the wrong way across the overlap or a compare of the wrong sign
+ * shows. */
+static u64_t bench_blocks (bench_code_t * code)
+{
+  u64_t count = 200000, acc = 0, n ;
+  u64_t a     = BENCH_ARRAY_ADDR, b = BENCH_ARRAY_ADDR + 0x100 ;
+  u8_t  block [2][64] ;
+  int   order ;
+
+  bench_op_8(code, PUSH_8, 0) ;
+  bench_op_32(code, PUSH_32, count) ;
+  bench_label(code, 0) ;
+  bench_op_32(code, PUSH_32, a) ;
+  bench_op_16(code, GET_AT_SP, -2) ;
+  bench_op_8(code, PUSH_8, 64) ;
+  bench_op(code, MEMORY_FILL) ;
+  bench_op_16(code, GET_AT_SP, -1) ;
+  bench_op_32(code, PUSH_32, a + 16) ;
+  bench_op(code, STORE_64) ;
+  bench_op_32(code, PUSH_32, a + 1) ;
+  bench_op_32(code, PUSH_32, a) ;
+  bench_op_8(code, PUSH_8, 40) ;
+  bench_op(code, MEMORY_COPY) ;
+  bench_op_32(code, PUSH_32, a + 4) ;
+  bench_op_32(code, PUSH_32, a + 12) ;
+  bench_op_8(code, PUSH_8, 40) ;
+  bench_op(code, MEMORY_COPY) ;
+  bench_op_32(code, PUSH_32, a) ;
+  bench_op_32(code, PUSH_32, b) ;
+  bench_op_8(code, PUSH_8, 64) ;
+  bench_op(code, MEMORY_COMPARE) ;
+  bench_order(code) ;
+  bench_op_32(code, PUSH_32, b) ;
+  bench_op_32(code, PUSH_32, a) ;
+  bench_op_8(code, PUSH_8, 64) ;
+  bench_op(code, MEMORY_COPY) ;
+  bench_op_32(code, PUSH_32, b) ;
+  bench_op_32(code, PUSH_32, a) ;
+  bench_op_8(code, PUSH_8, 64) ;
+  bench_op(code, MEMORY_COMPARE) ;
+  bench_order(code) ;
+  bench_count_down(code, 0) ;
+  bench_op_32(code, PUSH_32, b + 16) ;
+  bench_op(code, LOAD_64) ;
+  bench_op(code, ADD) ;
+  bench_op(code, HALT) ;
+
+  memset(block, 0, sizeof(block)) ;
+
+  for (n = count ; 0 != n ; --n) {
+    memset(block[0], (u8_t)n, 64) ;
+    memcpy(block[0] + 16, &n, sizeof(n)) ;
+    memmove(block[0] + 1, block[0], 40) ;
+    memmove(block[0] + 4, block[0] + 12, 40) ;
+
+    order = memcmp(block[0], block[1], 64) ;
+    acc   = acc * 3 + (0 < order) - (order < 0) + 1 ;
+
+    memcpy(block[1], block[0], 64) ;
+    acc   = acc * 3 + 1 ;
+  }
+
+  u64_t last ;
+
+  memcpy(&last, block[1] + 16, sizeof(last)) ;
+
+  return acc + last ;
+}
+
+/* Adds the pending error to the count under the counter of `[count, n]`
+ * and clears it. */
+static void bench_caught (bench_code_t * code)
+{
+  bench_op(code, ERROR_GET) ;
+  bench_op_16(code, GET_AT_SP, -3) ;
+  bench_op(code, ADD) ;
+  bench_op_16(code, SET_AT_SP, -2) ;
+  bench_op_8(code, PUSH_8, 0) ;
+  bench_op(code, ERROR_SET) ;
+}
+
+/* Per iteration, four blocks that end past the memory or wrap around it,
+ * each of which must fail without writing anything, and two that end
+ * exactly at its end and must not fail. The result is the sum of the
+ * errors and of the 8 bytes at `a`, filled with 0x11 beforehand, which any
+ * write from the failed blocks would change. */
+static u64_t bench_bounds (bench_code_t * code)
+{
+  u64_t count = 100000 ;
+  u64_t a     = BENCH_ARRAY_ADDR, end = BENCH_MEMORY_SIZE ;
+
+  bench_op_32(code, PUSH_32, a) ;
+  bench_op_8(code, PUSH_8, 0x11) ;
+  bench_op_8(code, PUSH_8, 8) ;
+  bench_op(code, MEMORY_FILL) ;
+  bench_op_8(code, PUSH_8, 0) ;
+  bench_op_32(code, PUSH_32, count) ;
+  bench_label(code, 0) ;
+  bench_op_32(code, PUSH_32, a) ;
+  bench_op_32(code, PUSH_32, end - 8) ;
+  bench_op_8(code, PUSH_8, 16) ;
+  bench_op(code, MEMORY_COPY) ;
+  bench_caught(code) ;
+  bench_op_32(code, PUSH_32, end - 8) ;
+  bench_op_32(code, PUSH_32, a) ;
+  bench_op_8(code, PUSH_8, 16) ;
+  bench_op(code, MEMORY_COPY) ;
+  bench_caught(code) ;
+  bench_op_32(code, PUSH_32, a) ;
+  bench_op_8(code, PUSH_8, 0) ;
+  bench_op_8(code, PUSH_8, 1) ;
+  bench_op(code, NEGATE) ;
+  bench_op(code, MEMORY_FILL) ;
+  bench_caught(code) ;
+  bench_op_32(code, PUSH_32, a) ;
+  bench_op_32(code, PUSH_32, end - 4) ;
+  bench_op_8(code, PUSH_8, 8) ;
+  bench_op(code, MEMORY_COMPARE) ;
+  bench_caught(code) ;
+  bench_op_32(code, PUSH_32, end) ;
+  bench_op_32(code, PUSH_32, a) ;
+  bench_op_8(code, PUSH_8, 0) ;
+  bench_op(code, MEMORY_COPY) ;
+  bench_op_32(code, PUSH_32, end - 1) ;
+  bench_op_8(code, PUSH_8, 0) ;
+  bench_op_8(code, PUSH_8, 1) ;
+  bench_op(code, MEMORY_FILL) ;
+  bench_count_down(code, 0) ;
+  bench_op_32(code, PUSH_32, a) ;
+  bench_op(code, LOAD_64) ;
+  bench_op(code, ADD) ;
+  bench_op(code, HALT) ;
+
+  return count * 4 * HUSKY_ERROR_OUT_OF_MEMORY + 0x1111111111111111 ;
+}
+
+/* The template of `clone`: `a[i] = 8 * i` over the table, a breakpoint,
+ * then the request, which leaves the sum of the first word of each page on
+ * the stack and stores it over the first one. */
+static u64_t bench_template (bench_code_t * code)
+{
+  u64_t page = 4096, sum = 0, i ;
+
+  bench_op_32(code, PUSH_32, BENCH_CLONE_TABLE) ;
+  bench_label(code, 0) ;
+  bench_op_8(code, PUSH_8, 8) ;
+  bench_op_16(code, EXCHANGE, -1) ;
+  bench_op(code, SUBTRACT) ;
+  bench_op_16(code, GET_AT_SP, -1) ;
+  bench_op_16(code, GET_AT_SP, -1) ;
+  bench_op_32(code, PUSH_32, BENCH_ARRAY_ADDR) ;
+  bench_op(code, ADD) ;
+  bench_op(code, STORE_64) ;
+  bench_op_16(code, GET_AT_SP, -1) ;
+  bench_branch(code, HUSKY_INST_JUMP_IF_TRUE, 0) ;
+  bench_op(code, POP) ;
+  bench_op(code, BREAKPOINT) ;
+
+  bench_op_8(code, PUSH_8, 0) ;
+  bench_op_32(code, PUSH_32, BENCH_CLONE_TABLE) ;
+  bench_label(code, 1) ;
+  bench_op_16(code, PUSH_16, page) ;
+  bench_op_16(code, EXCHANGE, -1) ;
+  bench_op(code, SUBTRACT) ;
+  bench_op_16(code, GET_AT_SP, -1) ;
+  bench_op_32(code, PUSH_32, BENCH_ARRAY_ADDR) ;
+  bench_op(code, ADD) ;
+  bench_op(code, LOAD_64) ;
+  bench_op_16(code, GET_AT_SP, -3) ;
+  bench_op(code, ADD) ;
+  bench_op_16(code, SET_AT_SP, -2) ;
+  bench_op_16(code, GET_AT_SP, -1) ;
+  bench_branch(code, HUSKY_INST_JUMP_IF_TRUE, 1) ;
+  bench_op(code, POP) ;
+  bench_op_16(code, GET_AT_SP, -1) ;
+  bench_op_32(code, PUSH_32, BENCH_ARRAY_ADDR) ;
+  bench_op(code, STORE_64) ;
+  bench_op(code, HALT) ;
+
+  for (i = 0 ; i < BENCH_CLONE_TABLE ; i += page) {
+    sum += i ;
+  }
+
+  return sum ;
+}
+
+static int bench_run (const bench_t * bench, u32_t jit, int rounds, const char * dir) ;
+static int bench_clone (const bench_t * bench, u32_t jit, int rounds, const char * dir) ;
+
+static const bench_t benches [] = {
+  { "dispatch"     , bench_dispatch       , bench_run   , 0 } ,
+  { "fib"          , bench_fib            , bench_run   , 0 } ,
+  { "recursion"    , bench_recursion      , bench_run   , 0 } ,
+  { "frames"       , bench_frames         , bench_run   , 0 } ,
+  { "memory"       , bench_memory         , bench_run   , 0 } ,
+  { "print"        , bench_print          , bench_run   , 0 } ,
+  { "native"       , bench_native_untyped , bench_run   , 0 } ,
+  { "native_typed" , bench_native_typed   , bench_run   , 0 } ,
+  { "blocks"       , bench_blocks         , bench_run   , 0 } ,
+  { "bounds"       , bench_bounds         , bench_run   , 1 } ,
+  { "clone"        , bench_template       , bench_clone , 0 }
+} ;
+
+static void bench_put (u8_t ** tail, const void * data, u64_t size)
+{
+  memcpy(*tail, data, size) ;
+  *tail += size ;
+}
+
+static void bench_section (u8_t ** tail, const char * name, u64_t addr, const void * data, u64_t size)
+{
+  bench_put(tail, name, strlen(name) + 1) ;
+  bench_put(tail, &addr, sizeof(addr)) ;
+  bench_put(tail, &size, sizeof(size)) ;
+  bench_put(tail, data, size) ;
+}
+
+/* Lays out a version 1 image: the code, the string `PRINT` uses and, for
+ * the native workloads, a `.husky.bind` section giving the natives of the
+ * host program handles 1 and 2. Returns its size. */
+static u64_t bench_image (const bench_code_t * code, u8_t * image)
+{
+  static const u8_t header [8] = {
+    HUSKY_FILE_MAG_NUM_0 , HUSKY_FILE_MAG_NUM_1 , HUSKY_FILE_MAG_NUM_2 , HUSKY_FILE_MAG_NUM_3 ,
+    HUSKY_FILE_VERSION_0 , HUSKY_FILE_VERSION_1 , HUSKY_FILE_VERSION_2 , HUSKY_FILE_VERSION_3_MIN
+  } ;
+
+  static const char text [] = "husky " ;
+  static const char bind [] = "\0bench_native\0\0bench_typed" ;
+
+  u8_t * tail     = image ;
+  u64_t  mem_size = BENCH_MEMORY_SIZE ;
+  u64_t  ip       = BENCH_TEXT_ADDR ;
+  u64_t  sp       = BENCH_STACK_ADDR ;
+  u16_t  secs     = 0 != code->natives ? 3 : 2 ;
+
+  bench_put(&tail, header, sizeof(header)) ;
+  bench_put(&tail, &mem_size, sizeof(mem_size)) ;
+  bench_put(&tail, &ip, sizeof(ip)) ;
+  bench_put(&tail, &sp, sizeof(sp)) ;
+  bench_put(&tail, &secs, sizeof(secs)) ;
+
+  bench_section(&tail, ".text", BENCH_TEXT_ADDR, code->data, code->size) ;
+  bench_section(&tail, ".data", BENCH_DATA_ADDR, text, sizeof(text)) ;
+
+  if (0 != code->natives)
+    bench_section(&tail, HUSKY_BIND_SECTION, 0, bind, sizeof(bind)) ;
+
+  return tail - image ;
+}
+
+/* Builds the image of a workload and saves it as `dir/name.img` when `dir`
+ * is set. Returns the expected result and sets `*size`. */
+static u64_t bench_prepare (const bench_t * bench, u8_t * image, u64_t * size, const char * dir, char * path)
+{
+  bench_code_t code ;
+  u64_t        expect ;
+
+  memset(&code, 0, sizeof(code)) ;
+
+  expect = bench->build(&code) ;
+  bench_link(&code) ;
+  *size = bench_image(&code, image) ;
+
+  if (NULL != dir) {
+    FILE * fileptr ;
+
+    snprintf(path, 4096, "%s/%s.img", dir, bench->name) ;
+
+    if (NULL == (fileptr = fopen(path, "wb")) || *size != fwrite(image, 1, *size, fileptr)) {
+      fprintf(stderr, "Error: Cannot write `%s`.\n", path) ;
+      *path = 0 ;
+    }
+
+    if (NULL != fileptr)
+      fclose(fileptr) ;
+  }
+
+  return expect ;
+}
+
+/* Runs one workload `rounds` times and prints its line. */
+static int bench_run (const bench_t * bench, u32_t jit, int rounds, const char * dir)
+{
+  u8_t  image [BENCH_CODE_SIZE + 256] ;
+  char  path  [4096] ;
+  u64_t expect, size, steps = 0, best = UINT64_MAX, resident = 0, reserved ;
+  int   check = 1 ;
+  int   round ;
+
+  expect = bench_prepare(bench, image, &size, dir, path) ;
+
+  husky_config_t config ;
+
+  memset(&config, 0, sizeof(config)) ;
+
+  config.mem_size  = BENCH_MEMORY_SIZE ;
+  config.jit       = jit ;
+  config.err_func  = 0 != bench->recover ? bench_recover : NULL ;
+  config.out_func  = bench_sink ;
+  config.out_flush = HUSKY_FLUSH_FULL ;
+
+  for (round = 0 ; round < rounds ; ++round) {
+    husky_t * husky = husky_create(&config) ;
+
+    if (NULL == husky || HUSKY_SUCCESS != husky_image_load_memory(husky, image, size)) {
+      fprintf(stderr, "Error: Cannot load `%s`.\n", bench->name) ;
+      husky_destroy(husky) ;
+      return EXIT_FAILURE ;
+    }
+
+    u64_t start = bench_clock() ;
+
+    while (HUSKY_STATE_HALTED != husky_state_get(husky)) {
+      if (HUSKY_SUCCESS != husky_run(husky, HUSKY_STEPS_UNLIMITED)) {
+        fprintf(stderr, "Error: `%s`: %s.\n", bench->name, husky_error_as_string(husky->err_code)) ;
+        husky_destroy(husky) ;
+        return EXIT_FAILURE ;
+      }
+    }
+
+    u64_t elapsed = bench_clock() - start ;
+
+    husky_object_t * object = husky_stack_peek(husky, -1) ;
+
+    if (NULL == object || expect != object->u)
+      check = 0 ;
+
+    if (elapsed < best)
+      best = elapsed ;
+
+    steps = husky->steps ;
+    husky_memory_usage(husky, &resident, &reserved) ;
+    husky_destroy(husky) ;
+  }
+
+  struct rusage usage ;
+
+  getrusage(RUSAGE_SELF, &usage) ;
+
+  printf(
+    "{\"name\": \"%s\", \"jit\": %u, \"rounds\": %d, \"steps\": %" PRIu64 ", \"best_ns\": %" PRIu64 ", "
+    "\"steps_per_s\": %.0f, \"ns_per_step\": %.3f, \"rss_kib\": %" PRIu64 ", \"peak_rss_kib\": %ld, "
+    "\"check\": %s}\n"                                                   ,
+    bench->name                                                          ,
+    jit                                                                  ,
+    rounds                                                               ,
+    steps                                                                ,
+    best                                                                 ,
+    1e9 * steps / best                                                   ,
+    (double)best / steps                                                 ,
+    resident >> 10                                                       ,
+    usage.ru_maxrss                                                      ,
+    0 != check ? "true" : "false"
+  ) ;
+
+  return 0 != check ? EXIT_SUCCESS : EXIT_FAILURE ;
+}
+
+/* Runs a request on `husky`, from the breakpoint of the template to its
+ * halt, and tells whether it left `expect`. */
+static int bench_request (husky_t * husky, u64_t expect)
+{
+  husky_object_t * object ;
+
+  while (HUSKY_STATE_HALTED != husky_state_get(husky)) {
+    if (HUSKY_SUCCESS != husky_run(husky, HUSKY_STEPS_UNLIMITED))
+      return 0 ;
+  }
+
+  object = husky_stack_peek(husky, -1) ;
+
+  return NULL != object && expect == object->u ;
+}
+
+static void bench_clone_line (const char * name, u32_t jit, int rounds, u64_t best, u64_t resident, int check)
+{
+  struct rusage usage ;
+
+  getrusage(RUSAGE_SELF, &usage) ;
+
+  printf(
+    "{\"name\": \"%s\", \"jit\": %u, \"rounds\": %d, \"requests\": %d, \"mem_mib\": %d, "
+    "\"best_ns\": %" PRIu64 ", \"ns_per_request\": %.0f, \"rss_kib\": %" PRIu64 ", "
+    "\"peak_rss_kib\": %ld, \"check\": %s}\n"                              ,
+    name                                                                 ,
+    jit                                                                  ,
+    rounds                                                               ,
+    BENCH_CLONE_REQUESTS                                                 ,
+    BENCH_CLONE_MEMORY >> 20                                             ,
+    best                                                                 ,
+    (double)best / BENCH_CLONE_REQUESTS                                  ,
+    resident >> 10                                                       ,
+    usage.ru_maxrss                                                      ,
+    0 != check ? "true" : "false"
+  ) ;
+}
+
+/* Times `BENCH_CLONE_REQUESTS` requests per round served by clones of one
+ * template, then as many by fresh instances, and prints a line for each
+ * with the best round. The image is read from `--write` or a temporary
+ * file, so the fresh instances pay for `husky_image_load` itself. */
+static int bench_clone (const bench_t * bench, u32_t jit, int rounds, const char * dir)
+{
+  u8_t  image [BENCH_CODE_SIZE + 256] ;
+  char  path  [4096] ;
+  u64_t expect, size, best = UINT64_MAX, resident = 0, reserved ;
+  int   check = 1 ;
+  int   round, i ;
+
+  husky_config_t config ;
+
+  memset(&config, 0, sizeof(config)) ;
+
+  config.mem_size  = BENCH_CLONE_MEMORY ;
+  config.jit       = jit ;
+  config.out_func  = bench_sink ;
+  config.out_flush = HUSKY_FLUSH_FULL ;
+
+  expect = bench_prepare(bench, image, &size, dir, path) ;
+
+  if (NULL == dir) {
+    int fd ;
+
+    snprintf(path, sizeof(path), "%s/husky_bench_XXXXXX", NULL != getenv("TMPDIR") ? getenv("TMPDIR") : "/tmp") ;
+
+    if (0 > (fd = mkstemp(path)) || size != (u64_t)write(fd, image, size))
+      *path = 0 ;
+
+    if (0 <= fd)
+      close(fd) ;
+  }
+
+  husky_t * template = husky_create(&config) ;
+
+  if (0 == *path || NULL == template || HUSKY_SUCCESS != husky_image_load(template, path) || HUSKY_SUCCESS != husky_run(template, HUSKY_STEPS_UNLIMITED)) {
+    fprintf(stderr, "Error: Cannot load `%s`.\n", bench->name) ;
+    husky_destroy(template) ;
+    return EXIT_FAILURE ;
+  }
+
+  for (round = 0 ; round < rounds ; ++round) {
+    u64_t start = bench_clock() ;
+
+    for (i = 0 ; i < BENCH_CLONE_REQUESTS ; ++i) {
+      husky_t * husky = husky_clone(template) ;
+
+      if (NULL == husky || 0 == bench_request(husky, expect))
+        check = 0 ;
+
+      if (NULL != husky && 0 == round && 0 == i)
+        husky_memory_usage(husky, &resident, &reserved) ;
+
+      husky_destroy(husky) ;
+    }
+
+    u64_t elapsed = bench_clock() - start ;
+
+    if (elapsed < best)
+      best = elapsed ;
+  }
+
+  husky_destroy(template) ;
+  bench_clone_line("clone", jit, rounds, best, resident, check) ;
+
+  int clone_check = check ;
+
+  best  = UINT64_MAX ;
+  check = 1 ;
+
+  for (round = 0 ; round < rounds ; ++round) {
+    u64_t start = bench_clock() ;
+
+    for (i = 0 ; i < BENCH_CLONE_REQUESTS ; ++i) {
+      husky_t * husky = husky_create(&config) ;
+
+      if (NULL == husky || HUSKY_SUCCESS != husky_image_load(husky, path) || 0 == bench_request(husky, expect))
+        check = 0 ;
+
+      if (NULL != husky && 0 == round && 0 == i)
+        husky_memory_usage(husky, &resident, &reserved) ;
+
+      husky_destroy(husky) ;
+    }
+
+    u64_t elapsed = bench_clock() - start ;
+
+    if (elapsed < best)
+      best = elapsed ;
+  }
+
+  bench_clone_line("clone_fresh", jit, rounds, best, resident, check) ;
+
+  if (NULL == dir)
+    unlink(path) ;
+
+  return 0 != check && 0 != clone_check ? EXIT_SUCCESS : EXIT_FAILURE ;
+}
+
+int main (int argc, char ** argv)
+{
+  u32_t        jit       = 0 ;
+  int          rounds    = BENCH_ROUNDS ;
+  const char * dir       = NULL ;
+  int          first     = argc ;
+  int          exit_code = EXIT_SUCCESS ;
+  int          i ;
+  u64_t        j ;
+
+  for (i = 1 ; i < argc ; ++i) {
+    if (0 == strcmp(argv[i], "--jit")) {
+      jit = 1 ;
+    } else if (0 == strcmp(argv[i], "--rounds") && i + 1 < argc) {
+      rounds = atoi(argv[++i]) ;
+    } else if (0 == strcmp(argv[i], "--write") && i + 1 < argc) {
+      dir = argv[++i] ;
+    } else {
+      first = i ;
+      break ;
+    }
+  }
+
+  if (rounds < 1)
+    rounds = 1 ;
+
+  for (j = 0 ; j < sizeof(benches) / sizeof(benches[0]) ; ++j) {
+    int status = EXIT_FAILURE ;
+
+    if (first < argc) {
+      for (i = first ; i < argc && 0 != strcmp(argv[i], benches[j].name) ; ++i) ;
+
+      if (argc == i)
+        continue ;
+    }
+
+    /* A process per workload, so that its peak resident memory is its own. */
+    fflush(stdout) ;
+
+    pid_t pid = fork() ;
+
+    if (0 == pid) {
+      int result = benches[j].run(benches + j, jit, rounds, dir) ;
+
+      fflush(stdout) ;
+      _exit(result) ;
+    }
+
+    if (pid < 0 || pid != waitpid(pid, &status, 0) || !WIFEXITED(status) || EXIT_SUCCESS != WEXITSTATUS(status))
+      exit_code = EXIT_FAILURE ;
+  }
+
+  return exit_code ;
+}
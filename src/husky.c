@@ -1,13 +1,28 @@
+#ifndef _GNU_SOURCE
+# define _GNU_SOURCE
+#endif
+
 #include "husky.h"
+#include "husky_decode.h"
+#include "husky_jit.h"
+#include "husky_bind.h"
+#include "husky_vector.h"
+#include "husky_image.h"
 #include <stdlib.h>
 #include <stdio.h>
 #include <string.h>
+#include <stdarg.h>
 #include <inttypes.h>
-
-#ifdef _WIN32
-# include <win32/dlfcn.h>
-#else
-# include <dlfcn.h>
+#include <math.h>
+
+#ifndef _WIN32
+# include <fcntl.h>
+# include <unistd.h>
+# include <signal.h>
+# include <setjmp.h>
+# include <pthread.h>
+# include <sys/mman.h>
+# include <sys/stat.h>
 #endif
 
 const char * husky_error_as_string (u32_t err_code)
@@ -35,6 +50,102 @@ const char * husky_error_as_string (u32_t err_code)
   return error_as_string[err_code] ;
 }
 
+const char * husky_inst_as_string (u32_t opr_code)
+{
+  static const char * inst_as_string [] = {
+    "HALT"                      ,
+    "NOOP"                      ,
+    "BREAKPOINT"                ,
+    "ERROR_SET"                 ,
+    "ERROR_GET"                 ,
+    "JUMP"                      ,
+    "JUMP_INDIRECT"             ,
+    "JUMP_IF_FALSE"             ,
+    "JUMP_IF_TRUE"              ,
+    "CALL"                      ,
+    "CALL_INDIRECT"             ,
+    "RETURN"                    ,
+    "MODULE_OPEN"               ,
+    "MODULE_CLOSE"              ,
+    "NATIVE_LOAD"               ,
+    "NATIVE_CALL"               ,
+    "IS_NULL_POINTER"           ,
+    "IS_NOT_NULL_POINTER"       ,
+    "IS_STRING"                 ,
+    "ENTER"                     ,
+    "LEAVE"                     ,
+    "PUSH_8"                    ,
+    "PUSH_16"                   ,
+    "PUSH_32"                   ,
+    "PUSH_64"                   ,
+    "POP"                       ,
+    "EXCHANGE"                  ,
+    "SET_AT_SP"                 ,
+    "GET_AT_SP"                 ,
+    "SET_AT_FP"                 ,
+    "GET_AT_FP"                 ,
+    "STORE_8"                   ,
+    "STORE_16"                  ,
+    "STORE_32"                  ,
+    "STORE_64"                  ,
+    "LOAD_8"                    ,
+    "LOAD_16"                   ,
+    "LOAD_32"                   ,
+    "LOAD_64"                   ,
+    "NEGATE"                    ,
+    "ADD"                       ,
+    "SUBTRACT"                  ,
+    "MULTIPLY"                  ,
+    "DIVIDE"                    ,
+    "MODULO"                    ,
+    "INT_MULTIPLY"              ,
+    "INT_DIVIDE"                ,
+    "INT_MODULO"                ,
+    "IS_EQUAL"                  ,
+    "IS_NOT_EQUAL"              ,
+    "IS_LESS"                   ,
+    "IS_LESS_OR_EQUAL"          ,
+    "IS_GREATER"                ,
+    "IS_GREATER_OR_EQUAL"       ,
+    "BIT_NOT"                   ,
+    "BIT_AND"                   ,
+    "BIT_OR"                    ,
+    "BIT_XOR"                   ,
+    "BIT_SHIFT_LEFT"            ,
+    "BIT_SHIFT_RIGHT"           ,
+    "BIT_INT_SHIFT_RIGHT"       ,
+    "PRINT"                     ,
+    "MEMORY_COPY"               ,
+    "MEMORY_FILL"               ,
+    "MEMORY_COMPARE"            ,
+    "VECTOR"                    ,
+    "VECTOR_REDUCE"             ,
+    "FLOAT_NEGATE"              ,
+    "FLOAT_ADD"                 ,
+    "FLOAT_SUBTRACT"            ,
+    "FLOAT_MULTIPLY"            ,
+    "FLOAT_DIVIDE"              ,
+    "FLOAT_SQUARE_ROOT"         ,
+    "FLOAT_IS_EQUAL"            ,
+    "FLOAT_IS_NOT_EQUAL"        ,
+    "FLOAT_IS_LESS"             ,
+    "FLOAT_IS_LESS_OR_EQUAL"    ,
+    "FLOAT_IS_GREATER"          ,
+    "FLOAT_IS_GREATER_OR_EQUAL" ,
+    "INT_TO_FLOAT"              ,
+    "FLOAT_TO_INT"
+  } ;
+
+  if (HUSKY_N_INSTS <= opr_code)
+    return NULL ;
+
+  return inst_as_string[opr_code] ;
+}
+
+/* Errors are sticky: `err_code` stays set until `err_func` or the host
+ * clears it. Helpers return `husky_error_check` on success, which costs a
+ * single branch while no error is pending, and call `husky_error_set`
+ * once on failure, so `err_func` runs once per error. */
 u32_t husky_error_set (husky_t * husky, u32_t err_code)
 {
   if (HUSKY_N_ERRORS <= err_code)
@@ -63,7 +174,7 @@ u32_t husky_state_set (husky_t * husky, u32_t state)
 
   husky->state = state ;
 
-  return husky_error_get(husky) ;
+  return husky_error_check(husky) ;
 }
 
 u32_t husky_state_get (husky_t * husky)
@@ -71,763 +182,3811 @@ u32_t husky_state_get (husky_t * husky)
   return husky->state ;
 }
 
-u32_t husky_memory_write (husky_t * husky, u64_t addr, u64_t size, const ptr_t data)
+static int husky_insn_invalidate (husky_t * husky, u64_t addr, u64_t size) ;
+
+/* Output of `PRINT`, through `out_func` when the host set one. */
+static void husky_print (husky_t * husky, const char * data, u64_t size)
 {
-  if (husky->mem_size < addr + size)
-    return husky_error_set(husky, HUSKY_ERROR_OUT_OF_MEMORY) ;
+  if (NULL != husky->out_func) {
+    husky->out_func(husky, data, size) ;
+  } else {
+    fwrite(data, sizeof(char), size, stdout) ;
+  }
+}
 
-  memcpy(husky->mem_data + addr, data, size) ;
+/* Hands the buffered output of `PRINT` to the sink. */
+void husky_output_flush (husky_t * husky)
+{
+  if (0 == husky->out_used)
+    return ;
 
-  return husky_error_get(husky) ;
+  husky_print(husky, husky->out_data, husky->out_used) ;
+  husky->out_used = 0 ;
 }
 
-u32_t husky_memory_read (husky_t * husky, u64_t addr, u64_t size, ptr_t data)
+/* Adds to the output buffer, or writes straight through what would not fit
+ * even in an empty one. */
+static void husky_output (husky_t * husky, const char * data, u64_t size)
 {
-  if (husky->mem_size < addr + size)
-    return husky_error_set(husky, HUSKY_ERROR_OUT_OF_MEMORY) ;
+  if (0 == size)
+    return ;
 
-  memcpy(data, husky->mem_data + addr, size) ;
+  if (husky->out_size - husky->out_used < size) {
+    husky_output_flush(husky) ;
 
-  return husky_error_get(husky) ;
+    if (husky->out_size < size) {
+      husky_print(husky, data, size) ;
+      return ;
+    }
+  }
+
+  memcpy(husky->out_data + husky->out_used, data, size) ;
+  husky->out_used += size ;
+
+  if (HUSKY_FLUSH_FULL == husky->out_flush)
+    return ;
+
+  if (HUSKY_FLUSH_EACH == husky->out_flush || NULL != memchr(data, '\n', size))
+    husky_output_flush(husky) ;
 }
 
-u32_t husky_memory_read_ip (husky_t * husky, u64_t size, ptr_t data)
+/* Formats `value` right to left, ending at `tail`, and returns its head. */
+static inline char * husky_output_dec (char * tail, u64_t value)
 {
-  if (HUSKY_SUCCESS != husky_memory_read(husky, husky->ip, size, data))
-    return husky_error_get(husky) ;
-
-  husky->ip += size ;
+  do {
+    *--tail = '0' + value % 10 ;
+    value  /= 10 ;
+  } while (0 != value) ;
 
-  return husky_error_get(husky) ;
+  return tail ;
 }
 
-husky_object_t * husky_stack_peek (husky_t * husky, i64_t rel_addr)
+static inline char * husky_output_hex (char * tail, u64_t value, const char * digits)
 {
-  rel_addr *= sizeof(husky_object_t) ;
+  do {
+    *--tail  = digits[value & 0xF] ;
+    value  >>= 4 ;
+  } while (0 != value) ;
 
-  if (rel_addr < 0) {
-    rel_addr = -rel_addr ;
+  return tail ;
+}
 
-    if (husky->sp < rel_addr) {
-      husky_error_set(husky, HUSKY_ERROR_STACK_UNDERFLOW) ;
-      return NULL ;
-    }
+/* Formats `value` at the head of `text` with the fewest significant digits,
+ * from 15 to 17, that read back as the same double, and returns the length. */
+static u64_t husky_output_float (char * text, u64_t size, f64_t value)
+{
+  int digits, length = 0 ;
 
-    return (husky_object_t *)(husky->mem_data + husky->sp - rel_addr) ;
-  }
+  for (digits = 15 ; digits <= 17 ; ++digits) {
+    length = snprintf(text, size, "%.*g", digits, value) ;
 
-  if (husky->mem_size < husky->sp + rel_addr) {
-    husky_error_set(husky, HUSKY_ERROR_STACK_OVERFLOW) ;
-    return NULL ;
+    if (strtod(text, NULL) == value)
+      break ;
   }
 
-  return (husky_object_t *)(husky->mem_data + husky->sp + rel_addr) ;
+  return length ;
 }
 
-u32_t husky_stack_push (husky_t * husky, husky_object_t object)
+/* Loader errors and traces, through `log_func` when the host set one. */
+static void husky_log (husky_t * husky, const char * format, ...)
 {
-  husky_object_t * stack_object = husky_stack_peek(husky, 0) ;
+  char    buffer [512] ;
+  va_list args ;
 
-  if (NULL != stack_object) {
-    *stack_object = object ;
+  va_start(args, format) ;
+  int size = vsnprintf(buffer, sizeof(buffer), format, args) ;
+  va_end(args) ;
 
-    husky->sp += sizeof(husky_object_t) ;
-  }
+  if (size < 0)
+    return ;
 
-  return husky_error_get(husky) ;
+  if (sizeof(buffer) <= (u64_t)size)
+    size = sizeof(buffer) - 1 ;
+
+  if (NULL != husky->log_func) {
+    husky->log_func(husky, buffer, size) ;
+  } else {
+    fwrite(buffer, sizeof(char), size, stderr) ;
+  }
 }
 
-u32_t husky_stack_pop (husky_t * husky, husky_object_t * object)
+/* The stack guard page is the page above `stack_top` when `stack_guard` is
+ * nonzero, and guarded memory is followed by address space reserved up to
+ * `HUSKY_MEMORY_RESERVE`. Both are mapped without access, and the fault
+ * handler unwinds the run a fault happened in to `husky_run`, which reports
+ * the error it jumps back with. The checks of the interpreter and the JIT
+ * keep pushes below `stack_top` and loads and stores off the guard page,
+ * which only backs them up, while masked loads and stores of guarded
+ * memory are left to fault past its end; the host side of the API never
+ * touches either. */
+#ifndef _WIN32
+typedef struct husky_fault_s husky_fault_t ;
+
+struct husky_fault_s {
+  husky_t *      husky    ;
+  volatile u32_t err_code ;
+  sigjmp_buf     jump     ;
+} ;
+
+/* The guarded run of this thread, if any. */
+static __thread husky_fault_t * husky_fault = NULL ;
+
+static struct sigaction husky_fault_next ;
+static pthread_once_t   husky_fault_once  = PTHREAD_ONCE_INIT ;
+static u32_t            husky_fault_ready = 0 ;
+
+static void husky_fault_handler (int sig, siginfo_t * info, void * context)
 {
-  husky_object_t * stack_object = husky_stack_peek(husky, -1) ;
+  husky_fault_t * fault = husky_fault ;
+
+  if (NULL != fault) {
+    husky_t * husky = fault->husky ;
+    u8_t *    guard = husky->mem_data + husky->stack_top ;
+    u8_t *    addr  = (u8_t *)info->si_addr ;
 
-  if (NULL != stack_object) {
-    if (NULL != object) {
-      *object = *stack_object ;
+    if (guard <= addr && addr < guard + husky->stack_guard) {
+      fault->err_code = HUSKY_ERROR_STACK_OVERFLOW ;
+      siglongjmp(fault->jump, 1) ;
     }
 
-    husky->sp -= sizeof(husky_object_t) ;
+    if (0 != husky->mem_guarded && husky->mem_data + husky->mem_size <= addr && addr < husky->mem_data + HUSKY_MEMORY_RESERVE) {
+      fault->err_code = HUSKY_ERROR_OUT_OF_MEMORY ;
+      siglongjmp(fault->jump, 1) ;
+    }
   }
 
-  return husky_error_get(husky) ;
+  /* Not a guard: whatever handled the signal before does, and the
+   * default action runs when the faulting access does again. */
+  if (0 != (husky_fault_next.sa_flags & SA_SIGINFO)) {
+    husky_fault_next.sa_sigaction(sig, info, context) ;
+  } else if (SIG_DFL != husky_fault_next.sa_handler && SIG_IGN != husky_fault_next.sa_handler) {
+    husky_fault_next.sa_handler(sig) ;
+  } else {
+    signal(sig, SIG_DFL) ;
+  }
 }
 
-u32_t husky_frame_enter (husky_t * husky, i64_t size)
+static void husky_fault_install (void)
 {
-  if (size < 0)
-    return husky_error_set(husky, HUSKY_ERROR_INVALID_FRAME) ;
+  struct sigaction action ;
 
-  husky_object_t object ;
+  memset(&action, 0, sizeof(action)) ;
+  sigemptyset(&action.sa_mask) ;
 
-  object.u = husky->fp ;
+  action.sa_sigaction = husky_fault_handler ;
+  action.sa_flags     = SA_SIGINFO | SA_NODEFER ;
 
-  if (HUSKY_SUCCESS != husky_stack_push(husky, object))
-    return husky_error_get(husky) ;
+  husky_fault_ready = 0 == sigaction(SIGSEGV, &action, &husky_fault_next) ;
+}
 
-  husky->fp = husky->sp ;
+/* With `guard` set, reserves `HUSKY_MEMORY_RESERVE` bytes of address space
+ * of which only the first `size`, in whole pages, are accessible, so that
+ * an address masked to 32 bits is either in the memory or faults, whatever
+ * the size of the access. */
+static void * husky_memory_reserve (husky_t * husky, u64_t size, int flags)
+{
+  void * data ;
 
-  if (NULL == husky_stack_peek(husky, size))
-    return husky_error_get(husky) ;
+  if (0 == husky->guard || HUSKY_MEMORY_GUARDED < size)
+    return MAP_FAILED ;
 
-  husky->sp += size * sizeof(husky_object_t) ;
+  pthread_once(&husky_fault_once, husky_fault_install) ;
 
-  return husky_error_get(husky) ;
-}
+  if (0 == husky_fault_ready)
+    return MAP_FAILED ;
 
-u32_t husky_frame_leave (husky_t * husky)
-{
-  husky_object_t object ;
+  data = mmap(NULL, HUSKY_MEMORY_RESERVE, PROT_NONE, flags, -1, 0) ;
 
-  husky->sp = husky->fp ;
+  if (MAP_FAILED == data)
+    return MAP_FAILED ;
 
-  if (HUSKY_SUCCESS != husky_stack_pop(husky, &object))
-    return husky_error_get(husky) ;
+  if (0 != mprotect(data, size, PROT_READ | PROT_WRITE)) {
+    munmap(data, HUSKY_MEMORY_RESERVE) ;
+    return MAP_FAILED ;
+  }
 
-  husky->fp = object.u ;
+  husky->mem_guarded = 1 ;
 
-  return husky_error_get(husky) ;
+  return data ;
 }
+#endif
 
-u32_t husky_string_verify(husky_t * husky, u64_t addr)
+/* Guest memory is an anonymous mapping where there is one, so pages the
+ * program never touches are never committed and come zeroed for free, and
+ * the image loader can map file pages straight into it. It is reserved
+ * without swap accounting, so a large `mem_size` costs address space only;
+ * with `huge` set it asks for transparent huge pages as it gets populated. */
+u32_t husky_memory_alloc (husky_t * husky, u64_t size)
 {
-  if (husky->mem_size <= addr)
-    return husky_error_set(husky, HUSKY_ERROR_INVALID_ADDRESS) ;
+#ifndef _WIN32
+  u64_t page = (u64_t)sysconf(_SC_PAGESIZE) ;
 
-  if (NULL == memchr(husky->mem_data + addr, 0, husky->mem_size - addr))
-    return husky_error_set(husky, HUSKY_ERROR_INVALID_STRING) ;
+  /* Guarded memory ends on a page boundary, past what was asked if need be. */
+  if (0 != husky->guard && size <= HUSKY_MEMORY_GUARDED)
+    size = (size + page - 1) & ~(page - 1) ;
+#endif
 
-  return husky_error_get(husky) ;
-}
+  husky->mem_size    = size ;
+  husky->mem_data    = NULL ;
+  husky->mem_mapped  = 0 ;
+  husky->mem_guarded = 0 ;
+  husky->mem_fd      = -1 ;
+  husky->mem_frozen  = 0 ;
+  husky->stack_top   = size ;
+  husky->stack_guard = 0 ;
+  husky->args_base   = size ;
+
+#ifndef _WIN32
+  if (0 == size)
+    return husky_error_set(husky, HUSKY_ERROR_OUT_OF_MEMORY) ;
 
-#define _UNO(__0)
-#define _NEG(__0)      (-(__0))
-#define _NOT(__0)      (~(__0))
-#define _BNO(__0, __1)
-#define _ADD(__0, __1) ((__0) + (__1))
-#define _SUB(__0, __1) ((__0) - (__1))
-#define _MUL(__0, __1) ((__0) * (__1))
-#define _DIV(__0, __1) ((__0) / (__1))
-#define _MOD(__0, __1) ((__0) % (__1))
-#define _AND(__0, __1) ((__0) & (__1))
-#define _OR(__0, __1)  ((__0) | (__1))
-#define _XOR(__0, __1) ((__0) ^ (__1))
-#define _SHL(__0, __1) ((__0) << (__1))
-#define _SHR(__0, __1) ((__0) >> (__1))
-#define _IEQ(__0, __1) ((__0) == (__1))
-#define _INE(__0, __1) ((__0) != (__1))
-#define _ILS(__0, __1) ((__0) <  (__1))
-#define _ILE(__0, __1) ((__0) <= (__1))
-#define _IGT(__0, __1) ((__0) >  (__1))
-#define _IGE(__0, __1) ((__0) >= (__1))
+  int flags = MAP_PRIVATE | MAP_ANONYMOUS ;
 
-#define _IDZ(__0, __1)                                       \
-  {                                                          \
-    if (0 == (__1)) {                                        \
-      husky_error_set(husky, HUSKY_ERROR_DIVISION_BY_ZERO) ; \
-      break ;                                                \
-    }                                                        \
-  }
+# ifdef MAP_NORESERVE
+  flags |= MAP_NORESERVE ;
+# endif
 
-u32_t husky_clock (husky_t * husky)
-{
-  u8_t opr_code ;
+  void * data = husky_memory_reserve(husky, size, flags) ;
 
-  if (HUSKY_SUCCESS != husky_memory_read_ip(husky, sizeof(opr_code), &opr_code))
-    return husky_error_get(husky) ;
+  if (MAP_FAILED == data)
+    data = mmap(NULL, size, PROT_READ | PROT_WRITE, flags, -1, 0) ;
 
-  if (0 != husky->verbose) {
-    fprintf(stderr, "%012" PRIX64 " | %02" PRIX8 "\n", husky->ip - sizeof(u8_t), opr_code) ;
-  }
+  if (MAP_FAILED != data) {
+# ifdef MADV_HUGEPAGE
+    if (0 != husky->huge)
+      madvise(data, size, MADV_HUGEPAGE) ;
+# endif
 
-  husky_object_t object_0, object_1, object_2 ;
+    husky->mem_data   = (u8_t *)data ;
+    husky->mem_mapped = 1 ;
 
-#define _UNAOP(__opr_code, __type_0, __type_2, __check, __func)           \
-  case __opr_code : {                                                     \
-    if (HUSKY_SUCCESS != husky_stack_pop(husky, &object_0))               \
-      break ;                                                             \
-                                                                          \
-    __check(object_0.__type_0) ;                                          \
-    object_2.__type_2 = __func(object_0.__type_0) ;                       \
-                                                                          \
-    husky_stack_push(husky, object_2) ;                                   \
-  } break ;
+    return husky_error_get(husky) ;
+  }
+#endif
 
-#define _BINOP(__opr_code, __type_0, __type_1, __type_2, __check, __func) \
-  case __opr_code : {                                                     \
-    if (HUSKY_SUCCESS != husky_stack_pop(husky, &object_0))               \
-      break ;                                                             \
-                                                                          \
-    if (HUSKY_SUCCESS != husky_stack_pop(husky, &object_1))               \
-      break ;                                                             \
-                                                                          \
-    __check(object_0.__type_0, object_1.__type_1) ;                       \
-    object_2.__type_2 = __func(object_0.__type_0, object_1.__type_1) ;    \
-                                                                          \
-    husky_stack_push(husky, object_2) ;                                   \
-  } break ;
+  husky->mem_data = (u8_t *)calloc(size, sizeof(u8_t)) ;
 
-  switch (opr_code) {
-  case HUSKY_INST_HALT : {
-    husky_state_set(husky, HUSKY_STATE_HALTED) ;
-  } break ;
+  if (NULL == husky->mem_data)
+    return husky_error_set(husky, HUSKY_ERROR_OUT_OF_MEMORY) ;
 
-  case HUSKY_INST_NOOP : {
-    /* nothing */
-  } break ;
+  return husky_error_get(husky) ;
+}
 
-  case HUSKY_INST_BREAKPOINT : {
-    husky_state_set(husky, HUSKY_STATE_BREAKED) ;
-  } break ;
+u32_t husky_memory_free (husky_t * husky)
+{
+  if (NULL == husky->mem_data)
+    return husky_error_get(husky) ;
 
-  case HUSKY_INST_ERROR_SET : {
-    if (HUSKY_SUCCESS != husky_stack_pop(husky, &object_0))
-      break ;
+#ifndef _WIN32
+  if (0 != husky->mem_mapped) {
+    munmap(husky->mem_data, 0 != husky->mem_guarded ? HUSKY_MEMORY_RESERVE : husky->mem_size) ;
+  } else {
+    free(husky->mem_data) ;
+  }
 
-    husky_error_set(husky, object_0.u) ;
-  } break ;
+  if (0 <= husky->mem_fd)
+    close(husky->mem_fd) ;
 
-  case HUSKY_INST_ERROR_GET : {
-    object_0.u = husky->err_code ;
+  husky->mem_fd = -1 ;
+#else
+  free(husky->mem_data) ;
+#endif
 
-    husky_stack_push(husky, object_0) ;
-  } break ;
+  husky->mem_data    = NULL ;
+  husky->mem_mapped  = 0 ;
+  husky->mem_guarded = 0 ;
+  husky->stack_guard = 0 ;
 
-  case HUSKY_INST_JUMP : {
-    i32_t opr_data = 0 ;
+  return husky_error_get(husky) ;
+}
 
-    if (HUSKY_SUCCESS != husky_memory_read_ip(husky, sizeof(opr_data), &opr_data))
-      break ;
+/* Reports how much of the memory is backed by physical pages and how much
+ * is only reserved. Pages mapped from the image count while they are in
+ * the page cache; memory that is not a mapping counts as all resident. */
+u32_t husky_memory_usage (husky_t * husky, u64_t * resident, u64_t * reserved)
+{
+  *reserved = husky->mem_size ;
+  *resident = husky->mem_size ;
 
-    husky->ip += (i64_t)opr_data ;
-  } break ;
+#ifndef _WIN32
+  if (0 == husky->mem_mapped)
+    return husky_error_get(husky) ;
 
-  case HUSKY_INST_JUMP_INDIRECT : {
-    if (HUSKY_SUCCESS != husky_stack_pop(husky, &object_0))
-      break ;
+  u64_t         page = (u64_t)sysconf(_SC_PAGESIZE) ;
+  unsigned char vec [4096] ;
+  u64_t         addr, size, i ;
 
-    husky->ip += object_0.i ;
-  } break ;
+  *resident = 0 ;
 
-  case HUSKY_INST_JUMP_IF_FALSE : {
-    i32_t opr_data = 0 ;
+  for (addr = 0 ; addr < husky->mem_size ; addr += size) {
+    size = husky->mem_size - addr ;
 
-    if (HUSKY_SUCCESS != husky_memory_read_ip(husky, sizeof(opr_data), &opr_data))
-      break ;
+    if (sizeof(vec) * page < size)
+      size = sizeof(vec) * page ;
 
-    if (HUSKY_SUCCESS != husky_stack_pop(husky, &object_0))
-      break ;
+    if (0 != mincore(husky->mem_data + addr, size, (void *)vec)) {
+      *resident += size ;
+      continue ;
+    }
 
-    if (0 == object_0.u) {
-      husky->ip += (i64_t)opr_data ;
+    for (i = 0 ; i < (size + page - 1) / page ; ++i) {
+      if (0 != (vec[i] & 1))
+        *resident += page ;
     }
-  } break ;
+  }
 
-  case HUSKY_INST_JUMP_IF_TRUE : {
-    i32_t opr_data = 0 ;
+  if (*resident > *reserved)
+    *resident = *reserved ;
+#endif
 
-    if (HUSKY_SUCCESS != husky_memory_read_ip(husky, sizeof(opr_data), &opr_data))
-      break ;
+  return husky_error_get(husky) ;
+}
 
-    if (HUSKY_SUCCESS != husky_stack_pop(husky, &object_0))
-      break ;
+/* The size of the guard page above a stack ending at `top`: a page when
+ * `top` is on a page boundary with a page of memory above it, else 0. */
+static u64_t husky_stack_page (husky_t * husky, u64_t top)
+{
+#ifndef _WIN32
+  u64_t page = (u64_t)sysconf(_SC_PAGESIZE) ;
 
-    if (0 != object_0.u) {
-      husky->ip += (i64_t)opr_data ;
-    }
-  } break ;
+  if (0 == (top & (page - 1)) && page <= husky->mem_size && top <= husky->mem_size - page)
+    return page ;
+#endif
 
-  case HUSKY_INST_CALL : {
-    i32_t opr_data = 0 ;
+  return 0 ;
+}
 
-    if (HUSKY_SUCCESS != husky_memory_read_ip(husky, sizeof(opr_data), &opr_data))
-      break ;
+/* Guards the stack when it ends on a page boundary of a mapping with a
+ * page of memory above it that the arguments do not reach into. */
+static void husky_stack_guard (husky_t * husky)
+{
+  husky->stack_guard = 0 ;
 
-    object_0.u = husky->ip ;
+#ifndef _WIN32
+  u64_t page = husky_stack_page(husky, husky->stack_top) ;
 
-    if (HUSKY_SUCCESS != husky_stack_push(husky, object_0))
-      break ;
+  if (0 == page || 0 == husky->mem_mapped || husky->args_base < husky->stack_top + page)
+    return ;
 
-    husky->ip += (i64_t)opr_data ;
-  } break ;
+  pthread_once(&husky_fault_once, husky_fault_install) ;
 
-  case HUSKY_INST_CALL_INDIRECT : {
-    if (HUSKY_SUCCESS != husky_stack_pop(husky, &object_1))
-      break ;
+  if (0 != husky_fault_ready && 0 == mprotect(husky->mem_data + husky->stack_top, page, PROT_NONE))
+    husky->stack_guard = page ;
+#endif
+}
 
-    object_0.u = husky->ip ;
+static void husky_stack_unguard (husky_t * husky)
+{
+#ifndef _WIN32
+  if (0 != husky->stack_guard)
+    mprotect(husky->mem_data + husky->stack_top, husky->stack_guard, PROT_READ | PROT_WRITE) ;
+#endif
 
-    if (HUSKY_SUCCESS != husky_stack_push(husky, object_0))
-      break ;
+  husky->stack_guard = 0 ;
+}
 
-    husky->ip += object_1.i ;
-  } break ;
+/* Where the memory readable from `addr` on ends: at the guard page when
+ * `addr` is below its end, at the end of the memory otherwise. It is at
+ * most `addr` inside the page. */
+static inline u64_t husky_memory_end (husky_t * husky, u64_t addr)
+{
+  if (0 != husky->stack_guard && addr < husky->stack_top + husky->stack_guard)
+    return husky->stack_top ;
 
-  case HUSKY_INST_RETURN : {
-    if (HUSKY_SUCCESS != husky_stack_pop(husky, &object_0))
-      break ;
+  return husky->mem_size ;
+}
 
-    husky->ip = object_0.u ;
-  } break ;
+u32_t husky_memory_write (husky_t * husky, u64_t addr, u64_t size, const ptr_t data)
+{
+  if (husky->mem_size < size || husky->mem_size - size < addr || husky_memory_guarded(husky, addr, size))
+    return husky_error_set(husky, HUSKY_ERROR_OUT_OF_MEMORY) ;
 
-  case HUSKY_INST_MODULE_OPEN : {
-    if (HUSKY_SUCCESS != husky_stack_pop(husky, &object_0))
-      break ;
+  memcpy(husky->mem_data + addr, data, size) ;
 
-    if (HUSKY_SUCCESS != husky_stack_pop(husky, &object_1))
-      break ;
+  husky_insn_invalidate(husky, addr, size) ;
+  husky->mem_frozen = 0 ;
 
-    if (HUSKY_SUCCESS != husky_string_verify(husky, object_0.u))
-      break ;
+  return husky_error_check(husky) ;
+}
 
-    object_2.p = dlopen(husky->mem_data + object_0.u, object_1.i) ;
+u32_t husky_memory_read (husky_t * husky, u64_t addr, u64_t size, ptr_t data)
+{
+  if (husky->mem_size < size || husky->mem_size - size < addr || husky_memory_guarded(husky, addr, size))
+    return husky_error_set(husky, HUSKY_ERROR_OUT_OF_MEMORY) ;
 
-    husky_stack_push(husky, object_2) ;
-  } break ;
+  memcpy(data, husky->mem_data + addr, size) ;
 
-  case HUSKY_INST_MODULE_CLOSE : {
-    if (HUSKY_SUCCESS != husky_stack_pop(husky, &object_0))
-      break ;
+  return husky_error_check(husky) ;
+}
 
-    if (NULL == object_0.p) {
-      husky_error_set(husky, HUSKY_ERROR_INVALID_MODULE) ;
-      break ;
-    }
+u32_t husky_memory_read_ip (husky_t * husky, u64_t size, ptr_t data)
+{
+  if (HUSKY_SUCCESS != husky_memory_read(husky, husky->ip, size, data))
+    return husky_error_get(husky) ;
 
-    dlclose(object_0.p) ;
-  } break ;
+  husky->ip += size ;
 
-  case HUSKY_INST_NATIVE_LOAD : {
-    if (HUSKY_SUCCESS != husky_stack_pop(husky, &object_0))
-      break ;
+  return husky_error_get(husky) ;
+}
 
-    if (HUSKY_SUCCESS != husky_stack_pop(husky, &object_1))
-      break ;
+husky_object_t * husky_stack_peek (husky_t * husky, i64_t rel_addr)
+{
+  rel_addr *= sizeof(husky_object_t) ;
+  husky->mem_frozen = 0 ;
 
-    if (HUSKY_SUCCESS != husky_string_verify(husky, object_1.u))
-      break ;
+  if (rel_addr < 0) {
+    rel_addr = -rel_addr ;
 
-    if (NULL == object_0.p) {
-      husky_error_set(husky, HUSKY_ERROR_INVALID_MODULE) ;
-      break ;
+    if (husky->sp < rel_addr) {
+      husky_error_set(husky, HUSKY_ERROR_STACK_UNDERFLOW) ;
+      return NULL ;
     }
 
-    object_2.p = dlsym(object_0.p, husky->mem_data + object_1.u) ;
+    return (husky_object_t *)(husky->mem_data + husky->sp - rel_addr) ;
+  }
 
-    husky_stack_push(husky, object_2) ;
-  } break ;
+  if (husky->stack_top < husky->sp + rel_addr) {
+    husky_error_set(husky, HUSKY_ERROR_STACK_OVERFLOW) ;
+    return NULL ;
+  }
 
-  case HUSKY_INST_NATIVE_CALL : {
-    if (HUSKY_SUCCESS != husky_stack_pop(husky, &object_0))
-      break ;
+  return (husky_object_t *)(husky->mem_data + husky->sp + rel_addr) ;
+}
 
-    if (NULL == object_0.p) {
-      husky_error_set(husky, HUSKY_ERROR_INVALID_NATIVE) ;
-      break ;
-    }
+u32_t husky_stack_push (husky_t * husky, husky_object_t object)
+{
+  if (husky->stack_top < sizeof(husky_object_t) || husky->stack_top - sizeof(husky_object_t) < husky->sp)
+    return husky_error_set(husky, HUSKY_ERROR_STACK_OVERFLOW) ;
 
-    husky_native_t native = (husky_native_t)object_0.p ;
+  memcpy(husky->mem_data + husky->sp, &object, sizeof(husky_object_t)) ;
+  husky->sp         += sizeof(husky_object_t) ;
+  husky->mem_frozen  = 0 ;
 
-    native(husky) ;
-  } break ;
+  return husky_error_check(husky) ;
+}
 
-  case HUSKY_INST_IS_NULL_POINTER : {
-    if (HUSKY_SUCCESS != husky_stack_pop(husky, &object_0))
-      break ;
+u32_t husky_stack_pop (husky_t * husky, husky_object_t * object)
+{
+  if (husky->sp < sizeof(husky_object_t))
+    return husky_error_set(husky, HUSKY_ERROR_STACK_UNDERFLOW) ;
 
-    object_1.u = NULL == object_0.p ;
+  husky->sp -= sizeof(husky_object_t) ;
 
-    husky_stack_push(husky, object_1) ;
-  } break ;
+  if (NULL != object)
+    memcpy(object, husky->mem_data + husky->sp, sizeof(husky_object_t)) ;
 
-  case HUSKY_INST_IS_NOT_NULL_POINTER : {
-    if (HUSKY_SUCCESS != husky_stack_pop(husky, &object_0))
-      break ;
+  return husky_error_check(husky) ;
+}
 
-    object_1.u = NULL != object_0.p ;
+/* Bytes `husky_args_push` stores at the top of the memory for `argv`. */
+u64_t husky_args_size (int argc, char ** argv)
+{
+  u64_t size = 0 ;
+  int   i ;
 
-    husky_stack_push(husky, object_1) ;
-  } break ;
+  for (i = 0 ; i < argc ; ++i) {
+    size += strlen(argv[i]) + 1 ;
+  }
 
-  case HUSKY_INST_IS_STRING : {
-    if (HUSKY_SUCCESS != husky_stack_pop(husky, &object_0))
-      break ;
+  return size ;
+}
 
-    if (HUSKY_SUCCESS != husky_string_verify(husky, object_0.u)) {
-      object_1.u = 0 ;
-      husky_error_set(husky, HUSKY_SUCCESS) ;
-    } else {
-      object_1.u = 1 ;
-    }
+/* Passes `argv` to the program the way the loader does: the strings at the
+ * top of the memory, then a NULL, the string addresses from the last to the
+ * first and `argc` on the stack. The stack loses its guard page when the
+ * strings reach into it. */
+u32_t husky_args_push (husky_t * husky, int argc, char ** argv)
+{
+  u64_t argv_addr = husky->mem_size ;
+  u64_t total     = husky_args_size(argc, argv) ;
+  u32_t result ;
+  int   i ;
 
-    husky_stack_push(husky, object_1) ;
-  } break ;
+  if (0 != husky->verbose) {
+    husky_log(husky, "Loading %d arguments...\n", argc) ;
+  }
 
-  case HUSKY_INST_ENTER : {
-    u16_t opr_data = 0 ;
+  if (husky->mem_size < total)
+    return husky_error_set(husky, HUSKY_ERROR_OUT_OF_MEMORY) ;
 
-    if (HUSKY_SUCCESS != husky_memory_read_ip(husky, sizeof(opr_data), &opr_data))
-      break ;
+  if (husky->mem_size - total < husky->args_base) {
+    husky->args_base = husky->mem_size - total ;
 
-    husky_frame_enter(husky, (i64_t)opr_data) ;
-  } break ;
+    if (husky_memory_guarded(husky, husky->args_base, total))
+      husky_stack_unguard(husky) ;
+  }
 
-  case HUSKY_INST_LEAVE : {
-    husky_frame_leave(husky) ;
-  } break ;
+  for (i = argc - 1 ; 0 <= i ; --i) {
+    u64_t size = strlen(argv[i]) + 1 ;
 
-  case HUSKY_INST_PUSH_8  : 
-  case HUSKY_INST_PUSH_16 : 
-  case HUSKY_INST_PUSH_32 : 
-  case HUSKY_INST_PUSH_64 : {
-    u64_t opr_data = 0 ;
+    if (argv_addr < size)
+      return husky_error_set(husky, HUSKY_ERROR_OUT_OF_MEMORY) ;
 
-    if (HUSKY_SUCCESS != husky_memory_read_ip(husky, 1 << (opr_code - HUSKY_INST_PUSH_8), &opr_data))
-      break ;
+    argv_addr -= size ;
 
-    object_0.u = opr_data ;
+    if (0 != husky->verbose) {
+      husky_log(husky, "Writing `%s` at 0x%012" PRIX64 "...\n", argv[i], argv_addr) ;
+    }
 
-    husky_stack_push(husky, object_0) ;
-  } break ;
+    if (HUSKY_SUCCESS != (result = husky_memory_write(husky, argv_addr, size, argv[i])))
+      return result ;
+  }
 
-  case HUSKY_INST_POP : {
-    husky_stack_pop(husky, NULL) ;
-  } break ;
+  husky_object_t object ;
+  object.p = NULL ;
 
-  case HUSKY_INST_EXCHANGE : {
-    i16_t opr_data = 0 ;
+  if (HUSKY_SUCCESS != (result = husky_stack_push(husky, object)))
+    return result ;
 
-    if (HUSKY_SUCCESS != husky_memory_read_ip(husky, sizeof(opr_data), &opr_data))
-      break ;
+  argv_addr = husky->mem_size ;
 
-    if (HUSKY_SUCCESS != husky_stack_pop(husky, &object_0))
-      break ;
+  for (i = argc - 1 ; 0 <= i ; --i) {
+    argv_addr -= strlen(argv[i]) + 1 ;
+    object.u   = argv_addr ;
 
-    husky_object_t * object = husky_stack_peek(husky, (i64_t)opr_data) ;
+    if (HUSKY_SUCCESS != (result = husky_stack_push(husky, object)))
+      return result ;
+  }
 
-    if (NULL == object)
-      break ;
+  object.u = argc ;
 
-    if (HUSKY_SUCCESS != husky_stack_push(husky, *object))
-      break ;
+  return husky_stack_push(husky, object) ;
+}
 
-    *object = object_0 ;
-  } break ;
+u32_t husky_frame_enter (husky_t * husky, i64_t size)
+{
+  if (size < 0)
+    return husky_error_set(husky, HUSKY_ERROR_INVALID_FRAME) ;
 
-  case HUSKY_INST_SET_AT_SP : {
-    i16_t opr_data = 0 ;
+  husky_object_t object ;
+  u32_t          result ;
 
-    if (HUSKY_SUCCESS != husky_memory_read_ip(husky, sizeof(opr_data), &opr_data))
-      break ;
+  object.u = husky->fp ;
+
+  if (HUSKY_SUCCESS != (result = husky_stack_push(husky, object)))
+    return result ;
+
+  if ((husky->stack_top - husky->sp) / sizeof(husky_object_t) < (u64_t)size) {
+    husky->sp -= sizeof(husky_object_t) ;
+    return husky_error_set(husky, HUSKY_ERROR_STACK_OVERFLOW) ;
+  }
+
+  husky->fp  = husky->sp ;
+  husky->sp += size * sizeof(husky_object_t) ;
+
+  return husky_error_check(husky) ;
+}
+
+u32_t husky_frame_leave (husky_t * husky)
+{
+  husky_object_t object ;
+  u32_t          result ;
+
+  husky->sp = husky->fp ;
+
+  if (HUSKY_SUCCESS != (result = husky_stack_pop(husky, &object)))
+    return result ;
+
+  husky->fp = object.u ;
+
+  return husky_error_check(husky) ;
+}
+
+u32_t husky_string_verify(husky_t * husky, u64_t addr)
+{
+  u64_t end = husky_memory_end(husky, addr) ;
+
+  if (end <= addr)
+    return husky_error_set(husky, HUSKY_ERROR_INVALID_ADDRESS) ;
+
+  if (NULL == memchr(husky->mem_data + addr, 0, end - addr))
+    return husky_error_set(husky, HUSKY_ERROR_INVALID_STRING) ;
+
+  return husky_error_check(husky) ;
+}
+
+static husky_insn_t * husky_insn_find (husky_decode_t * decode, u64_t addr)
+{
+  if (decode->count <= addr >> HUSKY_INSN_PAGE_BITS)
+    return NULL ;
+
+  husky_insn_t ** page = decode->pages[addr >> HUSKY_INSN_PAGE_BITS] ;
+
+  if (NULL == page)
+    return NULL ;
+
+  return page[addr & HUSKY_INSN_PAGE_MASK] ;
+}
+
+static u32_t husky_insn_read (husky_t * husky, u64_t addr, husky_insn_t * insn)
+{
+  if (husky->mem_size <= addr || husky_memory_guarded(husky, addr, 1))
+    return HUSKY_ERROR_OUT_OF_MEMORY ;
+
+  u8_t  opr_code = husky->mem_data[addr] ;
+  u64_t opr_size = 0 ;
+
+  if (HUSKY_N_INSTS < opr_code)
+    opr_code = HUSKY_N_INSTS ;
+
+  switch (opr_code) {
+  case HUSKY_INST_JUMP          :
+  case HUSKY_INST_JUMP_IF_FALSE :
+  case HUSKY_INST_JUMP_IF_TRUE  :
+  case HUSKY_INST_CALL          :
+  case HUSKY_INST_PUSH_32       :
+    opr_size = sizeof(u32_t) ;
+    break ;
+
+  case HUSKY_INST_ENTER     :
+  case HUSKY_INST_PUSH_16   :
+  case HUSKY_INST_EXCHANGE  :
+  case HUSKY_INST_SET_AT_SP :
+  case HUSKY_INST_GET_AT_SP :
+  case HUSKY_INST_SET_AT_FP :
+  case HUSKY_INST_GET_AT_FP :
+    opr_size = sizeof(u16_t) ;
+    break ;
+
+  case HUSKY_INST_PUSH_8        :
+  case HUSKY_INST_VECTOR        :
+  case HUSKY_INST_VECTOR_REDUCE :
+    opr_size = sizeof(u8_t) ;
+    break ;
+
+  case HUSKY_INST_PUSH_64 :
+    opr_size = sizeof(u64_t) ;
+    break ;
+
+  default :
+    break ;
+  }
+
+  if (husky->mem_size - addr - 1 < opr_size || husky_memory_guarded(husky, addr, 1 + opr_size))
+    return HUSKY_ERROR_OUT_OF_MEMORY ;
+
+  u64_t opr_data = 0 ;
+
+  memcpy(&opr_data, husky->mem_data + addr + 1, opr_size) ;
+
+  switch (opr_code) {
+  case HUSKY_INST_JUMP          :
+  case HUSKY_INST_JUMP_IF_FALSE :
+  case HUSKY_INST_JUMP_IF_TRUE  :
+  case HUSKY_INST_CALL          :
+    opr_data = addr + 1 + opr_size + (i64_t)(i32_t)opr_data ;
+    break ;
+
+  case HUSKY_INST_EXCHANGE  :
+  case HUSKY_INST_SET_AT_SP :
+  case HUSKY_INST_GET_AT_SP :
+  case HUSKY_INST_SET_AT_FP :
+  case HUSKY_INST_GET_AT_FP :
+    opr_data = (i64_t)(i16_t)opr_data ;
+    break ;
+
+  default :
+    break ;
+  }
+
+  insn->opr_data = opr_data ;
+  insn->target   = NULL ;
+  insn->addr     = addr ;
+  insn->opr_code = opr_code ;
+  insn->base     = opr_code ;
+  insn->size     = 1 + opr_size ;
+  insn->need     = 0 ;
+  insn->grow     = 0 ;
+
+  return HUSKY_SUCCESS ;
+}
+
+static int husky_insn_is_final (u8_t opr_code)
+{
+  return
+    HUSKY_INST_HALT          == opr_code ||
+    HUSKY_INST_JUMP          == opr_code ||
+    HUSKY_INST_JUMP_INDIRECT == opr_code ||
+    HUSKY_INST_RETURN        == opr_code ||
+    HUSKY_INSN_LINK          == opr_code ||
+    HUSKY_N_INSTS            == opr_code ;
+}
+
+/* Stack effect of a record in slots: it needs `need` slots below `sp`,
+ * touches at most `grow` slots above it and moves `sp` by `move`. Returns
+ * nonzero when the interpreter has an unchecked handler for it; those also
+ * count on a valid top of stack before and after, hence the extra slot.
+ * Counting and fused records take the bounds of their image opcode: the
+ * former may turn back into it, the latter are only dispatched unchecked
+ * when every record of their sequence is part of the run. */
+static int husky_insn_effect (const husky_insn_t * insn, i64_t * need, i64_t * grow, i64_t * move)
+{
+  i64_t rel = (i64_t)insn->opr_data ;
+
+  *need = 0 ;
+  *grow = 0 ;
+  *move = 0 ;
+
+  switch (insn->base) {
+  case HUSKY_INST_CALL      :
+  case HUSKY_INST_PUSH_8    :
+  case HUSKY_INST_PUSH_16   :
+  case HUSKY_INST_PUSH_32   :
+  case HUSKY_INST_PUSH_64   :
+  case HUSKY_INST_GET_AT_FP :
+    *need =  1 ;
+    *grow =  1 ;
+    *move =  1 ;
+    return 1 ;
+
+  case HUSKY_INST_POP           :
+  case HUSKY_INST_JUMP_IF_FALSE :
+  case HUSKY_INST_JUMP_IF_TRUE  :
+  case HUSKY_INST_SET_AT_FP     :
+    *need =  2 ;
+    *move = -1 ;
+    return 1 ;
+
+  case HUSKY_INST_GET_AT_SP :
+    *need = rel < -1 ? -rel    : 1 ;
+    *grow = 0   < rel ? rel + 1 : 1 ;
+    *move = 1 ;
+    return 1 ;
+
+  case HUSKY_INST_SET_AT_SP :
+    *need = rel < -1 ? 1 - rel : 2 ;
+    *grow = 0   < rel ? rel     : 0 ;
+    *move = -1 ;
+    return 1 ;
+
+  case HUSKY_INST_STORE_8  :
+  case HUSKY_INST_STORE_16 :
+  case HUSKY_INST_STORE_32 :
+  case HUSKY_INST_STORE_64 :
+    *need =  3 ;
+    *move = -2 ;
+    return 1 ;
+
+  case HUSKY_INST_LOAD_8  :
+  case HUSKY_INST_LOAD_16 :
+  case HUSKY_INST_LOAD_32 :
+  case HUSKY_INST_LOAD_64 :
+    *need = 1 ;
+    return 1 ;
+
+  case HUSKY_INST_NEGATE  :
+  case HUSKY_INST_BIT_NOT :
+    *need = 1 ;
+    return 1 ;
+
+  case HUSKY_INST_FLOAT_NEGATE      :
+  case HUSKY_INST_FLOAT_SQUARE_ROOT :
+  case HUSKY_INST_INT_TO_FLOAT      :
+  case HUSKY_INST_FLOAT_TO_INT      :
+    *need = 1 ;
+    return 1 ;
+
+  case HUSKY_INST_ADD                 :
+  case HUSKY_INST_SUBTRACT            :
+  case HUSKY_INST_MULTIPLY            :
+  case HUSKY_INST_DIVIDE              :
+  case HUSKY_INST_MODULO              :
+  case HUSKY_INST_INT_MULTIPLY        :
+  case HUSKY_INST_INT_DIVIDE          :
+  case HUSKY_INST_INT_MODULO          :
+  case HUSKY_INST_IS_EQUAL            :
+  case HUSKY_INST_IS_NOT_EQUAL        :
+  case HUSKY_INST_IS_LESS             :
+  case HUSKY_INST_IS_LESS_OR_EQUAL    :
+  case HUSKY_INST_IS_GREATER          :
+  case HUSKY_INST_IS_GREATER_OR_EQUAL :
+  case HUSKY_INST_BIT_AND             :
+  case HUSKY_INST_BIT_OR              :
+  case HUSKY_INST_BIT_XOR             :
+  case HUSKY_INST_BIT_SHIFT_LEFT      :
+  case HUSKY_INST_BIT_SHIFT_RIGHT     :
+  case HUSKY_INST_BIT_INT_SHIFT_RIGHT :
+    *need =  2 ;
+    *move = -1 ;
+    return 1 ;
+
+  case HUSKY_INST_FLOAT_ADD                 :
+  case HUSKY_INST_FLOAT_SUBTRACT            :
+  case HUSKY_INST_FLOAT_MULTIPLY            :
+  case HUSKY_INST_FLOAT_DIVIDE              :
+  case HUSKY_INST_FLOAT_IS_EQUAL            :
+  case HUSKY_INST_FLOAT_IS_NOT_EQUAL        :
+  case HUSKY_INST_FLOAT_IS_LESS             :
+  case HUSKY_INST_FLOAT_IS_LESS_OR_EQUAL    :
+  case HUSKY_INST_FLOAT_IS_GREATER          :
+  case HUSKY_INST_FLOAT_IS_GREATER_OR_EQUAL :
+    *need =  2 ;
+    *move = -1 ;
+    return 1 ;
+
+  case HUSKY_INST_ENTER :
+    *grow = 1 + (i64_t)insn->opr_data ;
+    *move = 1 + (i64_t)insn->opr_data ;
+    return 0 ;
+
+  default :
+    return 0 ;
+  }
+}
+
+/* Fills `need` and `grow` of a trace from its end, so that each record
+ * bounds the rest of its run. A run stops before a record without an
+ * unchecked handler and after `CALL`, which continues through `RETURN`. */
+static void husky_insn_verify (husky_insn_t * insn, u64_t size)
+{
+  i64_t need = 0, grow = 0 ;
+
+  while (0 != size--) {
+    i64_t this_need, this_grow, move ;
+
+    if (!husky_insn_effect(insn + size, &this_need, &this_grow, &move)) {
+      insn[size].need = 0 ;
+      insn[size].grow = 0 ;
+
+      need = grow = 0 ;
+      continue ;
+    }
+
+    if (HUSKY_INST_CALL == insn[size].base)
+      need = grow = 0 ;
+
+    need = need - move < this_need ? this_need : need - move ;
+    grow = grow + move < this_grow ? this_grow : grow + move ;
+
+    insn[size].need = (u16_t)need ;
+    insn[size].grow = (u16_t)grow ;
+  }
+}
+
+/* Turns calls and backward jumps into their counting variants. */
+static void husky_insn_jit (husky_insn_t * insn, u64_t size)
+{
+  for (; 0 != size-- ; ++insn) {
+    int back = insn->opr_data <= insn->addr ;
+
+    switch (insn->opr_code) {
+    case HUSKY_INST_CALL :
+      insn->opr_code = HUSKY_INSN_JIT_CALL ;
+      break ;
+
+    case HUSKY_INST_JUMP :
+      insn->opr_code = back ? HUSKY_INSN_JIT_JUMP : insn->opr_code ;
+      break ;
+
+    case HUSKY_INST_JUMP_IF_FALSE :
+      insn->opr_code = back ? HUSKY_INSN_JIT_JUMP_IF_FALSE : insn->opr_code ;
+      break ;
+
+    case HUSKY_INST_JUMP_IF_TRUE :
+      insn->opr_code = back ? HUSKY_INSN_JIT_JUMP_IF_TRUE : insn->opr_code ;
+      break ;
+
+    default :
+      break ;
+    }
+  }
+}
+
+/* Sequences common enough in generated code to be worth one dispatch;
+ * `--ngrams` shows which ones a program runs most. Any `PUSH_*` matches
+ * `HUSKY_INST_PUSH_64` here. */
+static const struct {
+  u8_t fused    ;
+  u8_t size     ;
+  u8_t base [4] ;
+} husky_insn_fusions [] = {
+  { HUSKY_INSN_FP_ADD                            , 4 , { HUSKY_INST_GET_AT_FP           , HUSKY_INST_PUSH_64       , HUSKY_INST_ADD , HUSKY_INST_SET_AT_FP } } ,
+  { HUSKY_INSN_PUSH_STORE_64                     , 2 , { HUSKY_INST_PUSH_64             , HUSKY_INST_STORE_64                                              } } ,
+  { HUSKY_INSN_IS_EQUAL_JUMP_IF_FALSE            , 2 , { HUSKY_INST_IS_EQUAL            , HUSKY_INST_JUMP_IF_FALSE                                         } } ,
+  { HUSKY_INSN_IS_EQUAL_JUMP_IF_TRUE             , 2 , { HUSKY_INST_IS_EQUAL            , HUSKY_INST_JUMP_IF_TRUE                                          } } ,
+  { HUSKY_INSN_IS_NOT_EQUAL_JUMP_IF_FALSE        , 2 , { HUSKY_INST_IS_NOT_EQUAL        , HUSKY_INST_JUMP_IF_FALSE                                         } } ,
+  { HUSKY_INSN_IS_NOT_EQUAL_JUMP_IF_TRUE         , 2 , { HUSKY_INST_IS_NOT_EQUAL        , HUSKY_INST_JUMP_IF_TRUE                                          } } ,
+  { HUSKY_INSN_IS_LESS_JUMP_IF_FALSE             , 2 , { HUSKY_INST_IS_LESS             , HUSKY_INST_JUMP_IF_FALSE                                         } } ,
+  { HUSKY_INSN_IS_LESS_JUMP_IF_TRUE              , 2 , { HUSKY_INST_IS_LESS             , HUSKY_INST_JUMP_IF_TRUE                                          } } ,
+  { HUSKY_INSN_IS_LESS_OR_EQUAL_JUMP_IF_FALSE    , 2 , { HUSKY_INST_IS_LESS_OR_EQUAL    , HUSKY_INST_JUMP_IF_FALSE                                         } } ,
+  { HUSKY_INSN_IS_LESS_OR_EQUAL_JUMP_IF_TRUE     , 2 , { HUSKY_INST_IS_LESS_OR_EQUAL    , HUSKY_INST_JUMP_IF_TRUE                                          } } ,
+  { HUSKY_INSN_IS_GREATER_JUMP_IF_FALSE          , 2 , { HUSKY_INST_IS_GREATER          , HUSKY_INST_JUMP_IF_FALSE                                         } } ,
+  { HUSKY_INSN_IS_GREATER_JUMP_IF_TRUE           , 2 , { HUSKY_INST_IS_GREATER          , HUSKY_INST_JUMP_IF_TRUE                                          } } ,
+  { HUSKY_INSN_IS_GREATER_OR_EQUAL_JUMP_IF_FALSE , 2 , { HUSKY_INST_IS_GREATER_OR_EQUAL , HUSKY_INST_JUMP_IF_FALSE                                         } } ,
+  { HUSKY_INSN_IS_GREATER_OR_EQUAL_JUMP_IF_TRUE  , 2 , { HUSKY_INST_IS_GREATER_OR_EQUAL , HUSKY_INST_JUMP_IF_TRUE                                          } } ,
+} ;
+
+static int husky_insn_match (const husky_insn_t * insn, u8_t base)
+{
+  if (HUSKY_INST_PUSH_64 == base)
+    return HUSKY_INST_PUSH_8 <= insn->opr_code && insn->opr_code <= HUSKY_INST_PUSH_64 ;
+
+  return base == insn->opr_code ;
+}
+
+/* Marks the heads of fused sequences. Only plain records match, so counting
+ * records are left alone and each sequence lies within the trace. */
+static void husky_insn_fuse (husky_insn_t * insn, u64_t size)
+{
+  u64_t i, j, k ;
+
+  for (i = 0 ; i < size ; ++i) {
+    for (j = 0 ; j < sizeof(husky_insn_fusions) / sizeof(husky_insn_fusions[0]) ; ++j) {
+      if (size - i < husky_insn_fusions[j].size)
+        continue ;
+
+      for (k = 0 ; k < husky_insn_fusions[j].size ; ++k) {
+        if (!husky_insn_match(insn + i + k, husky_insn_fusions[j].base[k]))
+          break ;
+      }
+
+      if (k < husky_insn_fusions[j].size)
+        continue ;
+
+      if (HUSKY_INSN_FP_ADD == husky_insn_fusions[j].fused && insn[i].opr_data != insn[i + 3].opr_data)
+        continue ;
+
+      insn[i].opr_code = husky_insn_fusions[j].fused ;
+      i += husky_insn_fusions[j].size - 1 ;
+      break ;
+    }
+  }
+}
+
+/* Returns the record for the instruction at `addr`, decoding a new trace
+ * from there if needed, or NULL when `addr` cannot be decoded. */
+husky_insn_t * husky_insn_lookup (husky_t * husky, u64_t addr)
+{
+  husky_decode_t * decode = husky->decode ;
+
+  if (husky->mem_size <= addr)
+    return NULL ;
+
+  if (NULL == decode) {
+    decode = (husky_decode_t *)calloc(1, sizeof(husky_decode_t)) ;
+
+    if (NULL == decode)
+      return NULL ;
+
+    decode->count = (husky->mem_size + HUSKY_INSN_PAGE_MASK) >> HUSKY_INSN_PAGE_BITS ;
+    decode->pages = (husky_insn_t ***)calloc(decode->count, sizeof(husky_insn_t **)) ;
+
+    if (NULL == decode->pages) {
+      free(decode) ;
+      return NULL ;
+    }
+
+    if (0 != husky->jit)
+      decode->jit = husky_jit_create(husky) ;
+
+    husky->decode = decode ;
+  }
+
+  husky_insn_t * insn = husky_insn_find(decode, addr) ;
+
+  if (NULL != insn)
+    return insn ;
+
+  husky_insn_t buffer [HUSKY_TRACE_SIZE_MAX] ;
+  u64_t        size = 0 ;
+  u64_t        next = addr ;
+
+  if (HUSKY_SUCCESS != husky_insn_read(husky, addr, buffer))
+    return NULL ;
+
+  while (size < HUSKY_TRACE_SIZE_MAX - 1) {
+    if (next != addr && NULL != husky_insn_find(decode, next))
+      break ;
+
+    if (HUSKY_SUCCESS != husky_insn_read(husky, next, buffer + size))
+      break ;
+
+    next += buffer[size].size ;
+
+    if (husky_insn_is_final(buffer[size++].opr_code))
+      break ;
+  }
+
+  if (!husky_insn_is_final(buffer[size - 1].opr_code)) {
+    insn = buffer + size++ ;
+
+    insn->opr_data = next ;
+    insn->target   = NULL ;
+    insn->addr     = next ;
+    insn->opr_code = HUSKY_INSN_LINK ;
+    insn->base     = HUSKY_INSN_LINK ;
+    insn->size     = 0 ;
+    insn->need     = 0 ;
+    insn->grow     = 0 ;
+  }
+
+  husky_trace_t * trace = (husky_trace_t *)malloc(
+    sizeof(husky_trace_t) + size * sizeof(husky_insn_t)
+  ) ;
+
+  if (NULL == trace)
+    return NULL ;
+
+  trace->next   = decode->traces ;
+  trace->size   = size ;
+  decode->traces = trace ;
+
+  memcpy(trace->insn, buffer, size * sizeof(husky_insn_t)) ;
+
+  if (NULL != decode->jit)
+    husky_insn_jit(trace->insn, size) ;
+
+  husky_insn_fuse(trace->insn, size) ;
+  husky_insn_verify(trace->insn, size) ;
+
+  u64_t i ;
+
+  for (i = 0 ; i < size ; ++i) {
+    if (HUSKY_INSN_LINK == trace->insn[i].opr_code)
+      break ;
+
+    u64_t            insn_addr = trace->insn[i].addr ;
+    husky_insn_t *** page      = decode->pages + (insn_addr >> HUSKY_INSN_PAGE_BITS) ;
+
+    if (NULL == *page) {
+      *page = (husky_insn_t **)calloc(HUSKY_INSN_PAGE_SIZE, sizeof(husky_insn_t *)) ;
+
+      if (NULL == *page)
+        return NULL ;
+    }
+
+    (*page)[insn_addr & HUSKY_INSN_PAGE_MASK] = trace->insn + i ;
+  }
+
+  return trace->insn ;
+}
+
+/* Drops every trace if `[addr, addr + size)` overlaps decoded bytes and
+ * returns nonzero in that case. */
+static int husky_insn_invalidate (husky_t * husky, u64_t addr, u64_t size)
+{
+  husky_decode_t * decode = husky->decode ;
+
+  if (NULL == decode || 0 == size)
+    return 0 ;
+
+  u64_t head = addr < HUSKY_INSN_SIZE_MAX - 1 ? 0 : addr - (HUSKY_INSN_SIZE_MAX - 1) ;
+  u64_t tail = addr + size ;
+
+  if (decode->count << HUSKY_INSN_PAGE_BITS < tail)
+    tail = decode->count << HUSKY_INSN_PAGE_BITS ;
+
+  while (head < tail) {
+    husky_insn_t ** page = decode->pages[head >> HUSKY_INSN_PAGE_BITS] ;
+
+    if (NULL == page) {
+      head = (head | HUSKY_INSN_PAGE_MASK) + 1 ;
+      continue ;
+    }
+
+    husky_insn_t * insn = page[head & HUSKY_INSN_PAGE_MASK] ;
+
+    if (NULL != insn && addr < head + insn->size) {
+      husky_decode_flush(husky) ;
+      return 1 ;
+    }
+
+    ++head ;
+  }
+
+  return 0 ;
+}
+
+u32_t husky_decode_flush (husky_t * husky)
+{
+  husky_decode_t * decode = husky->decode ;
+
+  if (NULL == decode)
+    return husky_error_get(husky) ;
+
+  u64_t i ;
+
+  for (i = 0 ; i < decode->count ; ++i) {
+    free(decode->pages[i]) ;
+  }
+
+  while (NULL != decode->traces) {
+    husky_trace_t * trace = decode->traces ;
+
+    decode->traces = trace->next ;
+    free(trace) ;
+  }
+
+  if (NULL != decode->jit)
+    husky_jit_destroy(decode->jit) ;
+
+  free(decode->pages) ;
+  free(decode) ;
+
+  husky->decode = NULL ;
+
+  return husky_error_get(husky) ;
+}
+
+/* Rejects decoded instructions whose stack use cannot fit in the stack
+ * whatever `sp` is, reporting each of them. */
+static u32_t husky_image_verify (husky_t * husky)
+{
+  husky_trace_t * trace ;
+  u32_t           result = HUSKY_SUCCESS ;
+
+  for (trace = husky->decode->traces ; NULL != trace ; trace = trace->next) {
+    u64_t i ;
+
+    for (i = 0 ; i < trace->size ; ++i) {
+      husky_insn_t * insn = trace->insn + i ;
+      i64_t          need, grow, move ;
+
+      husky_insn_effect(insn, &need, &grow, &move) ;
+
+      if ((u64_t)grow <= (husky->stack_top + husky->stack_guard) / sizeof(husky_object_t))
+        continue ;
+
+      husky_log(
+        husky                                                           ,
+        "Error: Instruction 0x%02" PRIX8 " at 0x%012" PRIX64 " needs %"
+        PRIu64 " stack bytes, the stack has %" PRIu64 ".\n"           ,
+        insn->base                                                      ,
+        insn->addr                                                      ,
+        (u64_t)grow * sizeof(husky_object_t)                            ,
+        husky->stack_top
+      ) ;
+
+      result = HUSKY_ERROR_STACK_OVERFLOW ;
+    }
+  }
+
+  return result ;
+}
+
+/* Decodes everything reachable from `ip` through direct branches and calls
+ * and links those branches to their targets ahead of execution, then
+ * rejects the image if any of that code would always overflow the stack. */
+u32_t husky_image_decode (husky_t * husky)
+{
+  husky_insn_t * insn = husky_insn_lookup(husky, husky->ip) ;
+
+  if (NULL == insn)
+    return husky_error_set(husky, HUSKY_ERROR_OUT_OF_MEMORY) ;
+
+  u64_t            size = 64, used = 0 ;
+  husky_insn_t  ** todo = (husky_insn_t **)malloc(size * sizeof(husky_insn_t *)) ;
+
+  if (NULL == todo)
+    return husky_error_set(husky, HUSKY_ERROR_OUT_OF_MEMORY) ;
+
+  todo[used++] = insn ;
+
+  while (0 != used) {
+    for (insn = todo[--used] ; ; ++insn) {
+      u8_t opr_code = insn->base ;
+
+      if (
+        NULL == insn->target && (
+          HUSKY_INST_JUMP          == opr_code ||
+          HUSKY_INST_JUMP_IF_FALSE == opr_code ||
+          HUSKY_INST_JUMP_IF_TRUE  == opr_code ||
+          HUSKY_INST_CALL          == opr_code ||
+          HUSKY_INSN_LINK          == opr_code
+        )
+      ) {
+        int fresh = NULL == husky->decode || NULL == husky_insn_find(husky->decode, insn->opr_data) ;
+
+        insn->target = husky_insn_lookup(husky, insn->opr_data) ;
+
+        if (NULL != insn->target && fresh) {
+          if (used == size) {
+            husky_insn_t ** next = (husky_insn_t **)realloc(todo, 2 * size * sizeof(husky_insn_t *)) ;
+
+            if (NULL == next) {
+              free(todo) ;
+              return husky_error_set(husky, HUSKY_ERROR_OUT_OF_MEMORY) ;
+            }
+
+            todo  = next ;
+            size *= 2 ;
+          }
+
+          todo[used++] = insn->target ;
+        }
+      }
+
+      if (husky_insn_is_final(opr_code))
+        break ;
+    }
+  }
+
+  free(todo) ;
+
+  if (HUSKY_SUCCESS != husky_image_verify(husky))
+    return husky_error_set(husky, HUSKY_ERROR_STACK_OVERFLOW) ;
+
+  return husky_error_get(husky) ;
+}
+
+#define _UNO(__0)
+#define _NEG(__0)      (-(__0))
+#define _NOT(__0)      (~(__0))
+#define _BNO(__0, __1)
+#define _ADD(__0, __1) ((__0) + (__1))
+#define _SUB(__0, __1) ((__0) - (__1))
+#define _MUL(__0, __1) ((__0) * (__1))
+#define _DIV(__0, __1) ((__0) / (__1))
+#define _MOD(__0, __1) ((__0) % (__1))
+#define _AND(__0, __1) ((__0) & (__1))
+#define _OR(__0, __1)  ((__0) | (__1))
+#define _XOR(__0, __1) ((__0) ^ (__1))
+#define _SHL(__0, __1) ((__0) << (__1))
+#define _SHR(__0, __1) ((__0) >> (__1))
+#define _IEQ(__0, __1) ((__0) == (__1))
+#define _INE(__0, __1) ((__0) != (__1))
+#define _ILS(__0, __1) ((__0) <  (__1))
+#define _ILE(__0, __1) ((__0) <= (__1))
+#define _IGT(__0, __1) ((__0) >  (__1))
+#define _IGE(__0, __1) ((__0) >= (__1))
+#define _IFF(__0)      (0 == (__0))
+#define _IFT(__0)      (0 != (__0))
+#define _SRT(__0)      (sqrt(__0))
+#define _ITF(__0)      ((f64_t)(__0))
+
+/* Truncates toward zero, saturates out of range and takes NaN to 0, where a
+ * plain cast would be undefined. */
+#define _FTI(__0)                                    \
+  (                                                  \
+    isnan(__0)         ? 0         :                 \
+    (__0) <= -0x1p63   ? INT64_MIN :                 \
+    (__0) >=  0x1p63   ? INT64_MAX : (i64_t)(__0)    \
+  )
+
+/* Only used by `_BINOP`, after the first operand has been taken. */
+#define _IDZ(__0, __1)                               \
+  {                                                  \
+    if (0 == (__1)) {                                \
+      sp -= sizeof(husky_object_t) ;                 \
+      _FILL() ;                                      \
+      _RAISE(HUSKY_ERROR_DIVISION_BY_ZERO) ;         \
+    }                                                \
+  }
+
+/* The top of the stack, the slot at `sp - 8`, lives in `tos` while the
+ * interpreter runs and its copy in `mem_data` may be stale. `_SPILL` writes
+ * it back before anything that reads the stack through memory and `_FILL`
+ * reloads it after anything that may have written there. */
+#define _SPILL()                                                \
+  {                                                             \
+    if (sizeof(husky_object_t) <= sp)                           \
+      *(husky_object_t *)(mem_data + sp - sizeof(husky_object_t)) = tos ; \
+  }
+
+#define _FILL()                                                 \
+  {                                                             \
+    if (sizeof(husky_object_t) <= sp)                           \
+      tos = *(husky_object_t *)(mem_data + sp - sizeof(husky_object_t)) ; \
+  }
+
+#define _CACHED(__addr, __size)                                 \
+  (                                                             \
+    sizeof(husky_object_t) <= sp                   &&           \
+    (__addr) < sp                                  &&           \
+    sp - sizeof(husky_object_t) < (__addr) + (__size)           \
+  )
+
+#define _SYNC()          \
+  {                      \
+    _SPILL() ;           \
+                         \
+    husky->ip = ip ;     \
+    husky->fp = fp ;     \
+    husky->sp = sp ;     \
+  }
+
+#define _RELOAD()        \
+  {                      \
+    ip = husky->ip ;     \
+    fp = husky->fp ;     \
+    sp = husky->sp ;     \
+                         \
+    _FILL() ;            \
+  }
+
+#define _RAISE(__err_code)                 \
+  {                                        \
+    err_code = (__err_code) ;              \
+    ip       = insn->addr + insn->size ;   \
+    goto _raise ;                          \
+  }
+
+#define _PUSH(__object)                                         \
+  {                                                             \
+    if (stack_top - sizeof(husky_object_t) < sp)                \
+      _RAISE(HUSKY_ERROR_STACK_OVERFLOW) ;                      \
+                                                                \
+    _SPILL() ;                                                  \
+                                                                \
+    tos = (__object) ;                                          \
+    sp += sizeof(husky_object_t) ;                              \
+  }
+
+#define _POP(__object)                                          \
+  {                                                             \
+    if (sp < sizeof(husky_object_t))                            \
+      _RAISE(HUSKY_ERROR_STACK_UNDERFLOW) ;                     \
+                                                                \
+    (__object) = tos ;                                          \
+    sp -= sizeof(husky_object_t) ;                              \
+                                                                \
+    _FILL() ;                                                   \
+  }
+
+#define _PEEK(__base, __rel_addr, __addr)                                \
+  {                                                                      \
+    i64_t rel_addr = (i64_t)(__rel_addr) * (i64_t)sizeof(husky_object_t) ; \
+                                                                         \
+    if (rel_addr < 0) {                                                  \
+      if ((__base) < (u64_t)-rel_addr)                                   \
+        _RAISE(HUSKY_ERROR_STACK_UNDERFLOW) ;                            \
+    } else if (stack_top - sizeof(husky_object_t) < (__base) + rel_addr) { \
+      _RAISE(HUSKY_ERROR_STACK_OVERFLOW) ;                               \
+    }                                                                    \
+                                                                         \
+    (__addr) = (__base) + rel_addr ;                                     \
+  }
+
+/* Only valid inside a verified run, where both slots exist. */
+#define _PUSH_UNCHECKED(__object)                                            \
+  {                                                                          \
+    *(husky_object_t *)(mem_data + sp - sizeof(husky_object_t)) = tos ;      \
+                                                                             \
+    tos = (__object) ;                                                       \
+    sp += sizeof(husky_object_t) ;                                           \
+  }
+
+#define _POP_UNCHECKED(__object)                                             \
+  {                                                                          \
+    (__object) = tos ;                                                       \
+    sp -= sizeof(husky_object_t) ;                                           \
+    tos = *(husky_object_t *)(mem_data + sp - sizeof(husky_object_t)) ;      \
+  }
+
+#define _SLOT_GET(__addr, __object)                             \
+  {                                                             \
+    _SPILL() ;                                                  \
+                                                                \
+    (__object) = *(husky_object_t *)(mem_data + (__addr)) ;     \
+  }
+
+#define _SLOT_SET(__addr, __object)                             \
+  {                                                             \
+    *(husky_object_t *)(mem_data + (__addr)) = (__object) ;     \
+                                                                \
+    _FILL() ;                                                   \
+  }
+
+/* Where the memory accessible from `addr` ends, as `husky_memory_end`
+ * tells: at the guard page when `addr` is below its end, at `end` past
+ * it, so one comparison keeps an access off both. */
+#define _LIMIT(__addr, __end)                                  \
+  ((__addr) < guard_end ? stack_top : (__end))
+
+#define _ACCESS(__addr, __size)                                \
+  {                                                            \
+    if (_LIMIT((__addr), mem_limit) - (__size) < (__addr))     \
+      _RAISE(HUSKY_ERROR_OUT_OF_MEMORY) ;                      \
+  }
+
+#define _ADDRESS(__addr, __size)          \
+  {                                       \
+    (__addr) &= mem_mask ;                \
+                                          \
+    _ACCESS((__addr), (__size)) ;         \
+  }
+
+#define _BLOCK(__addr, __size)                                      \
+  {                                                                 \
+    u64_t end = _LIMIT((__addr), mem_size) ;                        \
+                                                                    \
+    if (end < (__size) || end - (__size) < (__addr))                \
+      _RAISE(HUSKY_ERROR_OUT_OF_MEMORY) ;                           \
+  }
+
+#define _INVALIDATE(__addr, __size)                        \
+  {                                                        \
+    u64_t next = insn->addr + insn->size ;                 \
+                                                           \
+    if (husky_insn_invalidate(husky, (__addr), (__size))) { \
+      ip   = next ;                                        \
+      link = NULL ;                                        \
+      goto _lookup ;                                       \
+    }                                                      \
+  }
+
+#define _STRING(__addr)                                             \
+  {                                                                 \
+    u64_t end = husky_memory_end(husky, (__addr)) ;                 \
+                                                                    \
+    if (end <= (__addr))                                            \
+      _RAISE(HUSKY_ERROR_INVALID_ADDRESS) ;                         \
+                                                                    \
+    if (NULL == memchr(mem_data + (__addr), 0, end - (__addr)))     \
+      _RAISE(HUSKY_ERROR_INVALID_STRING) ;                          \
+  }
+
+/* With GCC and Clang every handler ends in its own indirect jump through a
+ * table of label addresses (direct threading), which gives the branch
+ * predictor one history per opcode instead of a single shared `switch`
+ * jump. Define `HUSKY_NO_THREADED` to force the portable `switch`. */
+#if (defined(__GNUC__) || defined(__clang__)) && !defined(HUSKY_NO_THREADED)
+# define HUSKY_THREADED
+#endif
+
+/* Opcodes with an unchecked handler have two: `_UNCHECKED` runs when the
+ * bounds of the run hold and `_CASE_CHECKED` when they do not. */
+#ifdef HUSKY_THREADED
+# define _DISPATCH()           goto * dispatch_table[insn->opr_code] ;
+# define _CASE(__opr_code)     _case_##__opr_code :
+# define _CASE_CHECKED(__code) _case_##__code :
+# define _UNCHECKED(__code)    _unchecked_##__code :
+# define _DEFAULT              _case_default :
+# define _CONTINUE()           { _BUDGET() ; goto * dispatch_table[insn->opr_code] ; }
+# define _ENTER()                                 \
+  {                                               \
+    if (_UNVERIFIED()) {                          \
+      _BUDGET() ;                                 \
+      goto * checked_table[insn->opr_code] ;      \
+    }                                             \
+                                                  \
+    _CONTINUE() ;                                 \
+  }
+#else
+# define _DISPATCH()           switch (insn->opr_code | checked)
+# define _CASE(__opr_code)     case __opr_code : case HUSKY_INSN_CHECKED | __opr_code :
+# define _CASE_CHECKED(__code) case HUSKY_INSN_CHECKED | __code :
+# define _UNCHECKED(__code)    case __code :
+# define _DEFAULT              default :
+# define _CONTINUE()           continue
+# define _ENTER()                                           \
+  {                                                         \
+    checked = _UNVERIFIED() ? HUSKY_INSN_CHECKED : 0 ;      \
+    continue ;                                              \
+  }
+#endif
+
+#define _UNVERIFIED()                                               \
+  (                                                                 \
+    sp        < (u64_t)insn->need * sizeof(husky_object_t)      ||  \
+    stack_top < (u64_t)insn->grow * sizeof(husky_object_t) + sp     \
+  )
+
+#define _BUDGET()          \
+  {                        \
+    if (0 == budget) {     \
+      ip = insn->addr ;    \
+      goto _exit ;         \
+    }                      \
+                           \
+    --budget ;             \
+  }
+
+#define _NEXT()            \
+  {                        \
+    ++insn ;               \
+    _ENTER() ;             \
+  }
+
+#define _NEXT_UNCHECKED()  \
+  {                        \
+    ++insn ;               \
+    _CONTINUE() ;          \
+  }
+
+#define _BRANCH()                   \
+  {                                 \
+    if (NULL == insn->target) {     \
+      link = insn ;                 \
+      ip   = insn->opr_data ;       \
+      goto _lookup ;                \
+    }                               \
+                                    \
+    insn = insn->target ;           \
+    _MARK() ;                       \
+    _ENTER() ;                      \
+  }
+
+/* Where the trace about to run starts and the budget left by then, for
+ * `husky_run_guarded` to report a fault at, since a fault leaves the
+ * locals behind. */
+#define _MARK()                             \
+  {                                         \
+    husky->fault_ip     = insn->addr ;      \
+    husky->fault_budget = budget     ;      \
+  }
+
+/* Walks decoded records with `ip` materialized only when a handler needs a
+ * guest address; `fp` and `sp` live in locals and are written back only on
+ * exit or around calls that observe `husky`. */
+static u32_t husky_execute (husky_t * husky, u64_t max_steps)
+{
+  u64_t    ip       = husky->ip       ;
+  u64_t    fp       = husky->fp       ;
+  u64_t    sp       = husky->sp       ;
+  u64_t    mem_size = husky->mem_size ;
+  u8_t *   mem_data = husky->mem_data ;
+  u64_t    budget   = max_steps       ;
+  u32_t    err_code = HUSKY_SUCCESS   ;
+  u32_t    result   = HUSKY_SUCCESS   ;
+
+  /* The bound of `sp`. The guard page above it, when there is one, is only
+   * a backstop: the checks keep pushes below it, and loads and stores out
+   * of it, so that running into it raises an error the usual way. */
+  u64_t    stack_top = husky->stack_top ;
+  u64_t    guard_end = 0 != husky->stack_guard ? stack_top + husky->stack_guard : 0 ;
+
+  /* Guarded memory leaves loads and stores to the fault handler once
+   * their address is masked to 32 bits. */
+  u32_t    mem_guarded = husky->mem_guarded ;
+  u64_t    mem_mask    = 0 != mem_guarded ? UINT32_MAX : UINT64_MAX ;
+  u64_t    mem_limit   = 0 != mem_guarded ? UINT64_MAX : mem_size   ;
+
+  husky_insn_t * insn = NULL ;
+  husky_insn_t * link = NULL ;
+
+  husky_object_t object_0, object_1, object_2, object_3, tos ;
+
+#ifndef HUSKY_THREADED
+  u32_t checked = 0 ;
+#endif
+
+  husky->fault_ip     = ip                       ;
+  husky->fault_budget = budget                   ;
+  husky->fault_steps  = husky->steps + max_steps ;
+
+  tos.u = 0 ;
+  _FILL() ;
+
+#define _UNAOP(__opr_code, __type_0, __type_2, __check, __func)           \
+  _CASE_CHECKED(__opr_code) {                                             \
+    if (sp < sizeof(husky_object_t))                                      \
+      _RAISE(HUSKY_ERROR_STACK_UNDERFLOW) ;                               \
+                                                                          \
+    object_0 = tos ;                                                      \
+                                                                          \
+    __check(object_0.__type_0) ;                                          \
+    tos.__type_2 = __func(object_0.__type_0) ;                            \
+  } _NEXT() ;                                                             \
+                                                                          \
+  _UNCHECKED(__opr_code) {                                                \
+    object_0 = tos ;                                                      \
+                                                                          \
+    __check(object_0.__type_0) ;                                          \
+    tos.__type_2 = __func(object_0.__type_0) ;                            \
+  } _NEXT_UNCHECKED() ;
+
+#define _BINOP(__opr_code, __type_0, __type_1, __type_2, __check, __func) \
+  _CASE_CHECKED(__opr_code) {                                             \
+    if (sp < 2 * sizeof(husky_object_t))                                  \
+      _RAISE(HUSKY_ERROR_STACK_UNDERFLOW) ;                               \
+                                                                          \
+    object_0 = tos ;                                                      \
+    sp      -= sizeof(husky_object_t) ;                                   \
+    object_1 = *(husky_object_t *)(mem_data + sp - sizeof(husky_object_t)) ; \
+                                                                          \
+    __check(object_0.__type_0, object_1.__type_1) ;                       \
+    tos.__type_2 = __func(object_0.__type_0, object_1.__type_1) ;         \
+  } _NEXT() ;                                                             \
+                                                                          \
+  _UNCHECKED(__opr_code) {                                                \
+    object_0 = tos ;                                                      \
+    sp      -= sizeof(husky_object_t) ;                                   \
+    object_1 = *(husky_object_t *)(mem_data + sp - sizeof(husky_object_t)) ; \
+                                                                          \
+    __check(object_0.__type_0, object_1.__type_1) ;                       \
+    tos.__type_2 = __func(object_0.__type_0, object_1.__type_1) ;         \
+  } _NEXT_UNCHECKED() ;
+
+/* Moves to the next record of a fused sequence as if it were dispatched, so
+ * budget stops and errors point at the record that would have run. */
+#define _STEP()            \
+  {                        \
+    ++insn ;               \
+    _BUDGET() ;            \
+  }
+
+#define _CMPJMP(__opr_code, __func, __cond)                                \
+  _CASE_CHECKED(__opr_code) {                                             \
+    if (sp < 2 * sizeof(husky_object_t))                                  \
+      _RAISE(HUSKY_ERROR_STACK_UNDERFLOW) ;                               \
+                                                                          \
+    object_0 = tos ;                                                      \
+    sp      -= sizeof(husky_object_t) ;                                   \
+    object_1 = *(husky_object_t *)(mem_data + sp - sizeof(husky_object_t)) ; \
+    tos.u    = __func(object_0.u, object_1.u) ;                           \
+                                                                          \
+    _STEP() ;                                                             \
+    _POP(object_0) ;                                                      \
+                                                                          \
+    if (__cond(object_0.u))                                               \
+      _BRANCH() ;                                                         \
+  } _NEXT() ;                                                             \
+                                                                          \
+  _UNCHECKED(__opr_code) {                                                \
+    object_0 = tos ;                                                      \
+    sp      -= sizeof(husky_object_t) ;                                   \
+    object_1 = *(husky_object_t *)(mem_data + sp - sizeof(husky_object_t)) ; \
+    tos.u    = __func(object_0.u, object_1.u) ;                           \
+                                                                          \
+    _STEP() ;                                                             \
+    _POP_UNCHECKED(object_0) ;                                            \
+                                                                          \
+    if (__cond(object_0.u))                                               \
+      _BRANCH() ;                                                         \
+  } _NEXT_UNCHECKED() ;
+
+/* Loads and stores of a fixed size, run once the stack is known to hold
+ * their operands. A load replaces the address on top of the stack, whose
+ * slot is the only one cached, so memory below it is current and the slot
+ * itself is spilled when the address points into it. */
+#define _LOAD(__opr_code, __type)                                         \
+  _UNCHECKED(__opr_code) {                                                \
+    u64_t  addr = tos.u & mem_mask ;                                      \
+    __type value ;                                                        \
+                                                                          \
+    if (_LIMIT(addr, mem_limit) - sizeof(__type) < addr) {                \
+      _POP(object_0) ;                                                    \
+      _RAISE(HUSKY_ERROR_OUT_OF_MEMORY) ;                                 \
+    }                                                                     \
+                                                                          \
+    if (_CACHED(addr, sizeof(__type))) {                                  \
+      _SPILL() ;                                                          \
+    }                                                                     \
+                                                                          \
+    memcpy(&value, mem_data + addr, sizeof(__type)) ;                     \
+    tos.u = value ;                                                       \
+  } _NEXT_UNCHECKED() ;
+
+#define _STORE(__opr_code, __type)                                        \
+  _UNCHECKED(__opr_code) {                                                \
+    __type value ;                                                        \
+                                                                          \
+    _POP_UNCHECKED(object_0) ;                                            \
+    _POP_UNCHECKED(object_1) ;                                            \
+    _ADDRESS(object_0.u, sizeof(__type)) ;                                \
+                                                                          \
+    value = (__type)object_1.u ;                                          \
+    memcpy(mem_data + object_0.u, &value, sizeof(__type)) ;               \
+                                                                          \
+    if (_CACHED(object_0.u, sizeof(__type))) {                            \
+      _FILL() ;                                                           \
+    }                                                                     \
+                                                                          \
+    _INVALIDATE(object_0.u, sizeof(__type)) ;                             \
+  } _NEXT_UNCHECKED() ;
+
+#ifdef HUSKY_THREADED
+  static const void * const dispatch_table [256] = {
+    [ HUSKY_INST_HALT                      ] = &&_case_HUSKY_INST_HALT                           ,
+    [ HUSKY_INST_NOOP                      ] = &&_case_HUSKY_INST_NOOP                           ,
+    [ HUSKY_INST_BREAKPOINT                ] = &&_case_HUSKY_INST_BREAKPOINT                     ,
+    [ HUSKY_INST_ERROR_SET                 ] = &&_case_HUSKY_INST_ERROR_SET                      ,
+    [ HUSKY_INST_ERROR_GET                 ] = &&_case_HUSKY_INST_ERROR_GET                      ,
+    [ HUSKY_INST_JUMP                      ] = &&_case_HUSKY_INST_JUMP                           ,
+    [ HUSKY_INST_JUMP_INDIRECT             ] = &&_case_HUSKY_INST_JUMP_INDIRECT                  ,
+    [ HUSKY_INST_JUMP_IF_FALSE             ] = &&_unchecked_HUSKY_INST_JUMP_IF_FALSE             ,
+    [ HUSKY_INST_JUMP_IF_TRUE              ] = &&_unchecked_HUSKY_INST_JUMP_IF_TRUE              ,
+    [ HUSKY_INST_CALL                      ] = &&_unchecked_HUSKY_INST_CALL                      ,
+    [ HUSKY_INST_CALL_INDIRECT             ] = &&_case_HUSKY_INST_CALL_INDIRECT                  ,
+    [ HUSKY_INST_RETURN                    ] = &&_case_HUSKY_INST_RETURN                         ,
+    [ HUSKY_INST_MODULE_OPEN               ] = &&_case_HUSKY_INST_MODULE_OPEN                    ,
+    [ HUSKY_INST_MODULE_CLOSE              ] = &&_case_HUSKY_INST_MODULE_CLOSE                   ,
+    [ HUSKY_INST_NATIVE_LOAD               ] = &&_case_HUSKY_INST_NATIVE_LOAD                    ,
+    [ HUSKY_INST_NATIVE_CALL               ] = &&_case_HUSKY_INST_NATIVE_CALL                    ,
+    [ HUSKY_INST_IS_NULL_POINTER           ] = &&_case_HUSKY_INST_IS_NULL_POINTER                ,
+    [ HUSKY_INST_IS_NOT_NULL_POINTER       ] = &&_case_HUSKY_INST_IS_NOT_NULL_POINTER            ,
+    [ HUSKY_INST_IS_STRING                 ] = &&_case_HUSKY_INST_IS_STRING                      ,
+    [ HUSKY_INST_ENTER                     ] = &&_case_HUSKY_INST_ENTER                          ,
+    [ HUSKY_INST_LEAVE                     ] = &&_case_HUSKY_INST_LEAVE                          ,
+    [ HUSKY_INST_PUSH_8                    ] = &&_unchecked_HUSKY_INST_PUSH_8                    ,
+    [ HUSKY_INST_PUSH_16                   ] = &&_unchecked_HUSKY_INST_PUSH_16                   ,
+    [ HUSKY_INST_PUSH_32                   ] = &&_unchecked_HUSKY_INST_PUSH_32                   ,
+    [ HUSKY_INST_PUSH_64                   ] = &&_unchecked_HUSKY_INST_PUSH_64                   ,
+    [ HUSKY_INST_POP                       ] = &&_unchecked_HUSKY_INST_POP                       ,
+    [ HUSKY_INST_EXCHANGE                  ] = &&_case_HUSKY_INST_EXCHANGE                       ,
+    [ HUSKY_INST_SET_AT_SP                 ] = &&_unchecked_HUSKY_INST_SET_AT_SP                 ,
+    [ HUSKY_INST_GET_AT_SP                 ] = &&_unchecked_HUSKY_INST_GET_AT_SP                 ,
+    [ HUSKY_INST_SET_AT_FP                 ] = &&_unchecked_HUSKY_INST_SET_AT_FP                 ,
+    [ HUSKY_INST_GET_AT_FP                 ] = &&_unchecked_HUSKY_INST_GET_AT_FP                 ,
+    [ HUSKY_INST_STORE_8                   ] = &&_unchecked_HUSKY_INST_STORE_8                   ,
+    [ HUSKY_INST_STORE_16                  ] = &&_unchecked_HUSKY_INST_STORE_16                  ,
+    [ HUSKY_INST_STORE_32                  ] = &&_unchecked_HUSKY_INST_STORE_32                  ,
+    [ HUSKY_INST_STORE_64                  ] = &&_unchecked_HUSKY_INST_STORE_64                  ,
+    [ HUSKY_INST_LOAD_8                    ] = &&_unchecked_HUSKY_INST_LOAD_8                    ,
+    [ HUSKY_INST_LOAD_16                   ] = &&_unchecked_HUSKY_INST_LOAD_16                   ,
+    [ HUSKY_INST_LOAD_32                   ] = &&_unchecked_HUSKY_INST_LOAD_32                   ,
+    [ HUSKY_INST_LOAD_64                   ] = &&_unchecked_HUSKY_INST_LOAD_64                   ,
+    [ HUSKY_INST_NEGATE                    ] = &&_unchecked_HUSKY_INST_NEGATE                    ,
+    [ HUSKY_INST_ADD                       ] = &&_unchecked_HUSKY_INST_ADD                       ,
+    [ HUSKY_INST_SUBTRACT                  ] = &&_unchecked_HUSKY_INST_SUBTRACT                  ,
+    [ HUSKY_INST_MULTIPLY                  ] = &&_unchecked_HUSKY_INST_MULTIPLY                  ,
+    [ HUSKY_INST_DIVIDE                    ] = &&_unchecked_HUSKY_INST_DIVIDE                    ,
+    [ HUSKY_INST_MODULO                    ] = &&_unchecked_HUSKY_INST_MODULO                    ,
+    [ HUSKY_INST_INT_MULTIPLY              ] = &&_unchecked_HUSKY_INST_INT_MULTIPLY              ,
+    [ HUSKY_INST_INT_DIVIDE                ] = &&_unchecked_HUSKY_INST_INT_DIVIDE                ,
+    [ HUSKY_INST_INT_MODULO                ] = &&_unchecked_HUSKY_INST_INT_MODULO                ,
+    [ HUSKY_INST_IS_EQUAL                  ] = &&_unchecked_HUSKY_INST_IS_EQUAL                  ,
+    [ HUSKY_INST_IS_NOT_EQUAL              ] = &&_unchecked_HUSKY_INST_IS_NOT_EQUAL              ,
+    [ HUSKY_INST_IS_LESS                   ] = &&_unchecked_HUSKY_INST_IS_LESS                   ,
+    [ HUSKY_INST_IS_LESS_OR_EQUAL          ] = &&_unchecked_HUSKY_INST_IS_LESS_OR_EQUAL          ,
+    [ HUSKY_INST_IS_GREATER                ] = &&_unchecked_HUSKY_INST_IS_GREATER                ,
+    [ HUSKY_INST_IS_GREATER_OR_EQUAL       ] = &&_unchecked_HUSKY_INST_IS_GREATER_OR_EQUAL       ,
+    [ HUSKY_INST_BIT_NOT                   ] = &&_unchecked_HUSKY_INST_BIT_NOT                   ,
+    [ HUSKY_INST_BIT_AND                   ] = &&_unchecked_HUSKY_INST_BIT_AND                   ,
+    [ HUSKY_INST_BIT_OR                    ] = &&_unchecked_HUSKY_INST_BIT_OR                    ,
+    [ HUSKY_INST_BIT_XOR                   ] = &&_unchecked_HUSKY_INST_BIT_XOR                   ,
+    [ HUSKY_INST_BIT_SHIFT_LEFT            ] = &&_unchecked_HUSKY_INST_BIT_SHIFT_LEFT            ,
+    [ HUSKY_INST_BIT_SHIFT_RIGHT           ] = &&_unchecked_HUSKY_INST_BIT_SHIFT_RIGHT           ,
+    [ HUSKY_INST_BIT_INT_SHIFT_RIGHT       ] = &&_unchecked_HUSKY_INST_BIT_INT_SHIFT_RIGHT       ,
+    [ HUSKY_INST_PRINT                     ] = &&_case_HUSKY_INST_PRINT                          ,
+    [ HUSKY_INST_MEMORY_COPY               ] = &&_case_HUSKY_INST_MEMORY_COPY                    ,
+    [ HUSKY_INST_MEMORY_FILL               ] = &&_case_HUSKY_INST_MEMORY_FILL                    ,
+    [ HUSKY_INST_MEMORY_COMPARE            ] = &&_case_HUSKY_INST_MEMORY_COMPARE                 ,
+    [ HUSKY_INST_VECTOR                    ] = &&_case_HUSKY_INST_VECTOR                         ,
+    [ HUSKY_INST_VECTOR_REDUCE             ] = &&_case_HUSKY_INST_VECTOR_REDUCE                  ,
+    [ HUSKY_INST_FLOAT_NEGATE              ] = &&_unchecked_HUSKY_INST_FLOAT_NEGATE              ,
+    [ HUSKY_INST_FLOAT_ADD                 ] = &&_unchecked_HUSKY_INST_FLOAT_ADD                 ,
+    [ HUSKY_INST_FLOAT_SUBTRACT            ] = &&_unchecked_HUSKY_INST_FLOAT_SUBTRACT            ,
+    [ HUSKY_INST_FLOAT_MULTIPLY            ] = &&_unchecked_HUSKY_INST_FLOAT_MULTIPLY            ,
+    [ HUSKY_INST_FLOAT_DIVIDE              ] = &&_unchecked_HUSKY_INST_FLOAT_DIVIDE              ,
+    [ HUSKY_INST_FLOAT_SQUARE_ROOT         ] = &&_unchecked_HUSKY_INST_FLOAT_SQUARE_ROOT         ,
+    [ HUSKY_INST_FLOAT_IS_EQUAL            ] = &&_unchecked_HUSKY_INST_FLOAT_IS_EQUAL            ,
+    [ HUSKY_INST_FLOAT_IS_NOT_EQUAL        ] = &&_unchecked_HUSKY_INST_FLOAT_IS_NOT_EQUAL        ,
+    [ HUSKY_INST_FLOAT_IS_LESS             ] = &&_unchecked_HUSKY_INST_FLOAT_IS_LESS             ,
+    [ HUSKY_INST_FLOAT_IS_LESS_OR_EQUAL    ] = &&_unchecked_HUSKY_INST_FLOAT_IS_LESS_OR_EQUAL    ,
+    [ HUSKY_INST_FLOAT_IS_GREATER          ] = &&_unchecked_HUSKY_INST_FLOAT_IS_GREATER          ,
+    [ HUSKY_INST_FLOAT_IS_GREATER_OR_EQUAL ] = &&_unchecked_HUSKY_INST_FLOAT_IS_GREATER_OR_EQUAL ,
+    [ HUSKY_INST_INT_TO_FLOAT              ] = &&_unchecked_HUSKY_INST_INT_TO_FLOAT              ,
+    [ HUSKY_INST_FLOAT_TO_INT              ] = &&_unchecked_HUSKY_INST_FLOAT_TO_INT              ,
+
+    [ HUSKY_N_INSTS ... HUSKY_INSN_FP_ADD - 1 ] = &&_case_default ,
+
+    [ HUSKY_INSN_FP_ADD                            ] = &&_case_HUSKY_INSN_FP_ADD                                 ,
+    [ HUSKY_INSN_PUSH_STORE_64                     ] = &&_case_HUSKY_INSN_PUSH_STORE_64                          ,
+    [ HUSKY_INSN_IS_EQUAL_JUMP_IF_FALSE            ] = &&_unchecked_HUSKY_INSN_IS_EQUAL_JUMP_IF_FALSE            ,
+    [ HUSKY_INSN_IS_EQUAL_JUMP_IF_TRUE             ] = &&_unchecked_HUSKY_INSN_IS_EQUAL_JUMP_IF_TRUE             ,
+    [ HUSKY_INSN_IS_NOT_EQUAL_JUMP_IF_FALSE        ] = &&_unchecked_HUSKY_INSN_IS_NOT_EQUAL_JUMP_IF_FALSE        ,
+    [ HUSKY_INSN_IS_NOT_EQUAL_JUMP_IF_TRUE         ] = &&_unchecked_HUSKY_INSN_IS_NOT_EQUAL_JUMP_IF_TRUE         ,
+    [ HUSKY_INSN_IS_LESS_JUMP_IF_FALSE             ] = &&_unchecked_HUSKY_INSN_IS_LESS_JUMP_IF_FALSE             ,
+    [ HUSKY_INSN_IS_LESS_JUMP_IF_TRUE              ] = &&_unchecked_HUSKY_INSN_IS_LESS_JUMP_IF_TRUE              ,
+    [ HUSKY_INSN_IS_LESS_OR_EQUAL_JUMP_IF_FALSE    ] = &&_unchecked_HUSKY_INSN_IS_LESS_OR_EQUAL_JUMP_IF_FALSE    ,
+    [ HUSKY_INSN_IS_LESS_OR_EQUAL_JUMP_IF_TRUE     ] = &&_unchecked_HUSKY_INSN_IS_LESS_OR_EQUAL_JUMP_IF_TRUE     ,
+    [ HUSKY_INSN_IS_GREATER_JUMP_IF_FALSE          ] = &&_unchecked_HUSKY_INSN_IS_GREATER_JUMP_IF_FALSE          ,
+    [ HUSKY_INSN_IS_GREATER_JUMP_IF_TRUE           ] = &&_unchecked_HUSKY_INSN_IS_GREATER_JUMP_IF_TRUE           ,
+    [ HUSKY_INSN_IS_GREATER_OR_EQUAL_JUMP_IF_FALSE ] = &&_unchecked_HUSKY_INSN_IS_GREATER_OR_EQUAL_JUMP_IF_FALSE ,
+    [ HUSKY_INSN_IS_GREATER_OR_EQUAL_JUMP_IF_TRUE  ] = &&_unchecked_HUSKY_INSN_IS_GREATER_OR_EQUAL_JUMP_IF_TRUE  ,
+
+    [ HUSKY_INSN_IS_GREATER_OR_EQUAL_JUMP_IF_TRUE + 1 ... HUSKY_INSN_JIT_CALL - 1 ] = &&_case_default ,
+
+    [ HUSKY_INSN_JIT_CALL            ] = &&_case_HUSKY_INSN_JIT_CALL            ,
+    [ HUSKY_INSN_JIT_JUMP            ] = &&_case_HUSKY_INSN_JIT_JUMP            ,
+    [ HUSKY_INSN_JIT_JUMP_IF_FALSE   ] = &&_case_HUSKY_INSN_JIT_JUMP_IF_FALSE   ,
+    [ HUSKY_INSN_JIT_JUMP_IF_TRUE    ] = &&_case_HUSKY_INSN_JIT_JUMP_IF_TRUE    ,
+
+    [ HUSKY_INSN_JIT_JUMP_IF_TRUE + 1 ... HUSKY_INSN_LINK - 1 ] = &&_case_default ,
+
+    [ HUSKY_INSN_LINK                ] = &&_case_HUSKY_INSN_LINK
+  } ;
+
+  static const void * const checked_table  [256] = {
+    [ HUSKY_INST_HALT                      ] = &&_case_HUSKY_INST_HALT                      ,
+    [ HUSKY_INST_NOOP                      ] = &&_case_HUSKY_INST_NOOP                      ,
+    [ HUSKY_INST_BREAKPOINT                ] = &&_case_HUSKY_INST_BREAKPOINT                ,
+    [ HUSKY_INST_ERROR_SET                 ] = &&_case_HUSKY_INST_ERROR_SET                 ,
+    [ HUSKY_INST_ERROR_GET                 ] = &&_case_HUSKY_INST_ERROR_GET                 ,
+    [ HUSKY_INST_JUMP                      ] = &&_case_HUSKY_INST_JUMP                      ,
+    [ HUSKY_INST_JUMP_INDIRECT             ] = &&_case_HUSKY_INST_JUMP_INDIRECT             ,
+    [ HUSKY_INST_JUMP_IF_FALSE             ] = &&_case_HUSKY_INST_JUMP_IF_FALSE             ,
+    [ HUSKY_INST_JUMP_IF_TRUE              ] = &&_case_HUSKY_INST_JUMP_IF_TRUE              ,
+    [ HUSKY_INST_CALL                      ] = &&_case_HUSKY_INST_CALL                      ,
+    [ HUSKY_INST_CALL_INDIRECT             ] = &&_case_HUSKY_INST_CALL_INDIRECT             ,
+    [ HUSKY_INST_RETURN                    ] = &&_case_HUSKY_INST_RETURN                    ,
+    [ HUSKY_INST_MODULE_OPEN               ] = &&_case_HUSKY_INST_MODULE_OPEN               ,
+    [ HUSKY_INST_MODULE_CLOSE              ] = &&_case_HUSKY_INST_MODULE_CLOSE              ,
+    [ HUSKY_INST_NATIVE_LOAD               ] = &&_case_HUSKY_INST_NATIVE_LOAD               ,
+    [ HUSKY_INST_NATIVE_CALL               ] = &&_case_HUSKY_INST_NATIVE_CALL               ,
+    [ HUSKY_INST_IS_NULL_POINTER           ] = &&_case_HUSKY_INST_IS_NULL_POINTER           ,
+    [ HUSKY_INST_IS_NOT_NULL_POINTER       ] = &&_case_HUSKY_INST_IS_NOT_NULL_POINTER       ,
+    [ HUSKY_INST_IS_STRING                 ] = &&_case_HUSKY_INST_IS_STRING                 ,
+    [ HUSKY_INST_ENTER                     ] = &&_case_HUSKY_INST_ENTER                     ,
+    [ HUSKY_INST_LEAVE                     ] = &&_case_HUSKY_INST_LEAVE                     ,
+    [ HUSKY_INST_PUSH_8                    ] = &&_case_HUSKY_INST_PUSH_8                    ,
+    [ HUSKY_INST_PUSH_16                   ] = &&_case_HUSKY_INST_PUSH_16                   ,
+    [ HUSKY_INST_PUSH_32                   ] = &&_case_HUSKY_INST_PUSH_32                   ,
+    [ HUSKY_INST_PUSH_64                   ] = &&_case_HUSKY_INST_PUSH_64                   ,
+    [ HUSKY_INST_POP                       ] = &&_case_HUSKY_INST_POP                       ,
+    [ HUSKY_INST_EXCHANGE                  ] = &&_case_HUSKY_INST_EXCHANGE                  ,
+    [ HUSKY_INST_SET_AT_SP                 ] = &&_case_HUSKY_INST_SET_AT_SP                 ,
+    [ HUSKY_INST_GET_AT_SP                 ] = &&_case_HUSKY_INST_GET_AT_SP                 ,
+    [ HUSKY_INST_SET_AT_FP                 ] = &&_case_HUSKY_INST_SET_AT_FP                 ,
+    [ HUSKY_INST_GET_AT_FP                 ] = &&_case_HUSKY_INST_GET_AT_FP                 ,
+    [ HUSKY_INST_STORE_8                   ] = &&_case_HUSKY_INST_STORE_8                   ,
+    [ HUSKY_INST_STORE_16                  ] = &&_case_HUSKY_INST_STORE_16                  ,
+    [ HUSKY_INST_STORE_32                  ] = &&_case_HUSKY_INST_STORE_32                  ,
+    [ HUSKY_INST_STORE_64                  ] = &&_case_HUSKY_INST_STORE_64                  ,
+    [ HUSKY_INST_LOAD_8                    ] = &&_case_HUSKY_INST_LOAD_8                    ,
+    [ HUSKY_INST_LOAD_16                   ] = &&_case_HUSKY_INST_LOAD_16                   ,
+    [ HUSKY_INST_LOAD_32                   ] = &&_case_HUSKY_INST_LOAD_32                   ,
+    [ HUSKY_INST_LOAD_64                   ] = &&_case_HUSKY_INST_LOAD_64                   ,
+    [ HUSKY_INST_NEGATE                    ] = &&_case_HUSKY_INST_NEGATE                    ,
+    [ HUSKY_INST_ADD                       ] = &&_case_HUSKY_INST_ADD                       ,
+    [ HUSKY_INST_SUBTRACT                  ] = &&_case_HUSKY_INST_SUBTRACT                  ,
+    [ HUSKY_INST_MULTIPLY                  ] = &&_case_HUSKY_INST_MULTIPLY                  ,
+    [ HUSKY_INST_DIVIDE                    ] = &&_case_HUSKY_INST_DIVIDE                    ,
+    [ HUSKY_INST_MODULO                    ] = &&_case_HUSKY_INST_MODULO                    ,
+    [ HUSKY_INST_INT_MULTIPLY              ] = &&_case_HUSKY_INST_INT_MULTIPLY              ,
+    [ HUSKY_INST_INT_DIVIDE                ] = &&_case_HUSKY_INST_INT_DIVIDE                ,
+    [ HUSKY_INST_INT_MODULO                ] = &&_case_HUSKY_INST_INT_MODULO                ,
+    [ HUSKY_INST_IS_EQUAL                  ] = &&_case_HUSKY_INST_IS_EQUAL                  ,
+    [ HUSKY_INST_IS_NOT_EQUAL              ] = &&_case_HUSKY_INST_IS_NOT_EQUAL              ,
+    [ HUSKY_INST_IS_LESS                   ] = &&_case_HUSKY_INST_IS_LESS                   ,
+    [ HUSKY_INST_IS_LESS_OR_EQUAL          ] = &&_case_HUSKY_INST_IS_LESS_OR_EQUAL          ,
+    [ HUSKY_INST_IS_GREATER                ] = &&_case_HUSKY_INST_IS_GREATER                ,
+    [ HUSKY_INST_IS_GREATER_OR_EQUAL       ] = &&_case_HUSKY_INST_IS_GREATER_OR_EQUAL       ,
+    [ HUSKY_INST_BIT_NOT                   ] = &&_case_HUSKY_INST_BIT_NOT                   ,
+    [ HUSKY_INST_BIT_AND                   ] = &&_case_HUSKY_INST_BIT_AND                   ,
+    [ HUSKY_INST_BIT_OR                    ] = &&_case_HUSKY_INST_BIT_OR                    ,
+    [ HUSKY_INST_BIT_XOR                   ] = &&_case_HUSKY_INST_BIT_XOR                   ,
+    [ HUSKY_INST_BIT_SHIFT_LEFT            ] = &&_case_HUSKY_INST_BIT_SHIFT_LEFT            ,
+    [ HUSKY_INST_BIT_SHIFT_RIGHT           ] = &&_case_HUSKY_INST_BIT_SHIFT_RIGHT           ,
+    [ HUSKY_INST_BIT_INT_SHIFT_RIGHT       ] = &&_case_HUSKY_INST_BIT_INT_SHIFT_RIGHT       ,
+    [ HUSKY_INST_PRINT                     ] = &&_case_HUSKY_INST_PRINT                     ,
+    [ HUSKY_INST_MEMORY_COPY               ] = &&_case_HUSKY_INST_MEMORY_COPY               ,
+    [ HUSKY_INST_MEMORY_FILL               ] = &&_case_HUSKY_INST_MEMORY_FILL               ,
+    [ HUSKY_INST_MEMORY_COMPARE            ] = &&_case_HUSKY_INST_MEMORY_COMPARE            ,
+    [ HUSKY_INST_VECTOR                    ] = &&_case_HUSKY_INST_VECTOR                    ,
+    [ HUSKY_INST_VECTOR_REDUCE             ] = &&_case_HUSKY_INST_VECTOR_REDUCE             ,
+    [ HUSKY_INST_FLOAT_NEGATE              ] = &&_case_HUSKY_INST_FLOAT_NEGATE              ,
+    [ HUSKY_INST_FLOAT_ADD                 ] = &&_case_HUSKY_INST_FLOAT_ADD                 ,
+    [ HUSKY_INST_FLOAT_SUBTRACT            ] = &&_case_HUSKY_INST_FLOAT_SUBTRACT            ,
+    [ HUSKY_INST_FLOAT_MULTIPLY            ] = &&_case_HUSKY_INST_FLOAT_MULTIPLY            ,
+    [ HUSKY_INST_FLOAT_DIVIDE              ] = &&_case_HUSKY_INST_FLOAT_DIVIDE              ,
+    [ HUSKY_INST_FLOAT_SQUARE_ROOT         ] = &&_case_HUSKY_INST_FLOAT_SQUARE_ROOT         ,
+    [ HUSKY_INST_FLOAT_IS_EQUAL            ] = &&_case_HUSKY_INST_FLOAT_IS_EQUAL            ,
+    [ HUSKY_INST_FLOAT_IS_NOT_EQUAL        ] = &&_case_HUSKY_INST_FLOAT_IS_NOT_EQUAL        ,
+    [ HUSKY_INST_FLOAT_IS_LESS             ] = &&_case_HUSKY_INST_FLOAT_IS_LESS             ,
+    [ HUSKY_INST_FLOAT_IS_LESS_OR_EQUAL    ] = &&_case_HUSKY_INST_FLOAT_IS_LESS_OR_EQUAL    ,
+    [ HUSKY_INST_FLOAT_IS_GREATER          ] = &&_case_HUSKY_INST_FLOAT_IS_GREATER          ,
+    [ HUSKY_INST_FLOAT_IS_GREATER_OR_EQUAL ] = &&_case_HUSKY_INST_FLOAT_IS_GREATER_OR_EQUAL ,
+    [ HUSKY_INST_INT_TO_FLOAT              ] = &&_case_HUSKY_INST_INT_TO_FLOAT              ,
+    [ HUSKY_INST_FLOAT_TO_INT              ] = &&_case_HUSKY_INST_FLOAT_TO_INT              ,
+
+    [ HUSKY_N_INSTS ... HUSKY_INSN_FP_ADD - 1 ] = &&_case_default ,
+
+    [ HUSKY_INSN_FP_ADD                            ] = &&_case_HUSKY_INSN_FP_ADD                                 ,
+    [ HUSKY_INSN_PUSH_STORE_64                     ] = &&_case_HUSKY_INSN_PUSH_STORE_64                          ,
+    [ HUSKY_INSN_IS_EQUAL_JUMP_IF_FALSE            ] = &&_case_HUSKY_INSN_IS_EQUAL_JUMP_IF_FALSE                 ,
+    [ HUSKY_INSN_IS_EQUAL_JUMP_IF_TRUE             ] = &&_case_HUSKY_INSN_IS_EQUAL_JUMP_IF_TRUE                  ,
+    [ HUSKY_INSN_IS_NOT_EQUAL_JUMP_IF_FALSE        ] = &&_case_HUSKY_INSN_IS_NOT_EQUAL_JUMP_IF_FALSE             ,
+    [ HUSKY_INSN_IS_NOT_EQUAL_JUMP_IF_TRUE         ] = &&_case_HUSKY_INSN_IS_NOT_EQUAL_JUMP_IF_TRUE              ,
+    [ HUSKY_INSN_IS_LESS_JUMP_IF_FALSE             ] = &&_case_HUSKY_INSN_IS_LESS_JUMP_IF_FALSE                  ,
+    [ HUSKY_INSN_IS_LESS_JUMP_IF_TRUE              ] = &&_case_HUSKY_INSN_IS_LESS_JUMP_IF_TRUE                   ,
+    [ HUSKY_INSN_IS_LESS_OR_EQUAL_JUMP_IF_FALSE    ] = &&_case_HUSKY_INSN_IS_LESS_OR_EQUAL_JUMP_IF_FALSE         ,
+    [ HUSKY_INSN_IS_LESS_OR_EQUAL_JUMP_IF_TRUE     ] = &&_case_HUSKY_INSN_IS_LESS_OR_EQUAL_JUMP_IF_TRUE          ,
+    [ HUSKY_INSN_IS_GREATER_JUMP_IF_FALSE          ] = &&_case_HUSKY_INSN_IS_GREATER_JUMP_IF_FALSE               ,
+    [ HUSKY_INSN_IS_GREATER_JUMP_IF_TRUE           ] = &&_case_HUSKY_INSN_IS_GREATER_JUMP_IF_TRUE                ,
+    [ HUSKY_INSN_IS_GREATER_OR_EQUAL_JUMP_IF_FALSE ] = &&_case_HUSKY_INSN_IS_GREATER_OR_EQUAL_JUMP_IF_FALSE      ,
+    [ HUSKY_INSN_IS_GREATER_OR_EQUAL_JUMP_IF_TRUE  ] = &&_case_HUSKY_INSN_IS_GREATER_OR_EQUAL_JUMP_IF_TRUE       ,
+
+    [ HUSKY_INSN_IS_GREATER_OR_EQUAL_JUMP_IF_TRUE + 1 ... HUSKY_INSN_JIT_CALL - 1 ] = &&_case_default ,
+
+    [ HUSKY_INSN_JIT_CALL            ] = &&_case_HUSKY_INSN_JIT_CALL            ,
+    [ HUSKY_INSN_JIT_JUMP            ] = &&_case_HUSKY_INSN_JIT_JUMP            ,
+    [ HUSKY_INSN_JIT_JUMP_IF_FALSE   ] = &&_case_HUSKY_INSN_JIT_JUMP_IF_FALSE   ,
+    [ HUSKY_INSN_JIT_JUMP_IF_TRUE    ] = &&_case_HUSKY_INSN_JIT_JUMP_IF_TRUE    ,
+
+    [ HUSKY_INSN_JIT_JUMP_IF_TRUE + 1 ... HUSKY_INSN_LINK - 1 ] = &&_case_default ,
+
+    [ HUSKY_INSN_LINK                ] = &&_case_HUSKY_INSN_LINK
+  } ;
+#endif
+
+  goto _lookup ;
+
+  for (;;) {
+    _BUDGET() ;
+    _DISPATCH() {
+    _CASE(HUSKY_INST_HALT) {
+      husky->state = HUSKY_STATE_HALTED ;
+      ip           = insn->addr + insn->size ;
+    } goto _exit ;
+
+    _CASE(HUSKY_INST_NOOP) {
+      /* nothing */
+    } _NEXT() ;
+
+    _CASE(HUSKY_INST_BREAKPOINT) {
+      husky->state = HUSKY_STATE_BREAKED ;
+      ip           = insn->addr + insn->size ;
+    } goto _exit ;
+
+    _CASE(HUSKY_INST_ERROR_SET) {
+      _POP(object_0) ;
+
+      if (HUSKY_SUCCESS != object_0.u)
+        _RAISE(HUSKY_N_ERRORS <= object_0.u ? HUSKY_ERROR_UNDEFINED_ERROR : object_0.u) ;
+
+      husky->err_code = HUSKY_SUCCESS ;
+    } _NEXT() ;
+
+    _CASE(HUSKY_INST_ERROR_GET) {
+      object_0.u = husky->err_code ;
+
+      _PUSH(object_0) ;
+    } _NEXT() ;
+
+    _CASE(HUSKY_INST_JUMP) {
+      _BRANCH() ;
+    }
+
+    _CASE(HUSKY_INST_JUMP_INDIRECT) {
+      _POP(object_0) ;
+
+      ip = insn->addr + insn->size + object_0.i ;
+    } goto _lookup ;
+
+    _CASE_CHECKED(HUSKY_INST_JUMP_IF_FALSE) {
+      _POP(object_0) ;
+
+      if (0 == object_0.u)
+        _BRANCH() ;
+    } _NEXT() ;
+
+    _UNCHECKED(HUSKY_INST_JUMP_IF_FALSE) {
+      _POP_UNCHECKED(object_0) ;
+
+      if (0 == object_0.u)
+        _BRANCH() ;
+    } _NEXT_UNCHECKED() ;
+
+    _CASE_CHECKED(HUSKY_INST_JUMP_IF_TRUE) {
+      _POP(object_0) ;
+
+      if (0 != object_0.u)
+        _BRANCH() ;
+    } _NEXT() ;
+
+    _UNCHECKED(HUSKY_INST_JUMP_IF_TRUE) {
+      _POP_UNCHECKED(object_0) ;
+
+      if (0 != object_0.u)
+        _BRANCH() ;
+    } _NEXT_UNCHECKED() ;
+
+    _CASE_CHECKED(HUSKY_INST_CALL) {
+      object_0.u = insn->addr + insn->size ;
+
+      _PUSH(object_0) ;
+      _BRANCH() ;
+    }
+
+    _UNCHECKED(HUSKY_INST_CALL) {
+      object_0.u = insn->addr + insn->size ;
+
+      _PUSH_UNCHECKED(object_0) ;
+      _BRANCH() ;
+    }
+
+    _CASE(HUSKY_INST_CALL_INDIRECT) {
+      _POP(object_1) ;
+
+      object_0.u = insn->addr + insn->size ;
+
+      _PUSH(object_0) ;
+
+      ip = object_0.u + object_1.i ;
+    } goto _lookup ;
+
+    _CASE(HUSKY_INST_RETURN) {
+      _POP(object_0) ;
+
+      ip = object_0.u ;
+    } goto _lookup ;
+
+    _CASE(HUSKY_INST_MODULE_OPEN) {
+      _POP(object_0) ;
+      _POP(object_1) ;
+
+      _SPILL() ;
+      _STRING(object_0.u) ;
+
+      if (HUSKY_SUCCESS != (result = husky_bind_module(husky, (char *)mem_data + object_0.u, object_1.i, &object_2.u)))
+        _RAISE(result) ;
+
+      _PUSH(object_2) ;
+    } _NEXT() ;
+
+    _CASE(HUSKY_INST_MODULE_CLOSE) {
+      _POP(object_0) ;
+
+      if (HUSKY_SUCCESS != (result = husky_bind_close(husky, object_0.u)))
+        _RAISE(result) ;
+    } _NEXT() ;
+
+    _CASE(HUSKY_INST_NATIVE_LOAD) {
+      _POP(object_0) ;
+      _POP(object_1) ;
+
+      _SPILL() ;
+      _STRING(object_1.u) ;
+
+      if (HUSKY_SUCCESS != (result = husky_bind_native(husky, object_0.u, (char *)mem_data + object_1.u, &object_2.u)))
+        _RAISE(result) ;
+
+      _PUSH(object_2) ;
+    } _NEXT() ;
+
+    /* Typed natives get their arguments from here and never see the stack
+     * registers, so only those that may use the instance get them synced
+     * and only those that may use the stack get them reloaded. */
+    _CASE(HUSKY_INST_NATIVE_CALL) {
+      _POP(object_0) ;
+
+      const husky_bind_native_t * native = husky_bind_get(husky, object_0.u) ;
+
+      if (NULL == native)
+        _RAISE(HUSKY_ERROR_INVALID_NATIVE) ;
+
+      ip = insn->addr + insn->size ;
+
+      /* Natives may write to `stdout` themselves. */
+      if (NULL == native->typed || 0 == (native->signature->flags & HUSKY_SIGNATURE_PURE))
+        husky_output_flush(husky) ;
+
+      if (NULL == native->typed) {
+        _SYNC() ;
+        native->func(husky) ;
+        _RELOAD() ;
+
+        if (HUSKY_SUCCESS != husky->err_code) {
+          err_code = husky->err_code ;
+          goto _raise ;
+        }
+
+        if (HUSKY_STATE_READY != husky->state)
+          goto _exit ;
+
+        goto _lookup ;
+      }
+
+      const husky_signature_t * signature = native->signature ;
+      u64_t                     size      = native->slots * sizeof(husky_object_t) ;
+      husky_object_t            args [HUSKY_SIGNATURE_SLOTS_MAX] ;
+      u32_t                     i, j ;
+      int                       flushed   = 0 ;
+
+      if (sp < size)
+        _RAISE(HUSKY_ERROR_STACK_UNDERFLOW) ;
+
+      _SPILL() ;
+
+      sp -= size ;
+      memcpy(args, mem_data + sp, size) ;
+
+      _FILL() ;
+
+      for (i = j = 0 ; i < signature->arg_count ; ++i, ++j) {
+        if (HUSKY_TYPE_STRING == signature->arg_types[i]) {
+          _STRING(args[j].u) ;
+
+          args[j].p = mem_data + args[j].u ;
+        } else if (HUSKY_TYPE_BUFFER == signature->arg_types[i]) {
+          if (
+            mem_size < args[j + 1].u || mem_size - args[j + 1].u < args[j].u ||
+            husky_memory_guarded(husky, args[j].u, args[j + 1].u)
+          )
+            _RAISE(HUSKY_ERROR_INVALID_ADDRESS) ;
+
+          args[j].p = mem_data + args[j].u ;
+          ++j ;
+        }
+      }
+
+      if (0 != (signature->flags & HUSKY_SIGNATURE_PURE)) {
+        object_1.u = native->typed(husky, args) ;
+      } else {
+        _SYNC() ;
+        object_1.u = native->typed(husky, args) ;
+
+        if (0 == (signature->flags & HUSKY_SIGNATURE_NO_STACK))
+          _RELOAD() ;
+
+        if (HUSKY_SUCCESS != husky->err_code) {
+          err_code = husky->err_code ;
+          goto _raise ;
+        }
+      }
+
+      /* A buffer may cover the top of the stack or decoded code. */
+      _FILL() ;
+
+      if (HUSKY_TYPE_VOID != signature->ret_type)
+        _PUSH(object_1) ;
+
+      for (i = j = 0 ; i < signature->arg_count ; ++i, ++j) {
+        if (HUSKY_TYPE_BUFFER == signature->arg_types[i]) {
+          flushed |= husky_insn_invalidate(husky, (u8_t *)args[j].p - mem_data, args[j + 1].u) ;
+          ++j ;
+        }
+      }
+
+      if (0 != flushed)
+        link = NULL ;
+
+      if (HUSKY_STATE_READY != husky->state)
+        goto _exit ;
+
+      if (0 != flushed || 0 == (signature->flags & (HUSKY_SIGNATURE_PURE | HUSKY_SIGNATURE_NO_STACK)))
+        goto _lookup ;
+    } _NEXT() ;
+
+    _CASE(HUSKY_INST_IS_NULL_POINTER) {
+      _POP(object_0) ;
+
+      object_1.u = NULL == object_0.p ;
+
+      _PUSH(object_1) ;
+    } _NEXT() ;
+
+    _CASE(HUSKY_INST_IS_NOT_NULL_POINTER) {
+      _POP(object_0) ;
+
+      object_1.u = NULL != object_0.p ;
+
+      _PUSH(object_1) ;
+    } _NEXT() ;
+
+    _CASE(HUSKY_INST_IS_STRING) {
+      _POP(object_0) ;
+      _SPILL() ;
+
+      u64_t end = husky_memory_end(husky, object_0.u) ;
+
+      object_1.u =
+        object_0.u < end &&
+        NULL != memchr(mem_data + object_0.u, 0, end - object_0.u) ;
+
+      _PUSH(object_1) ;
+    } _NEXT() ;
+
+    _CASE(HUSKY_INST_ENTER) {
+      object_0.u = fp ;
+
+      _PUSH(object_0) ;
+
+      if (stack_top - sp < (u64_t)insn->opr_data * sizeof(husky_object_t))
+        _RAISE(HUSKY_ERROR_STACK_OVERFLOW) ;
+
+      fp = sp ;
+
+      if (0 != insn->opr_data) {
+        _SPILL() ;
+
+        sp += (u64_t)insn->opr_data * sizeof(husky_object_t) ;
+
+        _FILL() ;
+      }
+    } _NEXT() ;
+
+    _CASE(HUSKY_INST_LEAVE) {
+      _SPILL() ;
+
+      sp = fp ;
+
+      _FILL() ;
+      _POP(object_0) ;
+
+      fp = object_0.u ;
+    } _NEXT() ;
+
+    _CASE_CHECKED(HUSKY_INST_PUSH_8)
+    _CASE_CHECKED(HUSKY_INST_PUSH_16)
+    _CASE_CHECKED(HUSKY_INST_PUSH_32)
+    _CASE_CHECKED(HUSKY_INST_PUSH_64) {
+      object_0.u = insn->opr_data ;
+
+      _PUSH(object_0) ;
+    } _NEXT() ;
+
+    _UNCHECKED(HUSKY_INST_PUSH_8)
+    _UNCHECKED(HUSKY_INST_PUSH_16)
+    _UNCHECKED(HUSKY_INST_PUSH_32)
+    _UNCHECKED(HUSKY_INST_PUSH_64) {
+      object_0.u = insn->opr_data ;
+
+      _PUSH_UNCHECKED(object_0) ;
+    } _NEXT_UNCHECKED() ;
+
+    _CASE_CHECKED(HUSKY_INST_POP) {
+      _POP(object_0) ;
+    } _NEXT() ;
+
+    _UNCHECKED(HUSKY_INST_POP) {
+      _POP_UNCHECKED(object_0) ;
+    } _NEXT_UNCHECKED() ;
+
+    _CASE(HUSKY_INST_EXCHANGE) {
+      u64_t addr ;
+
+      _POP(object_0) ;
+      _PEEK(sp, insn->opr_data, addr) ;
+      _SLOT_GET(addr, object_1) ;
+      _SLOT_SET(addr, object_0) ;
+      _PUSH(object_1) ;
+    } _NEXT() ;
+
+    _CASE_CHECKED(HUSKY_INST_SET_AT_SP) {
+      u64_t addr ;
+
+      _POP(object_0) ;
+      _PEEK(sp, insn->opr_data, addr) ;
+      _SLOT_SET(addr, object_0) ;
+    } _NEXT() ;
+
+    _UNCHECKED(HUSKY_INST_SET_AT_SP) {
+      u64_t addr ;
+
+      _POP_UNCHECKED(object_0) ;
+
+      addr = sp + (i64_t)insn->opr_data * (i64_t)sizeof(husky_object_t) ;
+
+      *(husky_object_t *)(mem_data + addr) = object_0 ;
+      tos = *(husky_object_t *)(mem_data + sp - sizeof(husky_object_t)) ;
+    } _NEXT_UNCHECKED() ;
+
+    _CASE_CHECKED(HUSKY_INST_GET_AT_SP) {
+      u64_t addr ;
+
+      _PEEK(sp, insn->opr_data, addr) ;
+      _SLOT_GET(addr, object_0) ;
+      _PUSH(object_0) ;
+    } _NEXT() ;
+
+    _UNCHECKED(HUSKY_INST_GET_AT_SP) {
+      u64_t addr = sp + (i64_t)insn->opr_data * (i64_t)sizeof(husky_object_t) ;
+
+      *(husky_object_t *)(mem_data + sp - sizeof(husky_object_t)) = tos ;
+
+      tos = *(husky_object_t *)(mem_data + addr) ;
+      sp += sizeof(husky_object_t) ;
+    } _NEXT_UNCHECKED() ;
+
+    _CASE_CHECKED(HUSKY_INST_SET_AT_FP) {
+      u64_t addr ;
+
+      _POP(object_0) ;
+      _PEEK(fp, insn->opr_data, addr) ;
+      _SLOT_SET(addr, object_0) ;
+    } _NEXT() ;
+
+    _UNCHECKED(HUSKY_INST_SET_AT_FP) {
+      u64_t addr ;
+
+      _POP_UNCHECKED(object_0) ;
+      _PEEK(fp, insn->opr_data, addr) ;
+
+      *(husky_object_t *)(mem_data + addr) = object_0 ;
+      tos = *(husky_object_t *)(mem_data + sp - sizeof(husky_object_t)) ;
+    } _NEXT_UNCHECKED() ;
+
+    _CASE_CHECKED(HUSKY_INST_GET_AT_FP) {
+      u64_t addr ;
+
+      _PEEK(fp, insn->opr_data, addr) ;
+      _SLOT_GET(addr, object_0) ;
+      _PUSH(object_0) ;
+    } _NEXT() ;
+
+    _UNCHECKED(HUSKY_INST_GET_AT_FP) {
+      u64_t addr ;
+
+      _PEEK(fp, insn->opr_data, addr) ;
+
+      *(husky_object_t *)(mem_data + sp - sizeof(husky_object_t)) = tos ;
+
+      tos = *(husky_object_t *)(mem_data + addr) ;
+      sp += sizeof(husky_object_t) ;
+    } _NEXT_UNCHECKED() ;
+
+    _CASE_CHECKED(HUSKY_INST_STORE_8)
+    _CASE_CHECKED(HUSKY_INST_STORE_16)
+    _CASE_CHECKED(HUSKY_INST_STORE_32)
+    _CASE_CHECKED(HUSKY_INST_STORE_64) {
+      u64_t size = 1 << (insn->opr_code - HUSKY_INST_STORE_8) ;
+
+      _POP(object_0) ;
+      _POP(object_1) ;
+      _ADDRESS(object_0.u, size) ;
+
+      memcpy(mem_data + object_0.u, &object_1.u, size) ;
+
+      if (_CACHED(object_0.u, size)) {
+        _FILL() ;
+      }
+
+      _INVALIDATE(object_0.u, size) ;
+    } _NEXT() ;
+
+    _CASE_CHECKED(HUSKY_INST_LOAD_8)
+    _CASE_CHECKED(HUSKY_INST_LOAD_16)
+    _CASE_CHECKED(HUSKY_INST_LOAD_32)
+    _CASE_CHECKED(HUSKY_INST_LOAD_64) {
+      u64_t size = 1 << (insn->opr_code - HUSKY_INST_LOAD_8) ;
+
+      /* The address may point at its own slot, which only `tos` holds. */
+      if (_CACHED(tos.u & mem_mask, size)) {
+        _SPILL() ;
+      }
+
+      _POP(object_0) ;
+      _ADDRESS(object_0.u, size) ;
+
+      object_1.u = 0 ;
+      memcpy(&object_1.u, mem_data + object_0.u, size) ;
+
+      _PUSH(object_1) ;
+    } _NEXT() ;
+
+    _STORE( HUSKY_INST_STORE_8  , u8_t  )
+    _STORE( HUSKY_INST_STORE_16 , u16_t )
+    _STORE( HUSKY_INST_STORE_32 , u32_t )
+    _STORE( HUSKY_INST_STORE_64 , u64_t )
+    _LOAD(  HUSKY_INST_LOAD_8   , u8_t  )
+    _LOAD(  HUSKY_INST_LOAD_16  , u16_t )
+    _LOAD(  HUSKY_INST_LOAD_32  , u32_t )
+    _LOAD(  HUSKY_INST_LOAD_64  , u64_t )
+
+    _UNAOP( HUSKY_INST_NEGATE              , u ,     u , _UNO , _NEG )
+    _BINOP( HUSKY_INST_ADD                 , u , u , u , _BNO , _ADD )
+    _BINOP( HUSKY_INST_SUBTRACT            , u , u , u , _BNO , _SUB )
+    _BINOP( HUSKY_INST_MULTIPLY            , u , u , u , _BNO , _MUL )
+    _BINOP( HUSKY_INST_DIVIDE              , u , u , u , _IDZ , _DIV )
+    _BINOP( HUSKY_INST_MODULO              , u , u , u , _IDZ , _MOD )
+    _BINOP( HUSKY_INST_INT_MULTIPLY        , i , i , i , _BNO , _MUL )
+    _BINOP( HUSKY_INST_INT_DIVIDE          , i , i , i , _IDZ , _DIV )
+    _BINOP( HUSKY_INST_INT_MODULO          , i , i , i , _IDZ , _MOD )
+    _BINOP( HUSKY_INST_IS_EQUAL            , u , u , u , _BNO , _IEQ )
+    _BINOP( HUSKY_INST_IS_NOT_EQUAL        , u , u , u , _BNO , _INE )
+    _BINOP( HUSKY_INST_IS_LESS             , u , u , u , _BNO , _ILS )
+    _BINOP( HUSKY_INST_IS_LESS_OR_EQUAL    , u , u , u , _BNO , _ILE )
+    _BINOP( HUSKY_INST_IS_GREATER          , u , u , u , _BNO , _IGT )
+    _BINOP( HUSKY_INST_IS_GREATER_OR_EQUAL , u , u , u , _BNO , _IGE )
+    _UNAOP( HUSKY_INST_BIT_NOT             , u ,     u , _UNO , _NOT )
+    _BINOP( HUSKY_INST_BIT_AND             , u , u , u , _BNO , _AND )
+    _BINOP( HUSKY_INST_BIT_OR              , u , u , u , _BNO , _OR  )
+    _BINOP( HUSKY_INST_BIT_XOR             , u , u , u , _BNO , _XOR )
+    _BINOP( HUSKY_INST_BIT_SHIFT_LEFT      , u , u , u , _IDZ , _SHL )
+    _BINOP( HUSKY_INST_BIT_SHIFT_RIGHT     , u , u , u , _IDZ , _SHR )
+    _BINOP( HUSKY_INST_BIT_INT_SHIFT_RIGHT , i , u , i , _BNO , _SHR )
+
+    /* IEEE 754 doubles through the `f` view: dividing by zero gives an
+     * infinity, and comparing with NaN is false except for `IS_NOT_EQUAL`. */
+    _UNAOP( HUSKY_INST_FLOAT_NEGATE              , f ,     f , _UNO , _NEG )
+    _BINOP( HUSKY_INST_FLOAT_ADD                 , f , f , f , _BNO , _ADD )
+    _BINOP( HUSKY_INST_FLOAT_SUBTRACT            , f , f , f , _BNO , _SUB )
+    _BINOP( HUSKY_INST_FLOAT_MULTIPLY            , f , f , f , _BNO , _MUL )
+    _BINOP( HUSKY_INST_FLOAT_DIVIDE              , f , f , f , _BNO , _DIV )
+    _UNAOP( HUSKY_INST_FLOAT_SQUARE_ROOT         , f ,     f , _UNO , _SRT )
+    _BINOP( HUSKY_INST_FLOAT_IS_EQUAL            , f , f , u , _BNO , _IEQ )
+    _BINOP( HUSKY_INST_FLOAT_IS_NOT_EQUAL        , f , f , u , _BNO , _INE )
+    _BINOP( HUSKY_INST_FLOAT_IS_LESS             , f , f , u , _BNO , _ILS )
+    _BINOP( HUSKY_INST_FLOAT_IS_LESS_OR_EQUAL    , f , f , u , _BNO , _ILE )
+    _BINOP( HUSKY_INST_FLOAT_IS_GREATER          , f , f , u , _BNO , _IGT )
+    _BINOP( HUSKY_INST_FLOAT_IS_GREATER_OR_EQUAL , f , f , u , _BNO , _IGE )
+    _UNAOP( HUSKY_INST_INT_TO_FLOAT              , i ,     f , _UNO , _ITF )
+    _UNAOP( HUSKY_INST_FLOAT_TO_INT              , f ,     i , _UNO , _FTI )
+
+    _CASE(HUSKY_INST_PRINT) {
+      _POP(object_0) ;
+      _POP(object_1) ;
+
+      char   text [32] ;
+      char * tail = text + sizeof(text) ;
+      char * head = tail ;
+
+      switch (object_0.u) {
+      case 0x00 : {
+        head = husky_output_dec(tail, object_1.u) ;
+      } break ;
+
+      case 0x01 : {
+        head = husky_output_dec(tail, object_1.i < 0 ? -object_1.u : object_1.u) ;
+
+        if (object_1.i < 0)
+          *--head = '-' ;
+      } break ;
+
+      case 0x02 : {
+        head = husky_output_hex(tail, object_1.u, "0123456789abcdef") ;
+      } break ;
+
+      case 0x03 : {
+        head = husky_output_hex(tail, object_1.u, "0123456789ABCDEF") ;
+      } break ;
+
+      case 0x04 : {
+        *--head = (char)object_1.u ;
+      } break ;
+
+      case 0x05 : {
+        _SPILL() ;
+        _STRING(object_1.u) ;
+
+        husky_output(husky, (char *)mem_data + object_1.u, strlen((char *)mem_data + object_1.u)) ;
+      } break ;
+
+      case 0x06 : {
+        head = text ;
+        tail = text + husky_output_float(text, sizeof(text), object_1.f) ;
+      } break ;
+
+      default :
+        break ;
+      }
+
+      if (head < tail)
+        husky_output(husky, head, tail - head) ;
+    } _NEXT() ;
+
+    /* Block operations check their ranges once and leave the bytes to the
+     * C library, whose routines are vectorised. Those that read spill
+     * before taking their operands, so a source over the slots of those
+     * reads what the stack held. */
+    _CASE(HUSKY_INST_MEMORY_COPY) {
+      _SPILL() ;
+      _POP(object_0) ;
+      _POP(object_1) ;
+      _POP(object_2) ;
+      _BLOCK(object_1.u, object_0.u) ;
+      _BLOCK(object_2.u, object_0.u) ;
+
+      memmove(mem_data + object_2.u, mem_data + object_1.u, object_0.u) ;
+
+      if (_CACHED(object_2.u, object_0.u)) {
+        _FILL() ;
+      }
+
+      _INVALIDATE(object_2.u, object_0.u) ;
+    } _NEXT() ;
+
+    _CASE(HUSKY_INST_MEMORY_FILL) {
+      _POP(object_0) ;
+      _POP(object_1) ;
+      _POP(object_2) ;
+      _BLOCK(object_2.u, object_0.u) ;
+
+      memset(mem_data + object_2.u, (u8_t)object_1.u, object_0.u) ;
+
+      if (_CACHED(object_2.u, object_0.u)) {
+        _FILL() ;
+      }
+
+      _INVALIDATE(object_2.u, object_0.u) ;
+    } _NEXT() ;
+
+    _CASE(HUSKY_INST_MEMORY_COMPARE) {
+      _SPILL() ;
+      _POP(object_0) ;
+      _POP(object_1) ;
+      _POP(object_2) ;
+      _BLOCK(object_1.u, object_0.u) ;
+      _BLOCK(object_2.u, object_0.u) ;
+
+      int order = memcmp(mem_data + object_2.u, mem_data + object_1.u, object_0.u) ;
+
+      object_0.i = (0 < order) - (order < 0) ;
+
+      _PUSH(object_0) ;
+    } _NEXT() ;
+
+    /* Vector operations take lane counts, whose byte sizes must not wrap. */
+    _CASE(HUSKY_INST_VECTOR) {
+      u64_t size ;
+
+      _SPILL() ;
+      _POP(object_0) ;
+      _POP(object_1) ;
+      _POP(object_2) ;
+      _POP(object_3) ;
+
+      size = object_0.u << (insn->opr_data & 3) ;
+
+      if (object_0.u != size >> (insn->opr_data & 3))
+        _RAISE(HUSKY_ERROR_OUT_OF_MEMORY) ;
+
+      _BLOCK(object_1.u, size) ;
+      _BLOCK(object_2.u, size) ;
+      _BLOCK(object_3.u, size) ;
+
+      if (HUSKY_SUCCESS != (result = husky_vector_map(mem_data + object_3.u, mem_data + object_2.u, mem_data + object_1.u, object_0.u, insn->opr_data)))
+        _RAISE(result) ;
+
+      if (_CACHED(object_3.u, size)) {
+        _FILL() ;
+      }
+
+      _INVALIDATE(object_3.u, size) ;
+    } _NEXT() ;
+
+    _CASE(HUSKY_INST_VECTOR_REDUCE) {
+      u64_t size ;
+
+      _SPILL() ;
+      _POP(object_0) ;
+      _POP(object_1) ;
+
+      size = object_0.u << (insn->opr_data & 3) ;
+
+      if (object_0.u != size >> (insn->opr_data & 3))
+        _RAISE(HUSKY_ERROR_OUT_OF_MEMORY) ;
+
+      _BLOCK(object_1.u, size) ;
+
+      if (HUSKY_SUCCESS != (result = husky_vector_reduce(mem_data + object_1.u, object_0.u, insn->opr_data, &object_2.u)))
+        _RAISE(result) ;
+
+      _PUSH(object_2) ;
+    } _NEXT() ;
+
+    _CMPJMP( HUSKY_INSN_IS_EQUAL_JUMP_IF_FALSE            , _IEQ , _IFF )
+    _CMPJMP( HUSKY_INSN_IS_EQUAL_JUMP_IF_TRUE             , _IEQ , _IFT )
+    _CMPJMP( HUSKY_INSN_IS_NOT_EQUAL_JUMP_IF_FALSE        , _INE , _IFF )
+    _CMPJMP( HUSKY_INSN_IS_NOT_EQUAL_JUMP_IF_TRUE         , _INE , _IFT )
+    _CMPJMP( HUSKY_INSN_IS_LESS_JUMP_IF_FALSE             , _ILS , _IFF )
+    _CMPJMP( HUSKY_INSN_IS_LESS_JUMP_IF_TRUE              , _ILS , _IFT )
+    _CMPJMP( HUSKY_INSN_IS_LESS_OR_EQUAL_JUMP_IF_FALSE    , _ILE , _IFF )
+    _CMPJMP( HUSKY_INSN_IS_LESS_OR_EQUAL_JUMP_IF_TRUE     , _ILE , _IFT )
+    _CMPJMP( HUSKY_INSN_IS_GREATER_JUMP_IF_FALSE          , _IGT , _IFF )
+    _CMPJMP( HUSKY_INSN_IS_GREATER_JUMP_IF_TRUE           , _IGT , _IFT )
+    _CMPJMP( HUSKY_INSN_IS_GREATER_OR_EQUAL_JUMP_IF_FALSE , _IGE , _IFF )
+    _CMPJMP( HUSKY_INSN_IS_GREATER_OR_EQUAL_JUMP_IF_TRUE  , _IGE , _IFT )
+
+    /* `GET_AT_FP n ; PUSH_* k ; ADD ; SET_AT_FP n` without the stack, when
+     * the budget and the stack would let all four run. */
+    _CASE(HUSKY_INSN_FP_ADD) {
+      u64_t addr ;
+
+      _PEEK(fp, insn->opr_data, addr) ;
+      _SLOT_GET(addr, object_0) ;
+
+      if (budget < 3 || stack_top < sp + 2 * sizeof(husky_object_t)) {
+        _PUSH(object_0) ;
+        _NEXT() ;
+      }
+
+      object_0.u += insn[1].opr_data ;
+      budget     -= 3 ;
+      insn       += 3 ;
+
+      _SLOT_SET(addr, object_0) ;
+    } _NEXT() ;
+
+    /* `PUSH_* addr ; STORE_64` without pushing `addr`. */
+    _CASE(HUSKY_INSN_PUSH_STORE_64) {
+      object_0.u = insn->opr_data ;
+
+      if (0 == budget || stack_top < sp + sizeof(husky_object_t)) {
+        _PUSH(object_0) ;
+        _NEXT() ;
+      }
+
+      --budget ;
+      ++insn ;
+
+      _POP(object_1) ;
+      _ADDRESS(object_0.u, sizeof(husky_object_t)) ;
+
+      memcpy(mem_data + object_0.u, &object_1.u, sizeof(husky_object_t)) ;
+
+      if (_CACHED(object_0.u, sizeof(husky_object_t))) {
+        _FILL() ;
+      }
+
+      _INVALIDATE(object_0.u, sizeof(husky_object_t)) ;
+    } _NEXT() ;
+
+    _CASE(HUSKY_INSN_LINK) {
+      ++budget ;
+
+      _BRANCH() ;
+    }
+
+    _CASE(HUSKY_INSN_JIT_CALL) {
+      object_0.u = insn->addr + insn->size ;
+
+      _PUSH(object_0) ;
+
+      ip = insn->opr_data ;
+    } goto _jit ;
+
+    _CASE(HUSKY_INSN_JIT_JUMP) {
+      ip = insn->opr_data ;
+    } goto _jit ;
+
+    _CASE(HUSKY_INSN_JIT_JUMP_IF_FALSE) {
+      _POP(object_0) ;
+
+      if (0 == object_0.u) {
+        ip = insn->opr_data ;
+        goto _jit ;
+      }
+    } _NEXT() ;
+
+    _CASE(HUSKY_INSN_JIT_JUMP_IF_TRUE) {
+      _POP(object_0) ;
+
+      if (0 != object_0.u) {
+        ip = insn->opr_data ;
+        goto _jit ;
+      }
+    } _NEXT() ;
+
+    _DEFAULT {
+      _RAISE(HUSKY_ERROR_UNDEFINED_INST) ;
+    }
+    }
+
+  _lookup :
+    if (NULL == (insn = husky_insn_lookup(husky, ip))) {
+      err_code = HUSKY_ERROR_OUT_OF_MEMORY ;
+      goto _raise ;
+    }
+
+    if (NULL != link) {
+      link->target = insn ;
+      link         = NULL ;
+    }
+
+    _MARK() ;
+    _ENTER() ;
+
+  _jit :
+    husky->fault_ip     = ip     ;
+    husky->fault_budget = budget ;
+
+    _SYNC() ;
+    budget = husky_jit_enter(husky, insn, ip, budget) ;
+    _RELOAD() ;
+
+    link = NULL ;
+    goto _lookup ;
+
+  _raise :
+    _SYNC() ;
+    result = husky_error_set(husky, err_code) ;
+
+    if (HUSKY_SUCCESS != result || 0 == budget)
+      goto _exit ;
+
+    --budget ;
+
+    _RELOAD() ;
+    link = NULL ;
+
+    goto _lookup ;
+  }
+
+_exit :
+  _SYNC() ;
+  husky->steps += max_steps - budget ;
+
+#undef _UNAOP
+#undef _BINOP
+#undef _LOAD
+#undef _STORE
+#undef _CMPJMP
+
+  return result ;
+}
+
+/* Runs up to `max_steps` instructions. It stops on halt, on breakpoint, when
+ * the budget is spent or when an error is not handled by `err_func`. A
+ * breakpoint is resumed by the next call. With `verbose` set every
+ * instruction is traced to `log_func` before it runs. */
+static u32_t husky_run_steps (husky_t * husky, u64_t max_steps)
+{
+  u32_t result = HUSKY_SUCCESS ;
+
+  if (0 == husky->verbose)
+    return husky_execute(husky, max_steps) ;
+
+  for (; 0 != max_steps && HUSKY_STATE_READY == husky->state ; --max_steps) {
+    husky_log(
+      husky                                        ,
+      "%012" PRIX64 " | %02" PRIX8 "\n"            ,
+      husky->ip                                    ,
+      husky->ip < husky_memory_end(husky, husky->ip) ? husky->mem_data[husky->ip] : 0
+    ) ;
+
+    if (HUSKY_SUCCESS != (result = husky_execute(husky, 1)))
+      break ;
+  }
+
+  return result ;
+}
+
+/* A fault in a guard comes back here, in the middle of a trace that cannot
+ * be resumed from: the instance halts on the error of the guard with `ip`
+ * and `steps` as the trace started, and `fp` and `sp` kept within the
+ * stack. */
+static u32_t husky_run_guarded (husky_t * husky, u64_t max_steps)
+{
+#ifndef _WIN32
+  husky_fault_t   fault ;
+  husky_fault_t * outer = husky_fault ;
+  u32_t           result ;
+
+  fault.husky    = husky                       ;
+  fault.err_code = HUSKY_ERROR_UNDEFINED_ERROR ;
+
+  if (0 != sigsetjmp(fault.jump, 0)) {
+    husky_fault = outer ;
+
+    husky->ip    = husky->fault_ip                         ;
+    husky->steps = husky->fault_steps - husky->fault_budget ;
+
+    if (husky->stack_top < husky->fp)
+      husky->fp = husky->stack_top ;
+
+    if (husky->stack_top < husky->sp)
+      husky->sp = husky->stack_top ;
+
+    husky->state = HUSKY_STATE_HALTED ;
+
+    return husky_error_set(husky, fault.err_code) ;
+  }
+
+  husky_fault = &fault ;
+  result      = husky_run_steps(husky, max_steps) ;
+  husky_fault = outer ;
+
+  return result ;
+#else
+  return husky_run_steps(husky, max_steps) ;
+#endif
+}
+
+u32_t husky_run (husky_t * husky, u64_t max_steps)
+{
+  if (HUSKY_STATE_HALTED == husky->state)
+    return husky_error_get(husky) ;
+
+  husky->state      = HUSKY_STATE_READY ;
+  husky->mem_frozen = 0 ;
+
+  u32_t result ;
+
+  if (0 == husky->stack_guard && 0 == husky->mem_guarded) {
+    result = husky_run_steps(husky, max_steps) ;
+  } else {
+    result = husky_run_guarded(husky, max_steps) ;
+  }
+
+  if (HUSKY_SUCCESS != result || HUSKY_STATE_READY != husky->state)
+    husky_output_flush(husky) ;
+
+  return result ;
+}
+
+u32_t husky_clock (husky_t * husky)
+{
+  return husky_run(husky, 1) ;
+}
+
+/* Copies `count` bytes at `*offset` out of the image and moves past them,
+ * failing instead when the image ends first. */
+static u32_t husky_image_read (const u8_t * data, u64_t size, u64_t * offset, ptr_t dest, u64_t count)
+{
+  if (size < *offset || size - *offset < count)
+    return HUSKY_FAILURE ;
+
+  memcpy(dest, data + *offset, count) ;
+  *offset += count ;
+
+  return HUSKY_SUCCESS ;
+}
+
+/* Places `size` bytes of a section at `addr`. When guest memory is a
+ * mapping and the section sits at the same offset within a page in the
+ * file and in memory, its whole pages are mapped copy-on-write from the
+ * file, so they are only read when touched and only copied when written;
+ * the partial pages at either end are copied. */
+static void husky_image_place (husky_t * husky, const u8_t * data, u64_t offset, u64_t addr, u64_t size, int fd)
+{
+#ifndef _WIN32
+  u64_t page = (u64_t)sysconf(_SC_PAGESIZE) ;
+
+  if (0 != husky->mem_mapped && 0 <= fd && (offset & (page - 1)) == (addr & (page - 1))) {
+    u64_t head = (page - (addr & (page - 1))) & (page - 1) ;
+
+    if (head < size && page <= size - head) {
+      u64_t body = (size - head) & ~(page - 1) ;
+      void * map = mmap(
+        husky->mem_data + addr + head ,
+        body                          ,
+        PROT_READ | PROT_WRITE        ,
+        MAP_PRIVATE | MAP_FIXED       ,
+        fd                            ,
+        offset + head
+      ) ;
+
+      if (MAP_FAILED != map) {
+        memcpy(husky->mem_data + addr, data + offset, head) ;
+        memcpy(husky->mem_data + addr + head + body, data + offset + head + body, size - head - body) ;
+        return ;
+      }
+    }
+  }
+#endif
+
+  memcpy(husky->mem_data + addr, data + offset, size) ;
+}
+
+/* Zero-fills `size` bytes at `addr`. Whole pages of a mapping are replaced
+ * by fresh anonymous ones instead, so a large BSS section costs nothing
+ * until it is touched, even over pages an earlier image used. */
+static void husky_image_zero (husky_t * husky, u64_t addr, u64_t size)
+{
+#ifndef _WIN32
+  u64_t page = (u64_t)sysconf(_SC_PAGESIZE) ;
+  u64_t head = (page - (addr & (page - 1))) & (page - 1) ;
+
+  if (0 != husky->mem_mapped && head < size && page <= size - head) {
+    u64_t body  = (size - head) & ~(page - 1) ;
+    int   flags = MAP_PRIVATE | MAP_ANONYMOUS | MAP_FIXED ;
+
+# ifdef MAP_NORESERVE
+    flags |= MAP_NORESERVE ;
+# endif
+
+    if (MAP_FAILED != mmap(husky->mem_data + addr + head, body, PROT_READ | PROT_WRITE, flags, -1, 0)) {
+# ifdef MADV_HUGEPAGE
+      if (0 != husky->huge)
+        madvise(husky->mem_data + addr + head, body, MADV_HUGEPAGE) ;
+# endif
+
+      memset(husky->mem_data + addr, 0, head) ;
+      memset(husky->mem_data + addr + head + body, 0, size - head - body) ;
+      return ;
+    }
+  }
+#endif
+
+  memset(husky->mem_data + addr, 0, size) ;
+}
+
+/* Reads a header number: `width` bytes in version 1, a varint after. */
+static u32_t husky_image_number (const u8_t * data, u64_t size, u64_t * offset, u32_t version, u64_t * value, u64_t width)
+{
+  if (1 < version)
+    return husky_image_varint(data, size, offset, value) ;
+
+  *value = 0 ;
+
+  return husky_image_read(data, size, offset, value, width) ;
+}
+
+/* A section header, and how many bytes of data follow it in the file. */
+typedef struct husky_section_s husky_section_t ;
+
+struct husky_section_s {
+  char  name [HUSKY_IMAGE_NAME_MAX + 1] ;
+  u8_t  flags  ;
+  u32_t bind   ;
+  u32_t empty  ;
+  u64_t addr   ;
+  u64_t size   ;
+  u64_t stored ;
+  u64_t check  ;
+} ;
+
+/* Reads and checks the header of section `i`, leaving `offset` on its
+ * data, which it checks is in the file. */
+static u32_t husky_image_section (husky_t * husky, const u8_t * data, u64_t data_size, u64_t * offset, u32_t version, u16_t i, husky_section_t * section)
+{
+  char * name = section->name ;
+  int    j    = 0 ;
+
+  do {
+    if (data_size <= *offset) {
+      husky_log(husky, "Error: Section %u: Is out of binary.\n", i) ;
+      return HUSKY_FAILURE ;
+    }
+
+    name[j] = data[(*offset)++] ;
+  } while (j < HUSKY_IMAGE_NAME_MAX && 0 != name[j++]) ;
+
+  name[j] = 0 ;
+
+  section->flags = 0 ;
+
+  if (1 < version && HUSKY_SUCCESS != husky_image_read(data, data_size, offset, &section->flags, sizeof(section->flags))) {
+    husky_log(husky, "Error: Section `%s` (%u): Cannot read the flags.\n", name, i) ;
+    return HUSKY_FAILURE ;
+  }
+
+  u8_t flags = section->flags ;
+
+  if (
+    0 != (flags & ~HUSKY_SECTION_FLAGS)                                                             ||
+    (0 != (flags & HUSKY_SECTION_READ_ONLY) && 0 != (flags & HUSKY_SECTION_DATA))                   ||
+    (0 != (flags & HUSKY_SECTION_BSS) && 0 != (flags & (HUSKY_SECTION_LZ4 | HUSKY_SECTION_CODE)))   ||
+    (0 != (flags & HUSKY_SECTION_STACK) && HUSKY_SECTION_STACK != flags)
+  ) {
+    husky_log(husky, "Error: Section `%s` (%u): Invalid flags 0x%02" PRIX8 ".\n", name, i, flags) ;
+    return HUSKY_FAILURE ;
+  }
+
+  if (HUSKY_SUCCESS != husky_image_number(data, data_size, offset, version, &section->addr, sizeof(section->addr))) {
+    husky_log(husky, "Error: Section `%s` (%u): Cannot read the address.\n", name, i) ;
+    return HUSKY_FAILURE ;
+  }
+
+  if (HUSKY_SUCCESS != husky_image_number(data, data_size, offset, version, &section->size, sizeof(section->size))) {
+    husky_log(husky, "Error: Section `%s` (%u): Cannot read the size.\n", name, i) ;
+    return HUSKY_FAILURE ;
+  }
+
+  section->bind = 0 == strcmp(name, HUSKY_BIND_SECTION) ;
+
+  u64_t addr = section->addr ;
+  u64_t size = section->size ;
+
+  if (0 != section->bind && 0 != flags) {
+    husky_log(husky, "Error: Section `%s` (%u): Invalid flags 0x%02" PRIX8 ".\n", name, i, flags) ;
+    return HUSKY_FAILURE ;
+  }
+
+  if (0 == section->bind && (husky->mem_size < addr + size || addr + size < addr)) {
+    husky_log(husky, "Error: Section `%s` (%u): Is out of memory.\n", name, i) ;
+    return HUSKY_FAILURE ;
+  }
+
+  /* What the file holds for the section: nothing for BSS and the stack,
+   * the block for LZ4, and in version 2 a CRC-32 of it after it. */
+  section->empty  = 0 != (flags & (HUSKY_SECTION_BSS | HUSKY_SECTION_STACK)) ;
+  section->stored = 0 != section->empty ? 0 : size ;
+  section->check  = 1 < version && 0 == section->empty ? 4 : 0 ;
+
+  if (0 != (flags & HUSKY_SECTION_LZ4) && HUSKY_SUCCESS != husky_image_varint(data, data_size, offset, &section->stored)) {
+    husky_log(husky, "Error: Section `%s` (%u): Cannot read the compressed size.\n", name, i) ;
+    return HUSKY_FAILURE ;
+  }
+
+  if (data_size - *offset < section->stored || data_size - *offset - section->stored < section->check) {
+    husky_log(husky, "Error: Section `%s` (%u): Cannot read the data.\n", name, i) ;
+    return HUSKY_FAILURE ;
+  }
+
+  return HUSKY_SUCCESS ;
+}
+
+static u32_t husky_image_parse (husky_t * husky, char * filename, const u8_t * data, u64_t data_size, int fd)
+{
+  u8_t  magic [4] ;
+  u64_t offset = 0 ;
+
+  if (
+    HUSKY_SUCCESS        != husky_image_read(data, data_size, &offset, magic, 4) ||
+    HUSKY_FILE_MAG_NUM_0 != magic[0]                                            ||
+    HUSKY_FILE_MAG_NUM_1 != magic[1]                                            ||
+    HUSKY_FILE_MAG_NUM_2 != magic[2]                                            ||
+    HUSKY_FILE_MAG_NUM_3 != magic[3]
+  ) {
+    husky_log(husky, "Error: Invalid magic number.\n") ;
+    return HUSKY_FAILURE ;
+  }
+
+  if (
+    HUSKY_SUCCESS            != husky_image_read(data, data_size, &offset, magic, 4) ||
+    HUSKY_FILE_VERSION_0     != magic[0]                                            ||
+    HUSKY_FILE_VERSION_1     != magic[1]                                            ||
+    HUSKY_FILE_VERSION_2     != magic[2]                                            ||
+    HUSKY_FILE_VERSION_3_MIN >  magic[3]                                            ||
+    HUSKY_FILE_VERSION_3     <  magic[3]
+  ) {
+    husky_log(husky, "Error: Ivalid version number.\n") ;
+    return HUSKY_FAILURE ;
+  }
+
+  u32_t version = magic[3] ;
+  u64_t addr, size ;
+
+  if (HUSKY_SUCCESS != husky_image_number(data, data_size, &offset, version, &size, sizeof(u64_t))) {
+    husky_log(husky, "Error: Cannot read the instruction pointer.\n") ;
+    return HUSKY_FAILURE ;
+  }
+
+  if (husky->mem_size < size) {
+    husky_log(husky, "Error: The memory is not enough to run the program.\n") ;
+    return HUSKY_FAILURE ;
+  }
+
+  if (HUSKY_SUCCESS != husky_image_number(data, data_size, &offset, version, &addr, sizeof(u64_t))) {
+    husky_log(husky, "Error: Cannot read the instruction pointer.\n") ;
+    return HUSKY_FAILURE ;
+  }
+
+  if (husky->mem_size <= addr) {
+    husky_log(husky, "Error: The instruction pointer is out of memory.\n") ;
+    return HUSKY_FAILURE ;
+  }
+
+  husky->ip = addr ;
+
+  if (HUSKY_SUCCESS != husky_image_number(data, data_size, &offset, version, &addr, sizeof(u64_t))) {
+    husky_log(husky, "Error: Cannot read the stack pointer.\n") ;
+    return HUSKY_FAILURE ;
+  }
+
+  if (husky->mem_size <= addr) {
+    husky_log(husky, "Error: The stack pointer is out of memory.\n") ;
+    return HUSKY_FAILURE ;
+  }
+
+  husky->fp = husky->sp = addr ;
+
+  husky_decode_flush(husky) ;
+  husky_bind_reset(husky) ;
+  husky_stack_unguard(husky) ;
+
+  husky->mem_frozen = 0 ;
+  husky->stack_top  = husky->mem_size ;
+  husky->args_base  = husky->mem_size ;
+
+  u16_t secs, i ;
+  u32_t code       = 0 ;
+  u32_t code_ip    = 0 ;
+  u32_t stack      = 0 ;
+  u64_t stack_base = 0 ;
+  u64_t stack_top  = husky->mem_size ;
+
+  if (
+    HUSKY_SUCCESS != husky_image_number(data, data_size, &offset, version, &size, sizeof(secs)) ||
+    UINT16_MAX    <  size
+  ) {
+    husky_log(husky, "Error: Cannot read the number of sections.\n") ;
+    return HUSKY_FAILURE ;
+  }
 
-    if (HUSKY_SUCCESS != husky_stack_pop(husky, &object_0))
-      break ;
+  secs = (u16_t)size ;
 
-    husky_object_t * object = husky_stack_peek(husky, (i64_t)opr_data) ;
+  if (0 != husky->verbose) {
+    husky_log(husky, "Image `%s` (version %u):\n", filename, version) ;
+    husky_log(husky, "--- `ip` at 0x%012" PRIX64 "\n", husky->ip) ;
+    husky_log(husky, "--- `fp` at 0x%012" PRIX64 "\n", husky->fp) ;
+    husky_log(husky, "--- `sp` at 0x%012" PRIX64 "\n", husky->sp) ;
+    husky_log(husky, "--- %u sections\n", secs) ;
+  }
 
-    if (NULL == object)
-      break ;
+  u64_t first = offset ;
 
-    *object = object_0 ;
-  } break ;
+  for (i = 0 ; i < secs ; ++i) {
+    husky_section_t section ;
 
-  case HUSKY_INST_GET_AT_SP : {
-    i16_t opr_data = 0 ;
+    if (HUSKY_SUCCESS != husky_image_section(husky, data, data_size, &offset, version, i, &section))
+      return HUSKY_FAILURE ;
 
-    if (HUSKY_SUCCESS != husky_memory_read_ip(husky, sizeof(opr_data), &opr_data))
-      break ;
+    if (0 != husky->verbose) {
+      husky_log(husky, "--- Reading section `%s`...\n", section.name) ;
+    }
 
-    husky_object_t * object = husky_stack_peek(husky, (i64_t)opr_data) ;
+    char * name   = section.name   ;
+    u8_t   flags  = section.flags  ;
+    u32_t  bind   = section.bind   ;
+    u32_t  empty  = section.empty  ;
+    u64_t  stored = section.stored ;
+    u64_t  check  = section.check  ;
 
-    if (NULL == object)
-      break ;
+    addr = section.addr ;
+    size = section.size ;
 
-    husky_stack_push(husky, *object) ;
-  } break ;
+    if (0 != check) {
+      const u8_t * crc = data + offset + stored ;
 
-  case HUSKY_INST_SET_AT_FP : {
-    i16_t opr_data = 0 ;
+      if (husky_image_crc32(data + offset, stored) != ((u32_t)crc[0] | (u32_t)crc[1] << 8 | (u32_t)crc[2] << 16 | (u32_t)crc[3] << 24)) {
+        husky_log(husky, "Error: Section `%s` (%u): Checksum mismatch.\n", name, i) ;
+        return HUSKY_FAILURE ;
+      }
+    }
 
-    if (HUSKY_SUCCESS != husky_memory_read_ip(husky, sizeof(opr_data), &opr_data))
-      break ;
+    if (0 != bind) {
+      u32_t result = husky_bind_section(husky, data + offset, size) ;
 
-    if (HUSKY_SUCCESS != husky_stack_pop(husky, &object_0))
-      break ;
+      if (HUSKY_SUCCESS != result) {
+        husky_log(husky, "Error: Section `%s` (%u): Cannot bind the natives: %s.\n", name, i, husky_error_as_string(result)) ;
+        return HUSKY_FAILURE ;
+      }
 
-    u64_t last_sp = husky->sp ;
-    husky->sp = husky->fp ;
-    husky_object_t * object = husky_stack_peek(husky, (i64_t)opr_data) ;
-    husky->sp = last_sp ;
+      offset += stored + check ;
+      continue ;
+    }
 
-    if (NULL == object)
-      break ;
+    if (0 != (flags & HUSKY_SECTION_CODE)) {
+      code     = 1 ;
+      code_ip |= addr <= husky->ip && husky->ip - addr < size ;
+    }
 
-    *object = object_0 ;
-  } break ;
+    if (0 != (flags & HUSKY_SECTION_STACK)) {
+      if (0 != stack) {
+        husky_log(husky, "Error: Section `%s` (%u): Is a second stack.\n", name, i) ;
+        return HUSKY_FAILURE ;
+      }
 
-  case HUSKY_INST_GET_AT_FP : {
-    i16_t opr_data = 0 ;
+      if (size < sizeof(husky_object_t)) {
+        husky_log(husky, "Error: Section `%s` (%u): Is too small for a stack.\n", name, i) ;
+        return HUSKY_FAILURE ;
+      }
 
-    if (HUSKY_SUCCESS != husky_memory_read_ip(husky, sizeof(opr_data), &opr_data))
-      break ;
+      stack      = 1 ;
+      stack_base = addr ;
+      stack_top  = addr + size ;
+    }
 
-    u64_t last_sp = husky->sp ;
-    husky->sp = husky->fp ;
-    husky_object_t * object = husky_stack_peek(husky, (i64_t)opr_data) ;
-    husky->sp = last_sp ;
+    if (0 != empty) {
+      husky_image_zero(husky, addr, size) ;
+    } else if (0 != (flags & HUSKY_SECTION_LZ4)) {
+      if (HUSKY_SUCCESS != husky_image_lz4(data + offset, stored, husky->mem_data + addr, size)) {
+        husky_log(husky, "Error: Section `%s` (%u): Cannot decompress the data.\n", name, i) ;
+        return HUSKY_FAILURE ;
+      }
+    } else if (0 != (flags & HUSKY_SECTION_DATA)) {
+      memcpy(husky->mem_data + addr, data + offset, size) ;
+    } else {
+      husky_image_place(husky, data, offset, addr, size, fd) ;
+    }
 
-    if (NULL == object)
-      break ;
+    offset += stored + check ;
+  }
 
-    husky_stack_push(husky, *object) ;
-  } break ;
+  if (0 != code && 0 == code_ip) {
+    husky_log(husky, "Error: The instruction pointer is not in a code section.\n") ;
+    return HUSKY_FAILURE ;
+  }
 
+  if (husky->sp < stack_base || stack_top < husky->sp) {
+    husky_log(husky, "Error: The stack pointer is not in the stack section.\n") ;
+    return HUSKY_FAILURE ;
+  }
 
-  case HUSKY_INST_STORE_8  : 
-  case HUSKY_INST_STORE_16 : 
-  case HUSKY_INST_STORE_32 : 
-  case HUSKY_INST_STORE_64 : {
-    if (HUSKY_SUCCESS != husky_stack_pop(husky, &object_0))
-      break ;
+  /* The page above the stack is guarded, so no section may reach into it;
+   * the headers, checked above already, are read again once it is known. */
+  u64_t guard = husky_stack_page(husky, stack_top) ;
 
-    if (HUSKY_SUCCESS != husky_stack_pop(husky, &object_1))
-      break ;
+  for (i = 0, offset = first ; 0 != guard && i < secs ; ++i) {
+    husky_section_t section ;
 
-    husky_memory_write(husky, object_0.u, 1 << (opr_code - HUSKY_INST_STORE_8), &object_1.u) ;
-  } break ;
+    husky_image_section(husky, data, data_size, &offset, version, i, &section) ;
 
-  case HUSKY_INST_LOAD_8  : 
-  case HUSKY_INST_LOAD_16 : 
-  case HUSKY_INST_LOAD_32 : 
-  case HUSKY_INST_LOAD_64 : {
-    if (HUSKY_SUCCESS != husky_stack_pop(husky, &object_0))
-      break ;
+    if (0 == section.bind && 0 != section.size && section.addr < stack_top + guard && stack_top < section.addr + section.size) {
+      husky_log(husky, "Error: Section `%s` (%u): Is on the stack guard page.\n", section.name, i) ;
+      return HUSKY_FAILURE ;
+    }
 
-    object_1.u = 0 ;
+    offset += section.stored + section.check ;
+  }
 
-    if (HUSKY_SUCCESS != husky_memory_read(husky, object_0.u, 1 << (opr_code - HUSKY_INST_STORE_8), &object_1.u))
-      break ;
+  husky->stack_top = stack_top ;
+  husky_stack_guard(husky) ;
 
-    husky_stack_push(husky, object_1) ;
-  } break ;
-
-  _UNAOP( HUSKY_INST_NEGATE              , u ,     u , _UNO , _NEG )
-  _BINOP( HUSKY_INST_ADD                 , u , u , u , _BNO , _ADD )
-  _BINOP( HUSKY_INST_SUBTRACT            , u , u , u , _BNO , _SUB )
-  _BINOP( HUSKY_INST_MULTIPLY            , u , u , u , _BNO , _MUL )
-  _BINOP( HUSKY_INST_DIVIDE              , u , u , u , _IDZ , _DIV )
-  _BINOP( HUSKY_INST_MODULO              , u , u , u , _IDZ , _MOD )
-  _BINOP( HUSKY_INST_INT_MULTIPLY        , i , i , i , _BNO , _MUL )
-  _BINOP( HUSKY_INST_INT_DIVIDE          , i , i , i , _IDZ , _DIV )
-  _BINOP( HUSKY_INST_INT_MODULO          , i , i , i , _IDZ , _MOD )
-  _BINOP( HUSKY_INST_IS_EQUAL            , u , u , u , _BNO , _IEQ )
-  _BINOP( HUSKY_INST_IS_NOT_EQUAL        , u , u , u , _BNO , _INE )
-  _BINOP( HUSKY_INST_IS_LESS             , u , u , u , _BNO , _ILS )
-  _BINOP( HUSKY_INST_IS_LESS_OR_EQUAL    , u , u , u , _BNO , _ILE )
-  _BINOP( HUSKY_INST_IS_GREATER          , u , u , u , _BNO , _IGT )
-  _BINOP( HUSKY_INST_IS_GREATER_OR_EQUAL , u , u , u , _BNO , _IGE )
-  _UNAOP( HUSKY_INST_BIT_NOT             , u ,     u , _UNO , _NOT )
-  _BINOP( HUSKY_INST_BIT_AND             , u , u , u , _BNO , _AND )
-  _BINOP( HUSKY_INST_BIT_OR              , u , u , u , _BNO , _OR  )
-  _BINOP( HUSKY_INST_BIT_XOR             , u , u , u , _BNO , _XOR )
-  _BINOP( HUSKY_INST_BIT_SHIFT_LEFT      , u , u , u , _IDZ , _SHL )
-  _BINOP( HUSKY_INST_BIT_SHIFT_RIGHT     , u , u , u , _IDZ , _SHR )
-  _BINOP( HUSKY_INST_BIT_INT_SHIFT_RIGHT , i , u , i , _BNO , _SHR )
-
-  case HUSKY_INST_PRINT : {
-    if (HUSKY_SUCCESS != husky_stack_pop(husky, &object_0))
-      break ;
+  husky_state_set(husky, HUSKY_STATE_READY) ;
+  husky_error_set(husky, HUSKY_SUCCESS) ;
 
-    if (HUSKY_SUCCESS != husky_stack_pop(husky, &object_1))
-      break ;
+  if (HUSKY_SUCCESS != husky_image_decode(husky)) {
+    husky_log(husky, "Error: Cannot decode the image: %s.\n", husky_error_as_string(husky->err_code)) ;
+    return HUSKY_FAILURE ;
+  }
 
-    switch (object_0.u) {
-    case 0x00 : {
-      fprintf(stdout, "%" PRIu64, object_1.u) ;
-    } break ;
+  return HUSKY_SUCCESS ;
+}
 
-    case 0x01 : {
-      fprintf(stdout, "%" PRIi64, object_1.i) ;
-    } break ;
+typedef u32_t ( * husky_parse_t ) (husky_t *, char *, const u8_t *, u64_t, int) ;
 
-    case 0x02 : {
-      fprintf(stdout, "%" PRIx64, object_1.u) ;
-    } break ;
+/* The file is mapped rather than read, so the header and the sections are
+ * parsed in place and no byte of it is copied through stdio. */
+static u32_t husky_file_load (husky_t * husky, char * filename, husky_parse_t parse)
+{
+  u32_t result ;
 
-    case 0x03 : {
-      fprintf(stdout, "%" PRIX64, object_1.u) ;
-    } break ;
+#ifdef _WIN32
+  FILE * fileptr = fopen(filename, "rb") ;
 
-    case 0x04 : {
-      fprintf(stdout, "%c", object_1.u) ;
-    } break ;
+  if (NULL == fileptr) {
+    husky_log(husky, "Error: Cannot open `%s`.\n", filename) ;
+    return HUSKY_FAILURE ;
+  }
 
-    case 0x05 : {
-      if (HUSKY_SUCCESS != husky_string_verify(husky, object_1.u))
-        break ;
+  u8_t * data = NULL ;
+  u64_t  size = 0 ;
 
-      fprintf(stdout, "%s", husky->mem_data + object_1.u) ;
-    } break ;
+  if (0 == fseek(fileptr, 0, SEEK_END) && 0 < (size = ftell(fileptr)) && 0 == fseek(fileptr, 0, SEEK_SET)) {
+    if (NULL == (data = (u8_t *)malloc(size)) || size != fread(data, sizeof(u8_t), size, fileptr))
+      size = 0 ;
+  } else {
+    size = 0 ;
+  }
 
-    default :
-      break ;
-    }
-  } break ;
+  fclose(fileptr) ;
 
-  default :
-    husky_error_set(husky, HUSKY_ERROR_UNDEFINED_INST) ;
-    break ;
+  result = parse(husky, filename, data, size, -1) ;
+
+  free(data) ;
+#else
+  int fd = open(filename, O_RDONLY) ;
+
+  if (0 > fd) {
+    husky_log(husky, "Error: Cannot open `%s`.\n", filename) ;
+    return HUSKY_FAILURE ;
   }
 
-  return husky_error_get(husky) ;
+  struct stat info ;
+  u8_t *      data = NULL ;
+  u64_t       size = 0 ;
+
+  if (0 == fstat(fd, &info) && 0 < info.st_size) {
+    void * map = mmap(NULL, info.st_size, PROT_READ, MAP_PRIVATE, fd, 0) ;
+
+    if (MAP_FAILED != map) {
+      data = (u8_t *)map ;
+      size = info.st_size ;
+    }
+  }
+
+  result = parse(husky, filename, data, size, fd) ;
+
+  if (NULL != data)
+    munmap(data, size) ;
+
+  close(fd) ;
+#endif
+
+  return result ;
 }
 
 u32_t husky_image_load (husky_t * husky, char * filename)
 {
-  FILE * fileptr ;
+  return husky_file_load(husky, filename, husky_image_parse) ;
+}
 
-#ifdef _WIN32
-  fileptr = fopen(filename, "r") ;
+u32_t husky_image_load_memory (husky_t * husky, const ptr_t data, u64_t size)
+{
+  return husky_image_parse(husky, "<memory>", (const u8_t *)data, size, -1) ;
+}
+
+/* A snapshot is the image magic number, its own version, then the page
+ * size it was taken with, `mem_size`, `ip`, `fp`, `sp`, `steps`, `state`,
+ * `err_code`, the number of page runs, the size of the bind table,
+ * `stack_top` and `args_base` as 64-bit numbers, each run as its first page
+ * and its number of pages, and the bind table. The pages of the runs follow
+ * from the next page boundary on, so loading can map them copy-on-write
+ * like image sections. */
+# define HUSKY_SNAPSHOT_FIELDS 12
+
+/* Compares the bytes with their neighbours, which `memcmp` does a word at a
+ * time, rather than testing them one by one. */
+static int husky_snapshot_zero (const u8_t * data, u64_t size)
+{
+  return 0 == size || (0 == data[0] && 0 == memcmp(data, data + 1, size - 1)) ;
+}
+
+/* Lists as runs of `page` bytes the pages worth saving: those that are not
+ * all zeros, except the stack guard page. Every page is read, since one the
+ * host evicted or swapped out still holds data. */
+static u32_t husky_snapshot_runs (husky_t * husky, u64_t page, u64_t ** runs, u64_t * count)
+{
+  u64_t   pages = (husky->mem_size + page - 1) / page ;
+  u64_t   size  = 0 ;
+  u64_t * array = NULL ;
+  u64_t   i ;
+
+  *runs  = NULL ;
+  *count = 0 ;
+
+  for (i = 0 ; i < pages ; ++i) {
+    u64_t addr  = i * page ;
+    u64_t bytes = husky->mem_size - addr < page ? husky->mem_size - addr : page ;
+
+    if (husky_memory_guarded(husky, addr, bytes) || 0 != husky_snapshot_zero(husky->mem_data + addr, bytes))
+      continue ;
+
+    if (0 != *count && array[2 * *count - 2] + array[2 * *count - 1] == i) {
+      ++array[2 * *count - 1] ;
+      continue ;
+    }
+
+    if (*count == size) {
+      u64_t * grown = (u64_t *)realloc(array, (0 == size ? 64 : size << 1) * 2 * sizeof(u64_t)) ;
+
+      if (NULL == grown) {
+        free(array) ;
+        return HUSKY_FAILURE ;
+      }
+
+      array = grown ;
+      size  = 0 == size ? 64 : size << 1 ;
+    }
+
+    array[2 * *count]     = i ;
+    array[2 * *count + 1] = 1 ;
+    ++*count ;
+  }
+
+  *runs = array ;
+
+  return HUSKY_SUCCESS ;
+}
+
+/* Saves the registers, the pages of memory that are not all zeros and the
+ * bind table. Pending `PRINT` output goes to the sink first, so it is not
+ * written again by the instances started from the snapshot. */
+u32_t husky_snapshot_save (husky_t * husky, char * filename)
+{
+#ifndef _WIN32
+  u64_t page = (u64_t)sysconf(_SC_PAGESIZE) ;
 #else
-  fileptr = fopen(filename, "rb") ;
+  u64_t page = 4096 ;
 #endif
 
-  if (NULL == fileptr) {
-    fprintf(stderr, "Error: Cannot open `%s`.\n", filename) ;
-    fclose(fileptr) ;
+  u8_t    magic  [8] = {
+    HUSKY_FILE_MAG_NUM_0     , HUSKY_FILE_MAG_NUM_1     , HUSKY_FILE_MAG_NUM_2     , HUSKY_FILE_MAG_NUM_3     ,
+    HUSKY_SNAPSHOT_VERSION_0 , HUSKY_SNAPSHOT_VERSION_1 , HUSKY_SNAPSHOT_VERSION_2 , HUSKY_SNAPSHOT_VERSION_3
+  } ;
+  u64_t   fields [HUSKY_SNAPSHOT_FIELDS] ;
+  u64_t * runs ;
+  u64_t   count, i ;
+
+  husky_output_flush(husky) ;
+
+  if (HUSKY_SUCCESS != husky_snapshot_runs(husky, page, &runs, &count)) {
+    husky_log(husky, "Error: Cannot allocate the page runs.\n") ;
     return HUSKY_FAILURE ;
   }
 
-  if (
-    HUSKY_FILE_MAG_NUM_0 != fgetc(fileptr) ||
-    HUSKY_FILE_MAG_NUM_1 != fgetc(fileptr) ||
-    HUSKY_FILE_MAG_NUM_2 != fgetc(fileptr) ||
-    HUSKY_FILE_MAG_NUM_3 != fgetc(fileptr)
-  ) {
-    fprintf(stderr, "Error: Invalid magic number.\n") ;
-    fclose(fileptr) ;
+  u64_t  bind_size = husky_bind_save(husky, NULL) ;
+  u8_t * bind      = (u8_t *)malloc(bind_size) ;
+
+  if (NULL == bind) {
+    husky_log(husky, "Error: Cannot allocate the bind table.\n") ;
+    free(runs) ;
     return HUSKY_FAILURE ;
   }
 
+  husky_bind_save(husky, bind) ;
+
+  fields[0]  = page ;
+  fields[1]  = husky->mem_size ;
+  fields[2]  = husky->ip ;
+  fields[3]  = husky->fp ;
+  fields[4]  = husky->sp ;
+  fields[5]  = husky->steps ;
+  fields[6]  = husky->state ;
+  fields[7]  = husky->err_code ;
+  fields[8]  = count ;
+  fields[9]  = bind_size ;
+  fields[10] = husky->stack_top ;
+  fields[11] = husky->args_base ;
+
+  FILE * fileptr = fopen(filename, "wb") ;
+  u64_t  offset  = sizeof(magic) + sizeof(fields) + count * 2 * sizeof(u64_t) + bind_size ;
+  u32_t  result  = NULL == fileptr ? HUSKY_FAILURE : HUSKY_SUCCESS ;
+
   if (
-    HUSKY_FILE_VERSION_0 != fgetc(fileptr) ||
-    HUSKY_FILE_VERSION_1 != fgetc(fileptr) ||
-    HUSKY_FILE_VERSION_2 != fgetc(fileptr) ||
-    HUSKY_FILE_VERSION_3 != fgetc(fileptr)
-  ) {
-    fprintf(stderr, "Error: Ivalid version number.\n") ;
-    fclose(fileptr) ;
-    return HUSKY_FAILURE ;
+    HUSKY_SUCCESS != result                                  ||
+    1 != fwrite(magic, sizeof(magic), 1, fileptr)            ||
+    1 != fwrite(fields, sizeof(fields), 1, fileptr)          ||
+    count != fwrite(runs, 2 * sizeof(u64_t), count, fileptr) ||
+    1 != fwrite(bind, bind_size, 1, fileptr)
+  )
+    result = HUSKY_FAILURE ;
+
+  for (; HUSKY_SUCCESS == result && 0 != (offset & (page - 1)) ; ++offset) {
+    if (EOF == fputc(0, fileptr))
+      result = HUSKY_FAILURE ;
   }
 
-  u64_t addr, size ;
+  for (i = 0 ; HUSKY_SUCCESS == result && i < count ; ++i) {
+    u64_t addr = runs[2 * i] * page ;
+    u64_t size = runs[2 * i + 1] * page ;
+
+    if (husky->mem_size - addr < size)
+      size = husky->mem_size - addr ;
+
+    if (1 != fwrite(husky->mem_data + addr, size, 1, fileptr))
+      result = HUSKY_FAILURE ;
+  }
+
+  if (NULL != fileptr && 0 != fclose(fileptr))
+    result = HUSKY_FAILURE ;
+
+  if (HUSKY_SUCCESS != result)
+    husky_log(husky, "Error: Cannot write `%s`.\n", filename) ;
+
+  free(bind) ;
+  free(runs) ;
+
+  return result ;
+}
+
+static u32_t husky_snapshot_parse (husky_t * husky, char * filename, const u8_t * data, u64_t data_size, int fd)
+{
+  u8_t  magic  [8] ;
+  u64_t fields [HUSKY_SNAPSHOT_FIELDS] ;
+  u64_t offset = 0 ;
 
-  if (1 != fread(&size, sizeof(size), 1,  fileptr)) {
-    fprintf(stderr, "Error: Cannot read the instruction pointer.\n") ;
-    fclose(fileptr) ;
+  if (
+    HUSKY_SUCCESS            != husky_image_read(data, data_size, &offset, magic, sizeof(magic)) ||
+    HUSKY_FILE_MAG_NUM_0     != magic[0]                                                         ||
+    HUSKY_FILE_MAG_NUM_1     != magic[1]                                                         ||
+    HUSKY_FILE_MAG_NUM_2     != magic[2]                                                         ||
+    HUSKY_FILE_MAG_NUM_3     != magic[3]                                                         ||
+    HUSKY_SNAPSHOT_VERSION_0 != magic[4]                                                         ||
+    HUSKY_SNAPSHOT_VERSION_1 != magic[5]                                                         ||
+    HUSKY_SNAPSHOT_VERSION_2 != magic[6]                                                         ||
+    HUSKY_SNAPSHOT_VERSION_3 != magic[7]
+  ) {
+    husky_log(husky, "Error: `%s` is not a snapshot.\n", filename) ;
     return HUSKY_FAILURE ;
   }
 
-  if (husky->mem_size < size) {
-    fprintf(stderr, "Error: The memory is not enough to run the program.\n") ;
-    fclose(fileptr) ;
+  if (HUSKY_SUCCESS != husky_image_read(data, data_size, &offset, fields, sizeof(fields))) {
+    husky_log(husky, "Error: Cannot read the registers.\n") ;
     return HUSKY_FAILURE ;
   }
 
-  if (1 != fread(&addr, sizeof(addr), 1,  fileptr)) {
-    fprintf(stderr, "Error: Cannot read the instruction pointer.\n") ;
-    fclose(fileptr) ;
+  u64_t page  = fields[0] ;
+  u64_t size  = fields[1] ;
+  u64_t count = fields[8] ;
+  u64_t bind  = fields[9] ;
+
+  if (
+    0 == page || 0 != (page & (page - 1)) || 0 == size              ||
+    size < fields[3] || size < fields[10] || fields[10] < fields[4] ||
+    fields[10] < sizeof(husky_object_t) || size < fields[11]        ||
+    HUSKY_N_STATES <= fields[6] || HUSKY_N_ERRORS <= fields[7]
+  ) {
+    husky_log(husky, "Error: Invalid registers.\n") ;
     return HUSKY_FAILURE ;
   }
 
-  if (husky->mem_size <= addr) {
-    fprintf(stderr, "Error: The instruction pointer is out of memory.\n") ;
-    fclose(fileptr) ;
+  if (
+    (data_size - offset) / (2 * sizeof(u64_t)) < count    ||
+    data_size - offset - count * 2 * sizeof(u64_t) < bind
+  ) {
+    husky_log(husky, "Error: Cannot read the page runs.\n") ;
     return HUSKY_FAILURE ;
   }
 
-  husky->ip = addr ;
+  const u8_t * runs  = data + offset ;
+  u64_t        start = (offset + count * 2 * sizeof(u64_t) + bind + page - 1) & ~(page - 1) ;
+  u64_t        pages = size / page + (0 != (size & (page - 1))) ;
+  u64_t        next  = 0 ;
+  u64_t        i, run [2] ;
 
-  if (1 != fread(&addr, sizeof(addr), 1,  fileptr)) {
-    fprintf(stderr, "Error: Cannot read the stack pointer.\n") ;
-    fclose(fileptr) ;
-    return HUSKY_FAILURE ;
+  /* Every run is checked before anything is changed, so a bad snapshot
+   * leaves the instance as it was. */
+  for (offset = start, i = 0 ; i < count ; ++i) {
+    memcpy(run, runs + i * sizeof(run), sizeof(run)) ;
+
+    if (run[0] < next || 0 == run[1] || pages <= run[0] || pages - run[0] < run[1]) {
+      husky_log(husky, "Error: Page run %" PRIu64 ": Is out of memory.\n", i) ;
+      return HUSKY_FAILURE ;
+    }
+
+    u64_t bytes = size - run[0] * page < run[1] * page ? size - run[0] * page : run[1] * page ;
+
+    if (data_size < offset || data_size - offset < bytes) {
+      husky_log(husky, "Error: Page run %" PRIu64 ": Cannot read the data.\n", i) ;
+      return HUSKY_FAILURE ;
+    }
+
+    next    = run[0] + run[1] ;
+    offset += bytes ;
   }
 
-  if (husky->mem_size <= addr) {
-    fprintf(stderr, "Error: The stack pointer is out of memory.\n") ;
-    fclose(fileptr) ;
+  husky_decode_flush(husky) ;
+  husky_stack_unguard(husky) ;
+
+  if (size != husky->mem_size) {
+    husky_memory_free(husky) ;
+
+    if (HUSKY_SUCCESS != husky_memory_alloc(husky, size)) {
+      husky->state = HUSKY_STATE_HALTED ;
+      husky_log(husky, "Error: Cannot allocate the memory.\n") ;
+      return HUSKY_FAILURE ;
+    }
+  } else {
+    husky_image_zero(husky, 0, size) ;
+    husky->mem_frozen = 0 ;
+  }
+
+  u32_t result = husky_bind_restore(husky, runs + count * 2 * sizeof(u64_t), bind) ;
+
+  if (HUSKY_SUCCESS != result) {
+    husky->state = HUSKY_STATE_HALTED ;
+    husky_log(husky, "Error: Cannot bind the natives again: %s.\n", husky_error_as_string(result)) ;
     return HUSKY_FAILURE ;
   }
 
-  husky->fp = husky->sp = addr ;
+  for (offset = start, i = 0 ; i < count ; ++i) {
+    memcpy(run, runs + i * sizeof(run), sizeof(run)) ;
 
-  u16_t secs, i ;
+    u64_t bytes = size - run[0] * page < run[1] * page ? size - run[0] * page : run[1] * page ;
 
-  if (1 != fread(&secs, sizeof(secs), 1,  fileptr)) {
-    fprintf(stderr, "Error: Cannot read the number of sections.\n") ;
-    fclose(fileptr) ;
-    return HUSKY_FAILURE ;
+    husky_image_place(husky, data, offset, run[0] * page, bytes, fd) ;
+    offset += bytes ;
   }
 
   if (0 != husky->verbose) {
-    fprintf(stderr, "Image `%s`:\n", filename) ;
-    fprintf(stderr, "--- `ip` at 0x%012" PRIX64 "\n", husky->ip) ;
-    fprintf(stderr, "--- `fp` at 0x%012" PRIX64 "\n", husky->fp) ;
-    fprintf(stderr, "--- `sp` at 0x%012" PRIX64 "\n", husky->sp) ;
-    fprintf(stderr, "--- %u sections\n", secs) ;
+    husky_log(husky, "Snapshot `%s`:\n", filename) ;
+    husky_log(husky, "--- `ip` at 0x%012" PRIX64 "\n", fields[2]) ;
+    husky_log(husky, "--- `fp` at 0x%012" PRIX64 "\n", fields[3]) ;
+    husky_log(husky, "--- `sp` at 0x%012" PRIX64 "\n", fields[4]) ;
+    husky_log(husky, "--- %" PRIu64 " page runs\n", count) ;
   }
 
-  for (i = 0 ; i < secs ; ++i) {
-    char name [32 + 1] ;
-    int j = 0 ;
+  husky->ip       = fields[2] ;
+  husky->fp       = fields[3] ;
+  husky->sp       = fields[4] ;
+  husky->steps    = fields[5] ;
+  husky->state    = (u32_t)fields[6] ;
+  husky->err_code = (u32_t)fields[7] ;
 
-    do {
-      int eof = fgetc(fileptr) ;
+  husky->stack_top = fields[10] ;
+  husky->args_base = fields[11] ;
+  husky_stack_guard(husky) ;
 
-      if (EOF == eof) {
-        fprintf(stderr, "Error: Section %u: Is out of binary.\n", i) ;
-        fclose(fileptr) ;
-        return HUSKY_FAILURE ;
-      }
+  if (HUSKY_STATE_HALTED != husky->state && NULL == husky_insn_lookup(husky, husky->ip)) {
+    husky->state = HUSKY_STATE_HALTED ;
+    husky_log(husky, "Error: Cannot decode the snapshot.\n") ;
+    return HUSKY_FAILURE ;
+  }
 
-      name[j] = eof ;
-    } while (j < 32 && 0 != name[j++]) ;
+  return HUSKY_SUCCESS ;
+}
 
-    if (0 != husky->verbose) {
-      fprintf(stderr, "--- Reading section `%s`...\n", name) ;
-    }
+u32_t husky_snapshot_load (husky_t * husky, char * filename)
+{
+  return husky_file_load(husky, filename, husky_snapshot_parse) ;
+}
 
-    name[j] = 0 ;
+/* Moves guest memory into a memfd and maps it back copy-on-write, writing
+ * every page that is not all zeros, so clones can map the same file. The
+ * memory is only mapped back once all of them are written, and is left as
+ * it was when any write fails. It is done again only once the instance may
+ * have changed its memory since, which every run, push and write marks. */
+static u32_t husky_memory_freeze (husky_t * husky)
+{
+  if (0 != husky->mem_frozen)
+    return HUSKY_SUCCESS ;
 
-    if (1 != fread(&addr, sizeof(addr), 1,  fileptr)) {
-      fprintf(stderr, "Error: Section `%s` (%u): Cannot read the address.\n", name, i) ;
-      fclose(fileptr) ;
-      return HUSKY_FAILURE ;
-    }
+#if defined(__linux__) && defined(MFD_CLOEXEC)
+  u64_t   page = (u64_t)sysconf(_SC_PAGESIZE) ;
+  u64_t * runs ;
+  u64_t   count, i ;
 
-    if (1 != fread(&size, sizeof(size), 1,  fileptr)) {
-      fprintf(stderr, "Error: Section `%s` (%u): Cannot read the size.\n", name, i) ;
-      fclose(fileptr) ;
-      return HUSKY_FAILURE ;
+  if (0 == husky->mem_mapped)
+    return HUSKY_FAILURE ;
+
+  int fd = memfd_create("husky", MFD_CLOEXEC) ;
+
+  if (0 > fd)
+    return HUSKY_FAILURE ;
+
+  if (0 != ftruncate(fd, husky->mem_size) || HUSKY_SUCCESS != husky_snapshot_runs(husky, page, &runs, &count)) {
+    close(fd) ;
+    return HUSKY_FAILURE ;
+  }
+
+  for (i = 0 ; i < count ; ++i) {
+    u64_t addr = runs[2 * i] * page ;
+    u64_t size = runs[2 * i + 1] * page ;
+    u64_t done ;
+
+    if (husky->mem_size - addr < size)
+      size = husky->mem_size - addr ;
+
+    for (done = 0 ; done < size ; ) {
+      ssize_t written = pwrite(fd, husky->mem_data + addr + done, size - done, addr + done) ;
+
+      if (0 >= written)
+        break ;
+
+      done += written ;
     }
 
-    if (husky->mem_size < addr + size) {
-      fprintf(stderr, "Error: Section `%s` (%u): Is out of memory.\n", name, i) ;
-      fclose(fileptr) ;
-      return HUSKY_FAILURE ;
+    if (done < size)
+      break ;
+  }
+
+  free(runs) ;
+
+  if (i < count || MAP_FAILED == mmap(husky->mem_data, husky->mem_size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_FIXED, fd, 0)) {
+    close(fd) ;
+    return HUSKY_FAILURE ;
+  }
+
+  if (0 <= husky->mem_fd)
+    close(husky->mem_fd) ;
+
+  husky->mem_fd     = fd ;
+  husky->mem_frozen = 1 ;
+
+  return HUSKY_SUCCESS ;
+#else
+  return HUSKY_FAILURE ;
+#endif
+}
+
+/* Returns a new instance in the same state as `husky`, or NULL when it
+ * cannot be made. Their memory shares the pages of a memfd copy-on-write,
+ * so a clone costs a mapping and a copy of the pages it writes, whatever
+ * the size of the memory; without memfd the pages that are not all zeros
+ * are copied. Modules and natives are bound again under the same handles,
+ * decoded code is not shared, and `PRINT` output still in the buffer of
+ * `husky` stays there. A clone is a separate instance that may run on
+ * another thread, but `husky` itself must not be in use while it clones. */
+husky_t * husky_clone (husky_t * husky)
+{
+  husky_config_t config ;
+
+  config.mem_size  = husky->mem_size ;
+  config.verbose   = husky->verbose ;
+  config.jit       = husky->jit ;
+  config.huge      = husky->huge ;
+  config.guard     = husky->guard ;
+  config.ptr       = husky->ptr ;
+  config.err_func  = husky->err_func ;
+  config.out_func  = husky->out_func ;
+  config.log_func  = husky->log_func ;
+  config.out_size  = husky->out_size ;
+  config.out_flush = husky->out_flush ;
+
+  husky_t * clone = husky_create(&config) ;
+
+  if (NULL == clone)
+    return NULL ;
+
+  u32_t shared = HUSKY_FAILURE ;
+
+  /* Lifted while the memory is copied, so the copy holds every page. */
+  husky_stack_unguard(husky) ;
+
+#ifndef _WIN32
+  if (
+    HUSKY_SUCCESS == husky_memory_freeze(husky) &&
+    MAP_FAILED != mmap(clone->mem_data, clone->mem_size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_FIXED, husky->mem_fd, 0)
+  )
+    shared = HUSKY_SUCCESS ;
+#endif
+
+  if (HUSKY_SUCCESS != shared) {
+#ifndef _WIN32
+    u64_t   page = (u64_t)sysconf(_SC_PAGESIZE) ;
+#else
+    u64_t   page = 4096 ;
+#endif
+    u64_t * runs ;
+    u64_t   count, i ;
+
+    if (HUSKY_SUCCESS != husky_snapshot_runs(husky, page, &runs, &count)) {
+      husky_stack_guard(husky) ;
+      husky_destroy(clone) ;
+      return NULL ;
     }
 
-    if (size != fread(husky->mem_data + addr, sizeof(u8_t), size,  fileptr)) {
-      fprintf(stderr, "Error: Section `%s` (%u): Cannot read the data.\n", name, i) ;
-      fclose(fileptr) ;
-      return HUSKY_FAILURE ;
+    for (i = 0 ; i < count ; ++i) {
+      u64_t addr = runs[2 * i] * page ;
+      u64_t size = runs[2 * i + 1] * page ;
+
+      memcpy(clone->mem_data + addr, husky->mem_data + addr, husky->mem_size - addr < size ? husky->mem_size - addr : size) ;
     }
+
+    free(runs) ;
   }
 
-  fclose(fileptr) ;
+  husky_stack_guard(husky) ;
 
-  husky_state_set(husky, HUSKY_STATE_READY) ;
-  husky_error_set(husky, HUSKY_SUCCESS) ;
+  u64_t  size = husky_bind_save(husky, NULL) ;
+  u8_t * bind = (u8_t *)malloc(size) ;
 
-  return HUSKY_SUCCESS ;
+  if (NULL == bind) {
+    husky_destroy(clone) ;
+    return NULL ;
+  }
+
+  husky_bind_save(husky, bind) ;
+
+  if (HUSKY_SUCCESS != husky_bind_restore(clone, bind, size)) {
+    free(bind) ;
+    husky_destroy(clone) ;
+    return NULL ;
+  }
+
+  free(bind) ;
+
+  clone->ip       = husky->ip ;
+  clone->fp       = husky->fp ;
+  clone->sp       = husky->sp ;
+  clone->steps    = husky->steps ;
+  clone->state    = husky->state ;
+  clone->err_code = husky->err_code ;
+
+  clone->stack_top = husky->stack_top ;
+  clone->args_base = husky->args_base ;
+  husky_stack_guard(clone) ;
+
+  return clone ;
+}
+
+/* Returns a halted instance with its own zeroed memory, or NULL when it
+ * cannot be allocated. A NULL `config` takes the defaults of the loader. */
+husky_t * husky_create (const husky_config_t * config)
+{
+  husky_t * husky = (husky_t *)calloc(1, sizeof(husky_t)) ;
+
+  if (NULL == husky)
+    return NULL ;
+
+  husky->err_code = HUSKY_SUCCESS ;
+  husky->state    = HUSKY_STATE_HALTED ;
+
+  if (NULL != config) {
+    husky->verbose  = config->verbose ;
+    husky->jit      = config->jit ;
+    husky->huge     = config->huge ;
+    husky->guard    = config->guard ;
+    husky->ptr      = config->ptr ;
+    husky->err_func = config->err_func ;
+    husky->out_func  = config->out_func ;
+    husky->log_func  = config->log_func ;
+    husky->out_flush = config->out_flush ;
+  }
+
+  u64_t mem_size = HUSKY_MEMORY_SIZE_DEFAULT ;
+  u64_t out_size = HUSKY_OUTPUT_SIZE_DEFAULT ;
+
+  if (NULL != config && 0 != config->mem_size)
+    mem_size = config->mem_size ;
+
+  if (NULL != config && 0 != config->out_size)
+    out_size = config->out_size ;
+
+  if (NULL == (husky->out_data = (char *)malloc(out_size))) {
+    free(husky) ;
+    return NULL ;
+  }
+
+  husky->out_size = out_size ;
+
+  if (HUSKY_SUCCESS != husky_memory_alloc(husky, mem_size)) {
+    free(husky->out_data) ;
+    free(husky) ;
+    return NULL ;
+  }
+
+  return husky ;
+}
+
+void husky_destroy (husky_t * husky)
+{
+  if (NULL == husky)
+    return ;
+
+  husky_output_flush(husky) ;
+  husky_decode_flush(husky) ;
+  husky_bind_reset(husky) ;
+  husky_memory_free(husky) ;
+  free(husky->out_data) ;
+  free(husky) ;
 }
@@ -24,6 +24,7 @@ typedef int16_t  i16_t ;
 typedef int32_t  i32_t ;
 typedef int64_t  i64_t ;
 typedef void *   ptr_t ;
+typedef double   f64_t ;
 
 # define HUSKY_FILE_MAG_NUM_0 0x45
 # define HUSKY_FILE_MAG_NUM_1 0x70
@@ -32,9 +33,20 @@ typedef void *   ptr_t ;
 # define HUSKY_FILE_VERSION_0 0x00
 # define HUSKY_FILE_VERSION_1 0x00
 # define HUSKY_FILE_VERSION_2 0x00
-# define HUSKY_FILE_VERSION_3 0x01
+# define HUSKY_FILE_VERSION_3 0x02
+
+# define HUSKY_FILE_VERSION_3_MIN 0x01
+
+# define HUSKY_SNAPSHOT_VERSION_0 0x53
+# define HUSKY_SNAPSHOT_VERSION_1 0x4E
+# define HUSKY_SNAPSHOT_VERSION_2 0x50
+# define HUSKY_SNAPSHOT_VERSION_3 0x02
 
 # define HUSKY_MEMORY_SIZE_DEFAULT (8 << 20)
+# define HUSKY_MEMORY_GUARDED      ((u64_t)1 << 32)
+# define HUSKY_MEMORY_RESERVE      (HUSKY_MEMORY_GUARDED + sizeof(u64_t))
+# define HUSKY_OUTPUT_SIZE_DEFAULT (4 << 10)
+# define HUSKY_STEPS_UNLIMITED     UINT64_MAX
 
 enum {
   HUSKY_SUCCESS                ,
@@ -64,80 +76,113 @@ enum {
 } ;
 
 enum {
-  HUSKY_INST_HALT                ,
-  HUSKY_INST_NOOP                ,
-  HUSKY_INST_BREAKPOINT          ,
-  HUSKY_INST_ERROR_SET           ,
-  HUSKY_INST_ERROR_GET           ,
-  HUSKY_INST_JUMP                ,
-  HUSKY_INST_JUMP_INDIRECT       ,
-  HUSKY_INST_JUMP_IF_FALSE       ,
-  HUSKY_INST_JUMP_IF_TRUE        ,
-  HUSKY_INST_CALL                ,
-  HUSKY_INST_CALL_INDIRECT       ,
-  HUSKY_INST_RETURN              ,
-  HUSKY_INST_MODULE_OPEN         ,
-  HUSKY_INST_MODULE_CLOSE        ,
-  HUSKY_INST_NATIVE_LOAD         ,
-  HUSKY_INST_NATIVE_CALL         ,
-  HUSKY_INST_IS_NULL_POINTER     ,
-  HUSKY_INST_IS_NOT_NULL_POINTER ,
-  HUSKY_INST_IS_STRING           ,
-  HUSKY_INST_ENTER               ,
-  HUSKY_INST_LEAVE               ,
-  HUSKY_INST_PUSH_8              ,
-  HUSKY_INST_PUSH_16             ,
-  HUSKY_INST_PUSH_32             ,
-  HUSKY_INST_PUSH_64             ,
-  HUSKY_INST_POP                 ,
-  HUSKY_INST_EXCHANGE            ,
-  HUSKY_INST_SET_AT_SP           ,
-  HUSKY_INST_GET_AT_SP           ,
-  HUSKY_INST_SET_AT_FP           ,
-  HUSKY_INST_GET_AT_FP           ,
-  HUSKY_INST_STORE_8             ,
-  HUSKY_INST_STORE_16            ,
-  HUSKY_INST_STORE_32            ,
-  HUSKY_INST_STORE_64            ,
-  HUSKY_INST_LOAD_8              ,
-  HUSKY_INST_LOAD_16             ,
-  HUSKY_INST_LOAD_32             ,
-  HUSKY_INST_LOAD_64             ,
-  HUSKY_INST_NEGATE              ,
-  HUSKY_INST_ADD                 ,
-  HUSKY_INST_SUBTRACT            ,
-  HUSKY_INST_MULTIPLY            ,
-  HUSKY_INST_DIVIDE              ,
-  HUSKY_INST_MODULO              ,
-  HUSKY_INST_INT_MULTIPLY        ,
-  HUSKY_INST_INT_DIVIDE          ,
-  HUSKY_INST_INT_MODULO          ,
-  HUSKY_INST_IS_EQUAL            ,
-  HUSKY_INST_IS_NOT_EQUAL        ,
-  HUSKY_INST_IS_LESS             ,
-  HUSKY_INST_IS_LESS_OR_EQUAL    ,
-  HUSKY_INST_IS_GREATER          ,
-  HUSKY_INST_IS_GREATER_OR_EQUAL ,
-  HUSKY_INST_BIT_NOT             ,
-  HUSKY_INST_BIT_AND             ,
-  HUSKY_INST_BIT_OR              ,
-  HUSKY_INST_BIT_XOR             ,
-  HUSKY_INST_BIT_SHIFT_LEFT      ,
-  HUSKY_INST_BIT_SHIFT_RIGHT     ,
-  HUSKY_INST_BIT_INT_SHIFT_RIGHT ,
-  HUSKY_INST_PRINT               ,
+  HUSKY_FLUSH_FULL ,
+  HUSKY_FLUSH_LINE ,
+  HUSKY_FLUSH_EACH ,
+
+  HUSKY_N_FLUSHES
+} ;
+
+enum {
+  HUSKY_INST_HALT                      ,
+  HUSKY_INST_NOOP                      ,
+  HUSKY_INST_BREAKPOINT                ,
+  HUSKY_INST_ERROR_SET                 ,
+  HUSKY_INST_ERROR_GET                 ,
+  HUSKY_INST_JUMP                      ,
+  HUSKY_INST_JUMP_INDIRECT             ,
+  HUSKY_INST_JUMP_IF_FALSE             ,
+  HUSKY_INST_JUMP_IF_TRUE              ,
+  HUSKY_INST_CALL                      ,
+  HUSKY_INST_CALL_INDIRECT             ,
+  HUSKY_INST_RETURN                    ,
+  HUSKY_INST_MODULE_OPEN               ,
+  HUSKY_INST_MODULE_CLOSE              ,
+  HUSKY_INST_NATIVE_LOAD               ,
+  HUSKY_INST_NATIVE_CALL               ,
+  HUSKY_INST_IS_NULL_POINTER           ,
+  HUSKY_INST_IS_NOT_NULL_POINTER       ,
+  HUSKY_INST_IS_STRING                 ,
+  HUSKY_INST_ENTER                     ,
+  HUSKY_INST_LEAVE                     ,
+  HUSKY_INST_PUSH_8                    ,
+  HUSKY_INST_PUSH_16                   ,
+  HUSKY_INST_PUSH_32                   ,
+  HUSKY_INST_PUSH_64                   ,
+  HUSKY_INST_POP                       ,
+  HUSKY_INST_EXCHANGE                  ,
+  HUSKY_INST_SET_AT_SP                 ,
+  HUSKY_INST_GET_AT_SP                 ,
+  HUSKY_INST_SET_AT_FP                 ,
+  HUSKY_INST_GET_AT_FP                 ,
+  HUSKY_INST_STORE_8                   ,
+  HUSKY_INST_STORE_16                  ,
+  HUSKY_INST_STORE_32                  ,
+  HUSKY_INST_STORE_64                  ,
+  HUSKY_INST_LOAD_8                    ,
+  HUSKY_INST_LOAD_16                   ,
+  HUSKY_INST_LOAD_32                   ,
+  HUSKY_INST_LOAD_64                   ,
+  HUSKY_INST_NEGATE                    ,
+  HUSKY_INST_ADD                       ,
+  HUSKY_INST_SUBTRACT                  ,
+  HUSKY_INST_MULTIPLY                  ,
+  HUSKY_INST_DIVIDE                    ,
+  HUSKY_INST_MODULO                    ,
+  HUSKY_INST_INT_MULTIPLY              ,
+  HUSKY_INST_INT_DIVIDE                ,
+  HUSKY_INST_INT_MODULO                ,
+  HUSKY_INST_IS_EQUAL                  ,
+  HUSKY_INST_IS_NOT_EQUAL              ,
+  HUSKY_INST_IS_LESS                   ,
+  HUSKY_INST_IS_LESS_OR_EQUAL          ,
+  HUSKY_INST_IS_GREATER                ,
+  HUSKY_INST_IS_GREATER_OR_EQUAL       ,
+  HUSKY_INST_BIT_NOT                   ,
+  HUSKY_INST_BIT_AND                   ,
+  HUSKY_INST_BIT_OR                    ,
+  HUSKY_INST_BIT_XOR                   ,
+  HUSKY_INST_BIT_SHIFT_LEFT            ,
+  HUSKY_INST_BIT_SHIFT_RIGHT           ,
+  HUSKY_INST_BIT_INT_SHIFT_RIGHT       ,
+  HUSKY_INST_PRINT                     ,
+  HUSKY_INST_MEMORY_COPY               ,
+  HUSKY_INST_MEMORY_FILL               ,
+  HUSKY_INST_MEMORY_COMPARE            ,
+  HUSKY_INST_VECTOR                    ,
+  HUSKY_INST_VECTOR_REDUCE             ,
+  HUSKY_INST_FLOAT_NEGATE              ,
+  HUSKY_INST_FLOAT_ADD                 ,
+  HUSKY_INST_FLOAT_SUBTRACT            ,
+  HUSKY_INST_FLOAT_MULTIPLY            ,
+  HUSKY_INST_FLOAT_DIVIDE              ,
+  HUSKY_INST_FLOAT_SQUARE_ROOT         ,
+  HUSKY_INST_FLOAT_IS_EQUAL            ,
+  HUSKY_INST_FLOAT_IS_NOT_EQUAL        ,
+  HUSKY_INST_FLOAT_IS_LESS             ,
+  HUSKY_INST_FLOAT_IS_LESS_OR_EQUAL    ,
+  HUSKY_INST_FLOAT_IS_GREATER          ,
+  HUSKY_INST_FLOAT_IS_GREATER_OR_EQUAL ,
+  HUSKY_INST_INT_TO_FLOAT              ,
+  HUSKY_INST_FLOAT_TO_INT              ,
 
   HUSKY_N_INSTS
 } ;
 
 typedef union  husky_object_u husky_object_t ;
 typedef struct husky_s        husky_t        ;
+typedef struct husky_insn_s   husky_insn_t   ;
+typedef struct husky_decode_s husky_decode_t ;
+typedef struct husky_config_s husky_config_t ;
+typedef struct husky_bind_s   husky_bind_t   ;
 typedef u32_t ( * husky_native_t ) (husky_t *) ;
+typedef void ( * husky_sink_t ) (husky_t *, const char *, u64_t) ;
 
 union husky_object_u {
   u64_t u ;
   i64_t i ;
   ptr_t p ;
+  f64_t f ;
 } ;
 
 struct husky_s {
@@ -146,28 +191,124 @@ struct husky_s {
   u64_t  ip       ;
   u64_t  fp       ;
   u64_t  sp       ;
+  u64_t  steps    ;
   u64_t  mem_size ;
   u8_t * mem_data ;
   ptr_t  ptr      ;
+
+  u32_t  mem_mapped  ;
+  u32_t  mem_guarded ;
+  i32_t  mem_fd      ;
+  u32_t  mem_frozen  ;
+
+  u64_t  stack_top   ;
+  u64_t  stack_guard ;
+  u64_t  args_base   ;
+
+  volatile u64_t fault_ip     ;
+  volatile u64_t fault_budget ;
+  volatile u64_t fault_steps  ;
+
+  husky_decode_t * decode ;
+  husky_bind_t *   bind   ;
+
   u32_t  verbose  ;
+  u32_t  jit      ;
+  u32_t  huge     ;
+  u32_t  guard    ;
 
   u32_t ( * err_func ) (husky_t *) ;
+
+  husky_sink_t out_func ;
+  husky_sink_t log_func ;
+
+  char * out_data  ;
+  u64_t  out_size  ;
+  u64_t  out_used  ;
+  u32_t  out_flush ;
+} ;
+
+/* What `husky_create` sets up an instance with. Each instance owns all of
+ * its state, so instances can run on different threads at once; a single
+ * instance must only be used by one thread at a time. `out_func` receives
+ * what `PRINT` writes and `log_func` the loader errors and the `verbose`
+ * trace; they go to `stdout` and `stderr` when NULL. Neither may run or
+ * modify the instance they are called for.
+ *
+ * `PRINT` output is gathered in a buffer of `out_size` bytes, 4 KiB when 0,
+ * and handed to the sink when it fills up and when a run stops on halt,
+ * breakpoint or error; with `HUSKY_FLUSH_LINE` also after every newline and
+ * with `HUSKY_FLUSH_EACH` after every `PRINT`.
+ *
+ * With `guard` set, a memory of up to 4 GiB is rounded up to whole pages
+ * and reserved as 4 GiB of address space and a little more, inaccessible
+ * past `mem_size`. `LOAD_*` and `STORE_*` then only take the low 32 bits of
+ * their address and check no bounds: an access past `mem_size` faults and
+ * halts the instance on `HUSKY_ERROR_OUT_OF_MEMORY`. Larger memory is
+ * allocated as usual. */
+struct husky_config_s {
+  u64_t        mem_size  ;
+  u32_t        verbose   ;
+  u32_t        jit       ;
+  u32_t        huge      ;
+  u32_t        guard     ;
+  ptr_t        ptr       ;
+
+  u32_t ( * err_func ) (husky_t *) ;
+
+  husky_sink_t out_func  ;
+  husky_sink_t log_func  ;
+  u64_t        out_size  ;
+  u32_t        out_flush ;
 } ;
 
 const char * husky_error_as_string (u32_t err_code) ;
+const char * husky_inst_as_string (u32_t opr_code) ;
 u32_t husky_error_set (husky_t * husky, u32_t err_code) ;
 u32_t husky_error_get (husky_t * husky) ;
+
+/* `husky_error_get` for success paths: one branch while no error is
+ * pending, and the same result as `husky_error_get` otherwise. */
+static inline u32_t husky_error_check (husky_t * husky)
+{
+  if (HUSKY_SUCCESS == husky->err_code)
+    return HUSKY_SUCCESS ;
+
+  return husky_error_get(husky) ;
+}
+
+/* Whether `[addr, addr + size)` touches the stack guard page. */
+static inline int husky_memory_guarded (husky_t * husky, u64_t addr, u64_t size)
+{
+  return 0 != husky->stack_guard && addr < husky->stack_top + husky->stack_guard && husky->stack_top < addr + size ;
+}
+
 u32_t husky_state_set (husky_t * husky, u32_t state) ;
 u32_t husky_state_get (husky_t * husky) ;
+u32_t husky_memory_alloc (husky_t * husky, u64_t size) ;
+u32_t husky_memory_free (husky_t * husky) ;
+u32_t husky_memory_usage (husky_t * husky, u64_t * resident, u64_t * reserved) ;
+void husky_output_flush (husky_t * husky) ;
 u32_t husky_memory_write (husky_t * husky, u64_t addr, u64_t size, const ptr_t data) ;
 u32_t husky_memory_read (husky_t * husky, u64_t addr, u64_t size, ptr_t data) ;
 husky_object_t * husky_stack_peek (husky_t * husky, i64_t rel_addr) ;
 u32_t husky_stack_push (husky_t * husky, husky_object_t object) ;
 u32_t husky_stack_pop (husky_t * husky, husky_object_t * object) ;
+u64_t husky_args_size (int argc, char ** argv) ;
+u32_t husky_args_push (husky_t * husky, int argc, char ** argv) ;
 u32_t husky_frame_enter (husky_t * husky, i64_t size) ;
 u32_t husky_frame_leave (husky_t * husky) ;
 u32_t husky_string_verify(husky_t * husky, u64_t addr) ;
+u32_t husky_decode_flush (husky_t * husky) ;
+u32_t husky_image_decode (husky_t * husky) ;
+u32_t husky_run (husky_t * husky, u64_t max_steps) ;
 u32_t husky_clock (husky_t * husky) ;
 u32_t husky_image_load (husky_t * husky, char * filename) ;
+u32_t husky_image_load_memory (husky_t * husky, const ptr_t data, u64_t size) ;
+u32_t husky_snapshot_save (husky_t * husky, char * filename) ;
+u32_t husky_snapshot_load (husky_t * husky, char * filename) ;
+husky_t * husky_create (const husky_config_t * config) ;
+husky_t * husky_clone (husky_t * husky) ;
+void husky_destroy (husky_t * husky) ;
 
 #endif
\ No newline at end of file
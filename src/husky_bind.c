@@ -0,0 +1,428 @@
+#include "husky_bind.h"
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef _WIN32
+# include <win32/dlfcn.h>
+#else
+# include <dlfcn.h>
+#endif
+
+# define HUSKY_BIND_INDEX_SIZE 64
+
+static husky_bind_t * husky_bind_get_or_create (husky_t * husky)
+{
+  if (NULL == husky->bind)
+    husky->bind = (husky_bind_t *)calloc(1, sizeof(husky_bind_t)) ;
+
+  return husky->bind ;
+}
+
+static u64_t husky_bind_hash (u64_t module, const char * name)
+{
+  u64_t hash = 0xCBF29CE484222325ULL ^ module ;
+
+  while (0 != *name) {
+    hash = (hash ^ (u8_t)*name++) * 0x100000001B3ULL ;
+  }
+
+  return hash ;
+}
+
+/* Returns the index slot of `name` in `module`: the one holding its handle,
+ * or the empty one where it goes. */
+static u64_t * husky_bind_slot (husky_bind_t * bind, u64_t module, const char * name)
+{
+  u64_t hash = husky_bind_hash(module, name) ;
+
+  for (;; ++hash) {
+    u64_t * slot = bind->index + (hash & (bind->index_size - 1)) ;
+
+    if (0 == *slot)
+      return slot ;
+
+    husky_bind_native_t * native = bind->natives + *slot - 1 ;
+
+    if (module == native->module && 0 == strcmp(name, native->name))
+      return slot ;
+  }
+}
+
+static u32_t husky_bind_grow (husky_bind_t * bind)
+{
+  if (bind->native_count == bind->native_size) {
+    u64_t                 size    = 0 == bind->native_size ? 16 : bind->native_size << 1 ;
+    husky_bind_native_t * natives = (husky_bind_native_t *)realloc(bind->natives, size * sizeof(husky_bind_native_t)) ;
+
+    if (NULL == natives)
+      return HUSKY_ERROR_OUT_OF_MEMORY ;
+
+    bind->natives     = natives ;
+    bind->native_size = size ;
+  }
+
+  if ((bind->native_count + 1) << 1 <= bind->index_size)
+    return HUSKY_SUCCESS ;
+
+  u64_t   size  = 0 == bind->index_size ? HUSKY_BIND_INDEX_SIZE : bind->index_size << 1 ;
+  u64_t * index = (u64_t *)calloc(size, sizeof(u64_t)) ;
+  u64_t   i ;
+
+  if (NULL == index)
+    return HUSKY_ERROR_OUT_OF_MEMORY ;
+
+  free(bind->index) ;
+
+  bind->index      = index ;
+  bind->index_size = size ;
+
+  for (i = 0 ; i < bind->native_count ; ++i) {
+    *husky_bind_slot(bind, bind->natives[i].module, bind->natives[i].name) = i + 1 ;
+  }
+
+  return HUSKY_SUCCESS ;
+}
+
+/* Counts the stack slots a call with `signature` pops. */
+static u32_t husky_bind_slots (const husky_signature_t * signature, u32_t * slots)
+{
+  u32_t i ;
+
+  *slots = 0 ;
+
+  if (HUSKY_TYPE_I64 < signature->ret_type || HUSKY_SIGNATURE_ARGS_MAX < signature->arg_count)
+    return HUSKY_ERROR_INVALID_NATIVE ;
+
+  for (i = 0 ; i < signature->arg_count ; ++i) {
+    switch (signature->arg_types[i]) {
+    case HUSKY_TYPE_U64    :
+    case HUSKY_TYPE_I64    :
+    case HUSKY_TYPE_STRING : {
+      *slots += 1 ;
+    } break ;
+
+    case HUSKY_TYPE_BUFFER : {
+      *slots += 2 ;
+    } break ;
+
+    default :
+      return HUSKY_ERROR_INVALID_NATIVE ;
+    }
+  }
+
+  return HUSKY_SUCCESS ;
+}
+
+/* Opens `path`, the host program when empty, or finds it already open with
+ * the same `flags`. `*module` is 0 when it cannot be opened. */
+u32_t husky_bind_module (husky_t * husky, const char * path, int flags, u64_t * module)
+{
+  husky_bind_t * bind = husky_bind_get_or_create(husky) ;
+  u64_t          i ;
+
+  *module = 0 ;
+
+  if (NULL == bind)
+    return HUSKY_ERROR_OUT_OF_MEMORY ;
+
+  for (i = 0 ; i < bind->module_count ; ++i) {
+    if (flags == bind->modules[i].flags && 0 == strcmp(path, bind->modules[i].path)) {
+      ++bind->modules[i].opened ;
+      *module = i + 1 ;
+
+      return HUSKY_SUCCESS ;
+    }
+  }
+
+  ptr_t handle = dlopen(0 == *path ? NULL : path, flags) ;
+
+  if (NULL == handle)
+    return HUSKY_SUCCESS ;
+
+  husky_bind_module_t * modules = (husky_bind_module_t *)realloc(bind->modules, (bind->module_count + 1) * sizeof(husky_bind_module_t)) ;
+  char *                copy    = (char *)malloc(strlen(path) + 1) ;
+
+  if (NULL != modules)
+    bind->modules = modules ;
+
+  if (NULL == modules || NULL == copy) {
+    free(copy) ;
+    dlclose(handle) ;
+
+    return HUSKY_ERROR_OUT_OF_MEMORY ;
+  }
+
+  strcpy(copy, path) ;
+
+  modules[bind->module_count].path   = copy ;
+  modules[bind->module_count].flags  = flags ;
+  modules[bind->module_count].handle = handle ;
+  modules[bind->module_count].opened = 1 ;
+
+  *module = ++bind->module_count ;
+
+  return HUSKY_SUCCESS ;
+}
+
+/* Balances one open of `module`. The module itself stays loaded. */
+u32_t husky_bind_close (husky_t * husky, u64_t module)
+{
+  husky_bind_t * bind = husky->bind ;
+
+  if (NULL == bind || bind->module_count <= module - 1 || 0 == bind->modules[module - 1].opened)
+    return HUSKY_ERROR_INVALID_MODULE ;
+
+  --bind->modules[module - 1].opened ;
+
+  return HUSKY_SUCCESS ;
+}
+
+/* Looks up `name` in `module`. `*native` is 0 when it is not there. */
+u32_t husky_bind_native (husky_t * husky, u64_t module, const char * name, u64_t * native)
+{
+  husky_bind_t * bind = husky->bind ;
+
+  *native = 0 ;
+
+  if (NULL == bind || bind->module_count <= module - 1)
+    return HUSKY_ERROR_INVALID_MODULE ;
+
+  if (HUSKY_SUCCESS != husky_bind_grow(bind))
+    return HUSKY_ERROR_OUT_OF_MEMORY ;
+
+  u64_t * slot = husky_bind_slot(bind, module, name) ;
+
+  if (0 != *slot) {
+    *native = *slot ;
+    return HUSKY_SUCCESS ;
+  }
+
+  ptr_t  handle = bind->modules[module - 1].handle ;
+  ptr_t  symbol = dlsym(handle, name) ;
+  u64_t  length = strlen(name) ;
+  char * copy ;
+
+  if (NULL == symbol)
+    return HUSKY_SUCCESS ;
+
+  if (NULL == (copy = (char *)malloc(length + sizeof(HUSKY_SIGNATURE_SUFFIX))))
+    return HUSKY_ERROR_OUT_OF_MEMORY ;
+
+  strcpy(copy, name) ;
+  strcpy(copy + length, HUSKY_SIGNATURE_SUFFIX) ;
+
+  const husky_signature_t * signature = (const husky_signature_t *)dlsym(handle, copy) ;
+  u32_t                     slots     = 0 ;
+
+  copy[length] = 0 ;
+
+  if (NULL != signature && HUSKY_SUCCESS != husky_bind_slots(signature, &slots)) {
+    free(copy) ;
+    return HUSKY_ERROR_INVALID_NATIVE ;
+  }
+
+  husky_bind_native_t * entry = bind->natives + bind->native_count ;
+
+  entry->module    = module ;
+  entry->name      = copy ;
+  entry->func      = NULL == signature ? (husky_native_t)symbol : NULL ;
+  entry->typed     = NULL == signature ? NULL : (husky_typed_t)symbol ;
+  entry->signature = signature ;
+  entry->slots     = slots ;
+
+  *native = *slot = ++bind->native_count ;
+
+  return HUSKY_SUCCESS ;
+}
+
+/* Binds the natives a `.husky.bind` section lists, in order. */
+u32_t husky_bind_section (husky_t * husky, const u8_t * data, u64_t size)
+{
+  u64_t offset = 0 ;
+  u64_t count  = 0 ;
+  u32_t result ;
+
+  while (offset < size) {
+    const char * path = (const char *)data + offset ;
+    const u8_t * end  = (const u8_t *)memchr(path, 0, size - offset) ;
+
+    if (NULL == end || end + 1 == data + size)
+      return HUSKY_ERROR_INVALID_STRING ;
+
+    const char * name = (const char *)end + 1 ;
+
+    end = (const u8_t *)memchr(name, 0, data + size - (const u8_t *)name) ;
+
+    if (NULL == end)
+      return HUSKY_ERROR_INVALID_STRING ;
+
+    offset = end + 1 - data ;
+
+    u64_t module, native ;
+
+    if (HUSKY_SUCCESS != (result = husky_bind_module(husky, path, RTLD_NOW, &module)))
+      return result ;
+
+    if (0 == module)
+      return HUSKY_ERROR_INVALID_MODULE ;
+
+    if (HUSKY_SUCCESS != (result = husky_bind_native(husky, module, name, &native)))
+      return result ;
+
+    if (++count != native)
+      return HUSKY_ERROR_INVALID_NATIVE ;
+  }
+
+  return HUSKY_SUCCESS ;
+}
+
+/* Writes the modules and natives of the instance to `data`, or only sizes
+ * them when it is NULL, and returns the size: their counts, then each
+ * module as its flags, its open count and its path, and each native as
+ * its module and its name. */
+u64_t husky_bind_save (husky_t * husky, u8_t * data)
+{
+  husky_bind_t * bind = husky->bind ;
+  u64_t          size = 2 * sizeof(u64_t) ;
+  u64_t          i, value ;
+
+  if (NULL == bind) {
+    if (NULL != data)
+      memset(data, 0, size) ;
+
+    return size ;
+  }
+
+  if (NULL != data) {
+    memcpy(data, &bind->module_count, sizeof(u64_t)) ;
+    memcpy(data + sizeof(u64_t), &bind->native_count, sizeof(u64_t)) ;
+  }
+
+  for (i = 0 ; i < bind->module_count ; ++i) {
+    u64_t length = strlen(bind->modules[i].path) + 1 ;
+
+    if (NULL != data) {
+      value = (u64_t)(i64_t)bind->modules[i].flags ;
+      memcpy(data + size, &value, sizeof(u64_t)) ;
+      memcpy(data + size + sizeof(u64_t), &bind->modules[i].opened, sizeof(u64_t)) ;
+      memcpy(data + size + 2 * sizeof(u64_t), bind->modules[i].path, length) ;
+    }
+
+    size += 2 * sizeof(u64_t) + length ;
+  }
+
+  for (i = 0 ; i < bind->native_count ; ++i) {
+    u64_t length = strlen(bind->natives[i].name) + 1 ;
+
+    if (NULL != data) {
+      memcpy(data + size, &bind->natives[i].module, sizeof(u64_t)) ;
+      memcpy(data + size + sizeof(u64_t), bind->natives[i].name, length) ;
+    }
+
+    size += sizeof(u64_t) + length ;
+  }
+
+  return size ;
+}
+
+/* Reads a NUL-terminated string at `*offset` after a run of `count`
+ * numbers, failing when either is cut short. */
+static const char * husky_bind_entry (const u8_t * data, u64_t size, u64_t * offset, u64_t * values, u64_t count)
+{
+  const char * text ;
+  const u8_t * end ;
+
+  if (size - *offset < count * sizeof(u64_t))
+    return NULL ;
+
+  memcpy(values, data + *offset, count * sizeof(u64_t)) ;
+  *offset += count * sizeof(u64_t) ;
+
+  text = (const char *)data + *offset ;
+  end  = (const u8_t *)memchr(text, 0, size - *offset) ;
+
+  if (NULL == end)
+    return NULL ;
+
+  *offset = end + 1 - data ;
+
+  return text ;
+}
+
+/* Opens again the modules and looks up again the natives `husky_bind_save`
+ * wrote, in the same order, so each gets back the handle the guest holds.
+ * Fails when one is missing now or comes back under another handle. */
+u32_t husky_bind_restore (husky_t * husky, const u8_t * data, u64_t size)
+{
+  u64_t counts [2] ;
+  u64_t offset = 2 * sizeof(u64_t) ;
+  u64_t i ;
+  u32_t result ;
+
+  husky_bind_reset(husky) ;
+
+  if (size < offset)
+    return HUSKY_ERROR_INVALID_STRING ;
+
+  memcpy(counts, data, sizeof(counts)) ;
+
+  for (i = 0 ; i < counts[0] ; ++i) {
+    u64_t        values [2] ;
+    const char * path = husky_bind_entry(data, size, &offset, values, 2) ;
+    u64_t        module ;
+
+    if (NULL == path)
+      return HUSKY_ERROR_INVALID_STRING ;
+
+    if (HUSKY_SUCCESS != (result = husky_bind_module(husky, path, (int)(i64_t)values[0], &module)))
+      return result ;
+
+    if (i + 1 != module)
+      return HUSKY_ERROR_INVALID_MODULE ;
+
+    husky->bind->modules[i].opened = values[1] ;
+  }
+
+  for (i = 0 ; i < counts[1] ; ++i) {
+    u64_t        module ;
+    const char * name = husky_bind_entry(data, size, &offset, &module, 1) ;
+    u64_t        native ;
+
+    if (NULL == name)
+      return HUSKY_ERROR_INVALID_STRING ;
+
+    if (HUSKY_SUCCESS != (result = husky_bind_native(husky, module, name, &native)))
+      return result ;
+
+    if (i + 1 != native)
+      return HUSKY_ERROR_INVALID_NATIVE ;
+  }
+
+  return HUSKY_SUCCESS ;
+}
+
+/* Drops every native and closes every module. */
+void husky_bind_reset (husky_t * husky)
+{
+  husky_bind_t * bind = husky->bind ;
+  u64_t          i ;
+
+  if (NULL == bind)
+    return ;
+
+  for (i = 0 ; i < bind->native_count ; ++i) {
+    free(bind->natives[i].name) ;
+  }
+
+  for (i = 0 ; i < bind->module_count ; ++i) {
+    dlclose(bind->modules[i].handle) ;
+    free(bind->modules[i].path) ;
+  }
+
+  free(bind->natives) ;
+  free(bind->modules) ;
+  free(bind->index) ;
+  free(bind) ;
+
+  husky->bind = NULL ;
+}
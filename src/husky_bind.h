@@ -0,0 +1,118 @@
+#ifndef __HUSKY_BIND_H
+# define __HUSKY_BIND_H
+
+# include "husky.h"
+# include <stddef.h>
+
+/* Modules and natives are cached per instance. `MODULE_OPEN` and
+ * `NATIVE_LOAD` give the guest small handles into the cache instead of raw
+ * pointers: a module opened again with the same path and flags, or a
+ * native looked up again in the same module, gets the handle it got the
+ * first time without calling `dlopen` or `dlsym`, and `NATIVE_CALL` calls
+ * through the table entry of its handle. Handle 0 is the NULL of failed
+ * lookups. Modules stay loaded until the next image is loaded or the
+ * instance is destroyed, so cached natives never dangle.
+ *
+ * An image may bind its natives at load time with a `.husky.bind` section:
+ * pairs of NUL-terminated module paths and native names, the empty path
+ * standing for the host program. They get handles 1, 2, ... in order, so
+ * code can push them as constants, and loading fails if any is missing or
+ * listed twice.
+ *
+ * A native `name` may come with a `husky_signature_t` exported as
+ * `name_signature`. It is then a typed native: `NATIVE_CALL` pops its
+ * arguments, last one on top, checks and converts them into `args` and
+ * pushes what it returns, so the native never touches the stack itself. A
+ * buffer argument takes two slots, a guest address under a length, and
+ * reaches the native as a pointer followed by the length, so one call can
+ * work through a whole array in guest memory. A native flagged `NO_STACK`
+ * promises not to use the stack, and one flagged `PURE` not to use the
+ * instance at all, not even to set an error, which saves the interpreter
+ * from handing over and taking back its registers around the call.
+ *
+ * A snapshot keeps the table by path and name rather than by pointer, and
+ * restoring it opens and looks them up again in the same order, so the
+ * handles the guest holds on its stack and in its memory stay valid.
+ *
+ * The functions return an error code and leave `err_code` alone, for the
+ * interpreter to raise like any other. */
+
+# define HUSKY_BIND_SECTION        ".husky.bind"
+# define HUSKY_SIGNATURE_SUFFIX    "_signature"
+# define HUSKY_SIGNATURE_ARGS_MAX  8
+# define HUSKY_SIGNATURE_SLOTS_MAX (HUSKY_SIGNATURE_ARGS_MAX * 2)
+
+enum {
+  HUSKY_TYPE_VOID   ,
+  HUSKY_TYPE_U64    ,
+  HUSKY_TYPE_I64    ,
+  HUSKY_TYPE_STRING ,
+  HUSKY_TYPE_BUFFER ,
+
+  HUSKY_N_TYPES
+} ;
+
+enum {
+  HUSKY_SIGNATURE_NO_STACK = 0x01 ,
+  HUSKY_SIGNATURE_PURE     = 0x02
+} ;
+
+typedef struct husky_signature_s   husky_signature_t   ;
+typedef struct husky_bind_s        husky_bind_t        ;
+typedef struct husky_bind_module_s husky_bind_module_t ;
+typedef struct husky_bind_native_s husky_bind_native_t ;
+
+typedef u64_t ( * husky_typed_t ) (husky_t *, husky_object_t *) ;
+
+struct husky_signature_s {
+  u8_t  ret_type                             ;
+  u8_t  arg_count                            ;
+  u8_t  arg_types [HUSKY_SIGNATURE_ARGS_MAX] ;
+  u32_t flags                                ;
+} ;
+
+struct husky_bind_module_s {
+  char * path   ;
+  int    flags  ;
+  ptr_t  handle ;
+  u64_t  opened ;
+} ;
+
+struct husky_bind_native_s {
+  u64_t                     module    ;
+  char *                    name      ;
+  husky_native_t            func      ;
+  husky_typed_t             typed     ;
+  const husky_signature_t * signature ;
+  u32_t                     slots     ;
+} ;
+
+struct husky_bind_s {
+  husky_bind_module_t * modules      ;
+  u64_t                 module_count ;
+  husky_bind_native_t * natives      ;
+  u64_t                 native_count ;
+  u64_t                 native_size  ;
+  u64_t *               index        ;
+  u64_t                 index_size   ;
+} ;
+
+u32_t husky_bind_module (husky_t * husky, const char * path, int flags, u64_t * module) ;
+u32_t husky_bind_close (husky_t * husky, u64_t module) ;
+u32_t husky_bind_native (husky_t * husky, u64_t module, const char * name, u64_t * native) ;
+u32_t husky_bind_section (husky_t * husky, const u8_t * data, u64_t size) ;
+u64_t husky_bind_save (husky_t * husky, u8_t * data) ;
+u32_t husky_bind_restore (husky_t * husky, const u8_t * data, u64_t size) ;
+void husky_bind_reset (husky_t * husky) ;
+
+static inline const husky_bind_native_t * husky_bind_get (husky_t * husky, u64_t native)
+{
+  husky_bind_t * bind = husky->bind ;
+
+  if (NULL == bind || bind->native_count <= native - 1)
+    return NULL ;
+
+  return bind->natives + native - 1 ;
+}
+
+#endif
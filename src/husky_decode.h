@@ -0,0 +1,87 @@
+#ifndef __HUSKY_DECODE_H
+# define __HUSKY_DECODE_H
+
+# include "husky.h"
+# include "husky_jit.h"
+
+/* Code is decoded into traces: compact arrays of fixed-size records that
+ * follow the guest byte stream until an unconditional transfer, so the
+ * interpreter walks records with `++insn` and follows resolved `target`
+ * pointers instead of re-reading operands from `mem_data`. A per-page map
+ * from guest address to record lets indirect jumps, returns and jumps into
+ * the middle of a trace find their entry. Any `STORE_*` or
+ * `husky_memory_write` that hits decoded bytes drops every trace, since
+ * records and links may point into the modified code. The operand stack is
+ * assumed not to overlap decoded code.
+ *
+ * Each record also carries the stack bounds of the straight-line run it
+ * starts, in slots: `need` below `sp` and `grow` above it. The interpreter
+ * checks them once when it enters a run and then uses handlers without
+ * per-instruction underflow and overflow checks up to the next branch. */
+
+# define HUSKY_INSN_PAGE_BITS 12
+# define HUSKY_INSN_PAGE_SIZE (1 << HUSKY_INSN_PAGE_BITS)
+# define HUSKY_INSN_PAGE_MASK (HUSKY_INSN_PAGE_SIZE - 1)
+# define HUSKY_INSN_SIZE_MAX  (1 + sizeof(u64_t))
+# define HUSKY_TRACE_SIZE_MAX 1024
+
+/* Internal opcodes, past the ones an image can encode. Bytes an image
+ * cannot encode are decoded as `HUSKY_N_INSTS`. The `HUSKY_INSN_JIT_*` ones
+ * replace calls and backward jumps when the JIT is on, so that the
+ * interpreter counts them and enters compiled code once they are hot.
+ *
+ * The fused ones head a common sequence and run all of it in one dispatch;
+ * the records of the sequence stay in place after the head, which reads
+ * their operands, so jumps into the middle of it still work. */
+enum {
+  HUSKY_INSN_FP_ADD                            = 0xE0  ,
+  HUSKY_INSN_PUSH_STORE_64                     = 0xE1  ,
+  HUSKY_INSN_IS_EQUAL_JUMP_IF_FALSE            = 0xE2  ,
+  HUSKY_INSN_IS_EQUAL_JUMP_IF_TRUE             = 0xE3  ,
+  HUSKY_INSN_IS_NOT_EQUAL_JUMP_IF_FALSE        = 0xE4  ,
+  HUSKY_INSN_IS_NOT_EQUAL_JUMP_IF_TRUE         = 0xE5  ,
+  HUSKY_INSN_IS_LESS_JUMP_IF_FALSE             = 0xE6  ,
+  HUSKY_INSN_IS_LESS_JUMP_IF_TRUE              = 0xE7  ,
+  HUSKY_INSN_IS_LESS_OR_EQUAL_JUMP_IF_FALSE    = 0xE8  ,
+  HUSKY_INSN_IS_LESS_OR_EQUAL_JUMP_IF_TRUE     = 0xE9  ,
+  HUSKY_INSN_IS_GREATER_JUMP_IF_FALSE          = 0xEA  ,
+  HUSKY_INSN_IS_GREATER_JUMP_IF_TRUE           = 0xEB  ,
+  HUSKY_INSN_IS_GREATER_OR_EQUAL_JUMP_IF_FALSE = 0xEC  ,
+  HUSKY_INSN_IS_GREATER_OR_EQUAL_JUMP_IF_TRUE  = 0xED  ,
+  HUSKY_INSN_JIT_CALL                          = 0xF0  ,
+  HUSKY_INSN_JIT_JUMP                          = 0xF1  ,
+  HUSKY_INSN_JIT_JUMP_IF_FALSE                 = 0xF2  ,
+  HUSKY_INSN_JIT_JUMP_IF_TRUE                  = 0xF3  ,
+  HUSKY_INSN_LINK                              = 0xFF  ,
+  HUSKY_INSN_CHECKED                           = 0x100 ,
+} ;
+
+typedef struct husky_trace_s husky_trace_t ;
+
+struct husky_insn_s {
+  u64_t          opr_data ;
+  husky_insn_t * target   ;
+  u64_t          addr     ;
+  u8_t           opr_code ;
+  u8_t           base     ;
+  u8_t           size     ;
+  u16_t          need     ;
+  u16_t          grow     ;
+} ;
+
+struct husky_trace_s {
+  husky_trace_t * next ;
+  u64_t           size ;
+  husky_insn_t    insn [] ;
+} ;
+
+struct husky_decode_s {
+  husky_insn_t *** pages  ;
+  u64_t            count  ;
+  husky_trace_t *  traces ;
+  husky_jit_t *    jit    ;
+} ;
+
+husky_insn_t * husky_insn_lookup (husky_t * husky, u64_t addr) ;
+
+#endif
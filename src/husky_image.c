@@ -0,0 +1,129 @@
+#include "husky_image.h"
+#include <string.h>
+
+/* Reads an unsigned LEB128 varint at `*offset` and moves past it, failing
+ * when the image ends first or the value does not fit in 64 bits. */
+u32_t husky_image_varint (const u8_t * data, u64_t size, u64_t * offset, u64_t * value)
+{
+  u64_t result = 0 ;
+  u32_t shift  = 0 ;
+  u8_t  byte ;
+
+  do {
+    if (size <= *offset || 64 <= shift)
+      return HUSKY_FAILURE ;
+
+    byte = data[(*offset)++] ;
+
+    if (63 == shift && 1 < byte)
+      return HUSKY_FAILURE ;
+
+    result |= (u64_t)(byte & 0x7F) << shift ;
+    shift  += 7 ;
+  } while (0 != (byte & 0x80)) ;
+
+  *value = result ;
+
+  return HUSKY_SUCCESS ;
+}
+
+/* The reflected CRC-32 of zlib, a nibble at a time to keep the table
+ * small. */
+u32_t husky_image_crc32 (const u8_t * data, u64_t size)
+{
+  static const u32_t table [16] = {
+    0x00000000 , 0x1DB71064 , 0x3B6E20C8 , 0x26D930AC ,
+    0x76DC4190 , 0x6B6B51F4 , 0x4DB26158 , 0x5005713C ,
+    0xEDB88320 , 0xF00F9344 , 0xD6D6A3E8 , 0xCB61B38C ,
+    0x9B64C2B0 , 0x86D3D2D4 , 0xA00AE278 , 0xBDBDF21C
+  } ;
+
+  u32_t crc = 0xFFFFFFFF ;
+  u64_t i ;
+
+  for (i = 0 ; i < size ; ++i) {
+    crc ^= data[i] ;
+    crc  = (crc >> 4) ^ table[crc & 0x0F] ;
+    crc  = (crc >> 4) ^ table[crc & 0x0F] ;
+  }
+
+  return ~crc ;
+}
+
+static u32_t husky_image_length (const u8_t * src, u64_t src_size, u64_t * in, u64_t * length)
+{
+  u8_t byte ;
+
+  if (15 != *length)
+    return HUSKY_SUCCESS ;
+
+  do {
+    if (src_size <= *in)
+      return HUSKY_FAILURE ;
+
+    byte     = src[(*in)++] ;
+    *length += byte ;
+  } while (255 == byte) ;
+
+  return HUSKY_SUCCESS ;
+}
+
+/* Decodes one LZ4 block, which must fill `dst` exactly. Every length and
+ * offset is checked against both buffers, so a corrupt block fails rather
+ * than reading or writing out of them. */
+u32_t husky_image_lz4 (const u8_t * src, u64_t src_size, u8_t * dst, u64_t dst_size)
+{
+  u64_t in  = 0 ;
+  u64_t out = 0 ;
+
+  for (;;) {
+    u64_t length, offset ;
+    u8_t  token ;
+
+    if (src_size <= in)
+      return HUSKY_FAILURE ;
+
+    token  = src[in++] ;
+    length = token >> 4 ;
+
+    if (
+      HUSKY_SUCCESS != husky_image_length(src, src_size, &in, &length) ||
+      src_size - in < length                                            ||
+      dst_size - out < length
+    )
+      return HUSKY_FAILURE ;
+
+    memcpy(dst + out, src + in, length) ;
+    in  += length ;
+    out += length ;
+
+    if (src_size == in)
+      return dst_size == out ? HUSKY_SUCCESS : HUSKY_FAILURE ;
+
+    if (src_size - in < 2)
+      return HUSKY_FAILURE ;
+
+    offset  = (u64_t)src[in] | ((u64_t)src[in + 1] << 8) ;
+    in     += 2 ;
+    length  = token & 0x0F ;
+
+    if (
+      0 == offset || out < offset                                       ||
+      HUSKY_SUCCESS != husky_image_length(src, src_size, &in, &length) ||
+      dst_size - out < length + 4
+    )
+      return HUSKY_FAILURE ;
+
+    length += 4 ;
+
+    if (length <= offset) {
+      memcpy(dst + out, dst + out - offset, length) ;
+      out += length ;
+    } else {
+      /* The match overlaps what it writes and repeats its last `offset`
+       * bytes, so it is copied forward a byte at a time. */
+      for (; 0 < length ; --length, ++out)
+        dst[out] = dst[out - offset] ;
+    }
+  }
+}
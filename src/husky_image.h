@@ -0,0 +1,51 @@
+#ifndef __HUSKY_IMAGE_H
+# define __HUSKY_IMAGE_H
+
+# include "husky.h"
+
+/* Version 2 images keep the magic number and the version of version 1 but
+ * write every number after them as an unsigned LEB128 varint: the memory
+ * size, `ip`, `sp` and the number of sections. Each section is then its
+ * NUL-terminated name of up to 32 characters, a flags byte, its address
+ * and its size in memory, followed by
+ *
+ *   - nothing for a `BSS` or a `STACK` section, which is zero-filled;
+ *   - the varint size of the LZ4 block and the block for an `LZ4` section;
+ *   - `size` raw bytes otherwise;
+ *
+ * and, unless it is `BSS` or `STACK`, the CRC-32 of the stored bytes as 4 bytes
+ * little-endian, the same CRC as zlib's. The bind section must have no
+ * flags.
+ *
+ * `CODE` marks where instructions are: when an image has any, `ip` must be
+ * in one of them. `READ_ONLY` sections are never written by the guest and
+ * `DATA` ones are, so raw sections are mapped from the file when they are
+ * read-only or code and copied when they are data, which spares a
+ * copy-on-write fault per page. A section cannot be both `READ_ONLY` and
+ * `DATA`, nor `BSS` and `LZ4` or `CODE`, and unknown flags are rejected.
+ *
+ * A `STACK` section, which takes no other flag, is where the stack lives:
+ * `sp` must be in it and pushes past its end overflow, so the stack cannot
+ * run into what lies above it. When it ends on a page boundary with a page
+ * of memory to spare, that page is made inaccessible and no other section
+ * may use it. An image has at most one; without it the stack may grow up
+ * to the end of the memory. */
+
+# define HUSKY_IMAGE_NAME_MAX 32
+
+enum {
+  HUSKY_SECTION_CODE      = 0x01 ,
+  HUSKY_SECTION_READ_ONLY = 0x02 ,
+  HUSKY_SECTION_DATA      = 0x04 ,
+  HUSKY_SECTION_BSS       = 0x08 ,
+  HUSKY_SECTION_LZ4       = 0x10 ,
+  HUSKY_SECTION_STACK     = 0x20 ,
+
+  HUSKY_SECTION_FLAGS     = 0x3F
+} ;
+
+u32_t husky_image_varint (const u8_t * data, u64_t size, u64_t * offset, u64_t * value) ;
+u32_t husky_image_crc32 (const u8_t * data, u64_t size) ;
+u32_t husky_image_lz4 (const u8_t * src, u64_t src_size, u8_t * dst, u64_t dst_size) ;
+
+#endif
@@ -0,0 +1,1468 @@
+#include "husky.h"
+#include "husky_decode.h"
+#include "husky_jit.h"
+#include <stdlib.h>
+#include <string.h>
+#include <stddef.h>
+
+#if defined(__x86_64__) && !defined(_WIN32) && !defined(HUSKY_NO_JIT)
+# define HUSKY_JIT_X86_64
+# include <sys/mman.h>
+# include <unistd.h>
+#endif
+
+#ifndef HUSKY_JIT_X86_64
+
+husky_jit_t * husky_jit_create (husky_t * husky)
+{
+  (void)husky ;
+
+  return NULL ;
+}
+
+void husky_jit_destroy (husky_jit_t * jit)
+{
+  (void)jit ;
+}
+
+u64_t husky_jit_enter (husky_t * husky, husky_insn_t * insn, u64_t addr, u64_t budget)
+{
+  (void)husky ;
+  (void)addr  ;
+
+  insn->opr_code = insn->base ;
+
+  return budget ;
+}
+
+#else
+
+/* A template JIT. A region is compiled once its root, a call target or the
+ * target of a backward jump, has been reached `HUSKY_JIT_THRESHOLD` times.
+ * It covers what is reachable from the root through fallthrough and direct
+ * jumps; each instruction becomes a fixed sequence of x86-64 code working
+ * on guest memory, with `sp`, `fp` and the step budget in registers and the
+ * topmost operand stack slots cached in scratch registers. Pushes are
+ * written through to memory, so guest memory is always up to date and a
+ * side exit only has to fix `sp` before handing the instruction back to the
+ * interpreter, which then raises any error exactly as it would have.
+ *
+ * Stack bounds and the budget are checked once per block, the same way as
+ * the interpreter runs. Guest calls are native calls into the callee's
+ * region with the guest return address checked on the way back, so code
+ * reached only from compiled code still counts and gets compiled. */
+
+enum {
+  HUSKY_JIT_RAX , HUSKY_JIT_RCX , HUSKY_JIT_RDX , HUSKY_JIT_RBX ,
+  HUSKY_JIT_RSP , HUSKY_JIT_RBP , HUSKY_JIT_RSI , HUSKY_JIT_RDI ,
+  HUSKY_JIT_R8  , HUSKY_JIT_R9  , HUSKY_JIT_R10 , HUSKY_JIT_R11 ,
+  HUSKY_JIT_R12 , HUSKY_JIT_R13 , HUSKY_JIT_R14 , HUSKY_JIT_R15 ,
+} ;
+
+# define HUSKY_JIT_MEM    HUSKY_JIT_RBX
+# define HUSKY_JIT_STATE  HUSKY_JIT_RBP
+# define HUSKY_JIT_SP     HUSKY_JIT_R12
+# define HUSKY_JIT_FP     HUSKY_JIT_R13
+# define HUSKY_JIT_SIZE   HUSKY_JIT_R14
+# define HUSKY_JIT_BUDGET HUSKY_JIT_R15
+
+enum {
+  HUSKY_JIT_CC_B   = 0x2 ,
+  HUSKY_JIT_CC_AE  = 0x3 ,
+  HUSKY_JIT_CC_E   = 0x4 ,
+  HUSKY_JIT_CC_NE  = 0x5 ,
+  HUSKY_JIT_CC_BE  = 0x6 ,
+  HUSKY_JIT_CC_A   = 0x7 ,
+  HUSKY_JIT_CC_JMP = 0x10 ,
+} ;
+
+# define HUSKY_JIT_REX_W 0x48
+# define HUSKY_JIT_REX   0x40
+
+# define HUSKY_JIT_REGION_MAX 1024
+# define HUSKY_JIT_HASH_SIZE  4096
+# define HUSKY_JIT_EXITS_MAX  (8 * HUSKY_JIT_REGION_MAX)
+# define HUSKY_JIT_CACHE_MAX  4
+# define HUSKY_JIT_STACK_MAX  (256 << 10)
+
+enum {
+  HUSKY_JIT_COLD   ,
+  HUSKY_JIT_FAILED ,
+} ;
+
+enum {
+  HUSKY_JIT_EXIT_NONE ,
+  HUSKY_JIT_EXIT_CALL ,
+} ;
+
+typedef struct husky_jit_state_s  husky_jit_state_t  ;
+typedef struct husky_jit_entry_s  husky_jit_entry_t  ;
+typedef struct husky_jit_buffer_s husky_jit_buffer_t ;
+typedef struct husky_jit_node_s   husky_jit_node_t   ;
+typedef struct husky_jit_exit_s   husky_jit_exit_t   ;
+typedef struct husky_jit_ctx_s    husky_jit_ctx_t    ;
+typedef void ( * husky_jit_call_t ) (husky_jit_state_t *, u8_t *) ;
+
+/* Shared with the generated code, which reads and writes it through `rbp`. */
+struct husky_jit_state_s {
+  u8_t *           mem_data  ;
+  u64_t            mem_size  ;
+  u64_t            ip        ;
+  u64_t            sp        ;
+  u64_t            fp        ;
+  u64_t            budget    ;
+  husky_insn_t *** pages     ;
+  u64_t            reason    ;
+  ptr_t            exit      ;
+  ptr_t            stack     ;
+  ptr_t            limit     ;
+  u64_t            end       ;
+  u64_t            guard     ;
+  u64_t            guard_end ;
+} ;
+
+/* `code` comes first: call sites load it through the entry's address. */
+struct husky_jit_entry_s {
+  u8_t * code  ;
+  u64_t  size  ;
+  u64_t  addr  ;
+  u64_t  count ;
+  u32_t  state ;
+} ;
+
+struct husky_jit_s {
+  husky_t *            husky ;
+  husky_jit_entry_t ** table ;
+  u64_t                mask  ;
+  u64_t                used  ;
+  u8_t *               stub  ;
+  u64_t                size  ;
+  husky_jit_state_t    state ;
+} ;
+
+struct husky_jit_buffer_s {
+  u8_t * data     ;
+  u64_t  size     ;
+  u64_t  capacity ;
+  int    failed   ;
+} ;
+
+struct husky_jit_node_s {
+  husky_insn_t insn   ;
+  i64_t        fall   ;
+  u8_t         leader ;
+  u8_t         last   ;
+  u8_t         exit   ;
+} ;
+
+struct husky_jit_exit_s {
+  u64_t pos     ;
+  u64_t ip      ;
+  i64_t off     ;
+  u64_t refund  ;
+  u64_t reason  ;
+  int   dynamic ;
+} ;
+
+struct husky_jit_ctx_s {
+  husky_jit_t *      jit    ;
+  husky_jit_buffer_t buf    ;
+  husky_jit_node_t * node   ;
+  u64_t              count  ;
+  u64_t *            code   ;
+  u32_t *            hash   ;
+  husky_jit_exit_t * exits  ;
+  u64_t              n_exits ;
+  u64_t *            fixups ;
+  u64_t              n_fixups ;
+
+  /* The guest `sp` is `r12 + off`; the top `cache_count` slots are also in
+   * registers (`cache_reg >= 0`) or known constants. */
+  i64_t              off ;
+  int                cache_reg [HUSKY_JIT_CACHE_MAX] ;
+  u64_t              cache_imm [HUSKY_JIT_CACHE_MAX] ;
+  int                cache_count ;
+  u32_t              busy ;
+
+  /* Where the current instruction exits to when it cannot run. */
+  u64_t              ip     ;
+  i64_t              pre    ;
+  u64_t              refund ;
+} ;
+
+static const int husky_jit_pool [] = {
+  HUSKY_JIT_RSI , HUSKY_JIT_RDI , HUSKY_JIT_R8  ,
+  HUSKY_JIT_R9  , HUSKY_JIT_R10 , HUSKY_JIT_R11 ,
+} ;
+
+static void husky_jit_emit (husky_jit_buffer_t * buf, const void * data, u64_t size)
+{
+  if (0 != buf->failed)
+    return ;
+
+  if (buf->capacity - buf->size < size) {
+    u64_t  capacity = 2 * buf->capacity + size ;
+    u8_t * next     = (u8_t *)realloc(buf->data, capacity) ;
+
+    if (NULL == next) {
+      buf->failed = 1 ;
+      return ;
+    }
+
+    buf->data     = next ;
+    buf->capacity = capacity ;
+  }
+
+  memcpy(buf->data + buf->size, data, size) ;
+  buf->size += size ;
+}
+
+static void husky_jit_u8 (husky_jit_buffer_t * buf, u8_t data)
+{
+  husky_jit_emit(buf, &data, sizeof(data)) ;
+}
+
+static void husky_jit_u32 (husky_jit_buffer_t * buf, u32_t data)
+{
+  husky_jit_emit(buf, &data, sizeof(data)) ;
+}
+
+static void husky_jit_u64 (husky_jit_buffer_t * buf, u64_t data)
+{
+  husky_jit_emit(buf, &data, sizeof(data)) ;
+}
+
+static void husky_jit_prefix (husky_jit_buffer_t * buf, u8_t rex, int reg, int index, int base, u32_t op)
+{
+  rex |= (reg & 8) >> 1 | (index & 8) >> 2 | (base & 8) >> 3 ;
+
+  if (0 != rex)
+    husky_jit_u8(buf, HUSKY_JIT_REX | rex) ;
+
+  if (0xFF < op)
+    husky_jit_u8(buf, op >> 8) ;
+
+  husky_jit_u8(buf, op & 0xFF) ;
+}
+
+/* `op reg, rm` with a register as `rm`. */
+static void husky_jit_rr (husky_jit_buffer_t * buf, u8_t rex, u32_t op, int reg, int rm)
+{
+  husky_jit_prefix(buf, rex, reg, 0, rm, op) ;
+  husky_jit_u8(buf, 0xC0 | (reg & 7) << 3 | (rm & 7)) ;
+}
+
+/* `op reg, [base + index * scale + disp]`, without index if `index < 0`. */
+static void husky_jit_rm (husky_jit_buffer_t * buf, u8_t rex, u32_t op, int reg, int base, int index, int scale, i64_t disp)
+{
+  husky_jit_prefix(buf, rex, reg, index < 0 ? 0 : index, base, op) ;
+
+  if (index < 0 && HUSKY_JIT_RSP != (base & 7)) {
+    husky_jit_u8(buf, 0x80 | (reg & 7) << 3 | (base & 7)) ;
+  } else {
+    husky_jit_u8(buf, 0x84 | (reg & 7) << 3) ;
+    husky_jit_u8(
+      buf                                                       ,
+      (8 == scale ? 3 : 4 == scale ? 2 : 2 == scale ? 1 : 0) << 6 |
+      ((index < 0 ? HUSKY_JIT_RSP : index) & 7) << 3              |
+      (base & 7)
+    ) ;
+  }
+
+  husky_jit_u32(buf, (u32_t)disp) ;
+}
+
+static void husky_jit_mov_imm (husky_jit_buffer_t * buf, int reg, u64_t imm)
+{
+  if (imm <= 0xFFFFFFFF) {
+    husky_jit_prefix(buf, 0, 0, 0, reg, 0xB8 + (reg & 7)) ;
+    husky_jit_u32(buf, (u32_t)imm) ;
+  } else if ((i64_t)imm == (i32_t)imm) {
+    husky_jit_rr(buf, HUSKY_JIT_REX_W, 0xC7, 0, reg) ;
+    husky_jit_u32(buf, (u32_t)imm) ;
+  } else {
+    husky_jit_prefix(buf, HUSKY_JIT_REX_W, 0, 0, reg, 0xB8 + (reg & 7)) ;
+    husky_jit_u64(buf, imm) ;
+  }
+}
+
+static void husky_jit_push (husky_jit_buffer_t * buf, int reg)
+{
+  husky_jit_prefix(buf, 0, 0, 0, reg, 0x50 + (reg & 7)) ;
+}
+
+static void husky_jit_pop (husky_jit_buffer_t * buf, int reg)
+{
+  husky_jit_prefix(buf, 0, 0, 0, reg, 0x58 + (reg & 7)) ;
+}
+
+/* Emits a `jcc` or `jmp` and returns where its `rel32` goes. */
+static u64_t husky_jit_jump (husky_jit_buffer_t * buf, int cc)
+{
+  if (HUSKY_JIT_CC_JMP == cc) {
+    husky_jit_u8(buf, 0xE9) ;
+  } else {
+    husky_jit_u8(buf, 0x0F) ;
+    husky_jit_u8(buf, 0x80 | cc) ;
+  }
+
+  husky_jit_u32(buf, 0) ;
+
+  return buf->size - sizeof(u32_t) ;
+}
+
+static void husky_jit_patch (husky_jit_buffer_t * buf, u64_t pos, u64_t target)
+{
+  u32_t rel = (u32_t)(target - (pos + sizeof(u32_t))) ;
+
+  if (0 == buf->failed)
+    memcpy(buf->data + pos, &rel, sizeof(rel)) ;
+}
+
+static u8_t * husky_jit_map (husky_jit_buffer_t * buf, u64_t * size)
+{
+  u64_t page = (u64_t)sysconf(_SC_PAGESIZE) ;
+
+  if (0 != buf->failed)
+    return NULL ;
+
+  *size = (buf->size + page - 1) & ~(page - 1) ;
+
+  u8_t * code = (u8_t *)mmap(NULL, *size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0) ;
+
+  if (MAP_FAILED == (void *)code)
+    return NULL ;
+
+  memcpy(code, buf->data, buf->size) ;
+
+  if (0 != mprotect(code, *size, PROT_READ | PROT_EXEC)) {
+    munmap(code, *size) ;
+    return NULL ;
+  }
+
+  return code ;
+}
+
+static husky_jit_entry_t * husky_jit_entry (husky_jit_t * jit, u64_t addr)
+{
+  u64_t i = (addr * 0x9E3779B97F4A7C15ull >> 32) & jit->mask ;
+
+  for (; NULL != jit->table[i] ; i = (i + 1) & jit->mask) {
+    if (addr == jit->table[i]->addr)
+      return jit->table[i] ;
+  }
+
+  if (jit->mask < 2 * (jit->used + 1)) {
+    u64_t                mask  = 2 * jit->mask + 1 ;
+    husky_jit_entry_t ** table = (husky_jit_entry_t **)calloc(mask + 1, sizeof(husky_jit_entry_t *)) ;
+    u64_t                j ;
+
+    if (NULL == table)
+      return NULL ;
+
+    for (j = 0 ; j <= jit->mask ; ++j) {
+      husky_jit_entry_t * entry = jit->table[j] ;
+
+      if (NULL == entry)
+        continue ;
+
+      for (i = (entry->addr * 0x9E3779B97F4A7C15ull >> 32) & mask ; NULL != table[i] ; i = (i + 1) & mask) ;
+
+      table[i] = entry ;
+    }
+
+    free(jit->table) ;
+
+    jit->table = table ;
+    jit->mask  = mask  ;
+
+    for (i = (addr * 0x9E3779B97F4A7C15ull >> 32) & mask ; NULL != table[i] ; i = (i + 1) & mask) ;
+  }
+
+  husky_jit_entry_t * entry = (husky_jit_entry_t *)calloc(1, sizeof(husky_jit_entry_t)) ;
+
+  if (NULL == entry)
+    return NULL ;
+
+  entry->addr  = addr ;
+  entry->state = HUSKY_JIT_COLD ;
+
+  jit->table[i] = entry ;
+  ++jit->used ;
+
+  return entry ;
+}
+
+/* Stack effect of an instruction in slots, as in `husky_insn_effect` but
+ * exact, since compiled code keeps no top-of-stack register. Returns zero
+ * for instructions that are left to the interpreter. */
+static int husky_jit_effect (const husky_insn_t * insn, i64_t * need, i64_t * grow, i64_t * move)
+{
+  i64_t rel = (i64_t)insn->opr_data ;
+
+  *need = 0 ;
+  *grow = 0 ;
+  *move = 0 ;
+
+  switch (insn->opr_code) {
+  case HUSKY_INST_NOOP  :
+  case HUSKY_INST_JUMP  :
+  case HUSKY_INST_LEAVE :
+    return 1 ;
+
+  case HUSKY_INST_CALL      :
+  case HUSKY_INST_PUSH_8    :
+  case HUSKY_INST_PUSH_16   :
+  case HUSKY_INST_PUSH_32   :
+  case HUSKY_INST_PUSH_64   :
+  case HUSKY_INST_GET_AT_FP :
+    *grow =  1 ;
+    *move =  1 ;
+    return 1 ;
+
+  case HUSKY_INST_POP           :
+  case HUSKY_INST_JUMP_IF_FALSE :
+  case HUSKY_INST_JUMP_IF_TRUE  :
+  case HUSKY_INST_RETURN        :
+  case HUSKY_INST_SET_AT_FP     :
+    *need =  1 ;
+    *move = -1 ;
+    return 1 ;
+
+  case HUSKY_INST_GET_AT_SP :
+    *need = rel < 0 ? -rel    : 0 ;
+    *grow = 0 < rel ? rel + 1 : 1 ;
+    *move = 1 ;
+    return 1 ;
+
+  case HUSKY_INST_SET_AT_SP :
+  case HUSKY_INST_EXCHANGE  :
+    *need = rel < 0 ? 1 - rel : 1 ;
+    *grow = 0 < rel ? rel     : 0 ;
+    *move = HUSKY_INST_EXCHANGE == insn->opr_code ? 0 : -1 ;
+    return 1 ;
+
+  case HUSKY_INST_ENTER :
+    *grow = 1 + rel ;
+    *move = 1 + rel ;
+    return 1 ;
+
+  case HUSKY_INST_STORE_8  :
+  case HUSKY_INST_STORE_16 :
+  case HUSKY_INST_STORE_32 :
+  case HUSKY_INST_STORE_64 :
+    *need =  2 ;
+    *move = -2 ;
+    return 1 ;
+
+  case HUSKY_INST_IS_NULL_POINTER     :
+  case HUSKY_INST_IS_NOT_NULL_POINTER :
+  case HUSKY_INST_LOAD_8              :
+  case HUSKY_INST_LOAD_16             :
+  case HUSKY_INST_LOAD_32             :
+  case HUSKY_INST_LOAD_64             :
+  case HUSKY_INST_NEGATE              :
+  case HUSKY_INST_BIT_NOT             :
+    *need = 1 ;
+    return 1 ;
+
+  case HUSKY_INST_ADD                 :
+  case HUSKY_INST_SUBTRACT            :
+  case HUSKY_INST_MULTIPLY            :
+  case HUSKY_INST_DIVIDE              :
+  case HUSKY_INST_MODULO              :
+  case HUSKY_INST_INT_MULTIPLY        :
+  case HUSKY_INST_INT_DIVIDE          :
+  case HUSKY_INST_INT_MODULO          :
+  case HUSKY_INST_IS_EQUAL            :
+  case HUSKY_INST_IS_NOT_EQUAL        :
+  case HUSKY_INST_IS_LESS             :
+  case HUSKY_INST_IS_LESS_OR_EQUAL    :
+  case HUSKY_INST_IS_GREATER          :
+  case HUSKY_INST_IS_GREATER_OR_EQUAL :
+  case HUSKY_INST_BIT_AND             :
+  case HUSKY_INST_BIT_OR              :
+  case HUSKY_INST_BIT_XOR             :
+  case HUSKY_INST_BIT_SHIFT_LEFT      :
+  case HUSKY_INST_BIT_SHIFT_RIGHT     :
+  case HUSKY_INST_BIT_INT_SHIFT_RIGHT :
+    *need =  2 ;
+    *move = -1 ;
+    return 1 ;
+
+  default :
+    return 0 ;
+  }
+}
+
+static i64_t husky_jit_find (husky_jit_ctx_t * ctx, u64_t addr)
+{
+  u64_t i = (addr * 0x9E3779B97F4A7C15ull >> 32) & (HUSKY_JIT_HASH_SIZE - 1) ;
+
+  for (; 0 != ctx->hash[i] ; i = (i + 1) & (HUSKY_JIT_HASH_SIZE - 1)) {
+    if (addr == ctx->node[ctx->hash[i] - 1].insn.addr)
+      return ctx->hash[i] - 1 ;
+  }
+
+  return -1 ;
+}
+
+static husky_jit_node_t * husky_jit_add (husky_jit_ctx_t * ctx, u64_t addr, const husky_insn_t * insn, int exit)
+{
+  husky_jit_node_t * node = ctx->node + ctx->count ;
+  u64_t              i    = (addr * 0x9E3779B97F4A7C15ull >> 32) & (HUSKY_JIT_HASH_SIZE - 1) ;
+
+  memset(node, 0, sizeof(husky_jit_node_t)) ;
+
+  if (NULL != insn)
+    node->insn = *insn ;
+
+  node->insn.addr     = addr ;
+  node->insn.opr_code = node->insn.base ;
+  node->fall          = -1 ;
+  node->exit          = exit ;
+
+  for (; 0 != ctx->hash[i] ; i = (i + 1) & (HUSKY_JIT_HASH_SIZE - 1)) ;
+
+  ctx->hash[i] = ++ctx->count ;
+
+  return node ;
+}
+
+/* Collects the region of `root` as chains of instructions in the order they
+ * will be emitted, marking block leaders. */
+static void husky_jit_discover (husky_jit_ctx_t * ctx, u64_t root)
+{
+  husky_t * husky = ctx->jit->husky ;
+  u64_t     todo [2 * HUSKY_JIT_REGION_MAX + 1] ;
+  u64_t     lead [2 * HUSKY_JIT_REGION_MAX + 1] ;
+  u64_t     n_todo = 0, n_lead = 0, i ;
+
+  todo[n_todo++] = root ;
+  lead[n_lead++] = root ;
+
+  while (0 != n_todo) {
+    u64_t addr = todo[--n_todo] ;
+
+    if (0 <= husky_jit_find(ctx, addr))
+      continue ;
+
+    for (;;) {
+      i64_t found = husky_jit_find(ctx, addr) ;
+
+      if (0 <= found) {
+        ctx->node[ctx->count - 1].fall = found ;
+        ctx->node[ctx->count - 1].last = 1 ;
+        lead[n_lead++] = addr ;
+        break ;
+      }
+
+      husky_insn_t *     insn = husky_insn_lookup(husky, addr) ;
+      husky_jit_node_t * node ;
+      i64_t              need, grow, move ;
+
+      if (NULL != insn && HUSKY_INSN_LINK == insn->opr_code) {
+        addr = insn->opr_data ;
+        continue ;
+      }
+
+      /* Anything the region cannot hold is left to the interpreter. */
+      if (NULL == insn || HUSKY_JIT_REGION_MAX - 1 <= ctx->count) {
+        node       = husky_jit_add(ctx, addr, insn, 1) ;
+        node->last = 1 ;
+        break ;
+      }
+
+      node = husky_jit_add(ctx, addr, insn, 0) ;
+
+      if (!husky_jit_effect(&node->insn, &need, &grow, &move)) {
+        node->exit = 1 ;
+        node->last = 1 ;
+        break ;
+      }
+
+      u64_t next = addr + node->insn.size ;
+
+      switch (node->insn.opr_code) {
+      case HUSKY_INST_JUMP :
+        todo[n_todo++] = node->insn.opr_data ;
+        lead[n_lead++] = node->insn.opr_data ;
+        node->last     = 1 ;
+        break ;
+
+      case HUSKY_INST_JUMP_IF_FALSE :
+      case HUSKY_INST_JUMP_IF_TRUE  :
+        todo[n_todo++] = node->insn.opr_data ;
+        lead[n_lead++] = node->insn.opr_data ;
+        lead[n_lead++] = next ;
+        break ;
+
+      case HUSKY_INST_CALL  :
+      case HUSKY_INST_LEAVE :
+        lead[n_lead++] = next ;
+        break ;
+
+      case HUSKY_INST_RETURN :
+        node->last = 1 ;
+        break ;
+
+      default :
+        break ;
+      }
+
+      if (0 != node->last)
+        break ;
+
+      addr = next ;
+    }
+  }
+
+  for (i = 0 ; i < n_lead ; ++i) {
+    i64_t found = husky_jit_find(ctx, lead[i]) ;
+
+    if (0 <= found)
+      ctx->node[found].leader = 1 ;
+  }
+}
+
+static void husky_jit_exit (husky_jit_ctx_t * ctx, int cc, u64_t ip, i64_t off, u64_t refund, u64_t reason, int dynamic)
+{
+  husky_jit_exit_t * exit = ctx->exits + ctx->n_exits ;
+
+  if (HUSKY_JIT_EXITS_MAX == ctx->n_exits) {
+    ctx->buf.failed = 1 ;
+    return ;
+  }
+
+  exit->pos     = husky_jit_jump(&ctx->buf, cc) ;
+  exit->ip      = ip ;
+  exit->off     = off ;
+  exit->refund  = refund ;
+  exit->reason  = reason ;
+  exit->dynamic = dynamic ;
+
+  ++ctx->n_exits ;
+}
+
+/* Leaves before the current instruction, for the interpreter to run it. */
+static void husky_jit_bail (husky_jit_ctx_t * ctx, int cc)
+{
+  husky_jit_exit(ctx, cc, ctx->ip, ctx->pre, ctx->refund, HUSKY_JIT_EXIT_NONE, 0) ;
+}
+
+static void husky_jit_goto (husky_jit_ctx_t * ctx, int cc, u64_t addr)
+{
+  i64_t found = husky_jit_find(ctx, addr) ;
+
+  if (found < 0) {
+    husky_jit_exit(ctx, cc, addr, 0, 0, HUSKY_JIT_EXIT_NONE, 0) ;
+    return ;
+  }
+
+  ctx->fixups[ctx->n_fixups++] = husky_jit_jump(&ctx->buf, cc) ;
+  ctx->fixups[ctx->n_fixups++] = (u64_t)found ;
+}
+
+static void husky_jit_forget (husky_jit_ctx_t * ctx)
+{
+  ctx->cache_count = 0 ;
+}
+
+/* Makes `r12` the guest `sp` again, at block boundaries. */
+static void husky_jit_settle (husky_jit_ctx_t * ctx)
+{
+  if (0 != ctx->off)
+    husky_jit_rm(&ctx->buf, HUSKY_JIT_REX_W, 0x8D, HUSKY_JIT_SP, HUSKY_JIT_SP, -1, 0, ctx->off) ;
+
+  ctx->off = 0 ;
+  husky_jit_forget(ctx) ;
+}
+
+static int husky_jit_alloc (husky_jit_ctx_t * ctx)
+{
+  for (;;) {
+    u32_t used = ctx->busy ;
+    int   i ;
+
+    for (i = 0 ; i < ctx->cache_count ; ++i) {
+      if (0 <= ctx->cache_reg[i])
+        used |= 1u << ctx->cache_reg[i] ;
+    }
+
+    for (i = 0 ; i < (int)(sizeof(husky_jit_pool) / sizeof(int)) ; ++i) {
+      if (0 == (used & 1u << husky_jit_pool[i])) {
+        ctx->busy |= 1u << husky_jit_pool[i] ;
+        return husky_jit_pool[i] ;
+      }
+    }
+
+    /* Forget the deepest cached slot, it is in memory anyway. */
+    memmove(ctx->cache_reg, ctx->cache_reg + 1, (ctx->cache_count - 1) * sizeof(int)) ;
+    memmove(ctx->cache_imm, ctx->cache_imm + 1, (ctx->cache_count - 1) * sizeof(u64_t)) ;
+    --ctx->cache_count ;
+  }
+}
+
+static void husky_jit_cache (husky_jit_ctx_t * ctx, int reg, u64_t imm)
+{
+  if (HUSKY_JIT_CACHE_MAX == ctx->cache_count) {
+    memmove(ctx->cache_reg, ctx->cache_reg + 1, (ctx->cache_count - 1) * sizeof(int)) ;
+    memmove(ctx->cache_imm, ctx->cache_imm + 1, (ctx->cache_count - 1) * sizeof(u64_t)) ;
+    --ctx->cache_count ;
+  }
+
+  ctx->cache_reg[ctx->cache_count] = reg ;
+  ctx->cache_imm[ctx->cache_count] = imm ;
+
+  ++ctx->cache_count ;
+  ctx->off += sizeof(husky_object_t) ;
+}
+
+static void husky_jit_push_reg (husky_jit_ctx_t * ctx, int reg)
+{
+  husky_jit_rm(&ctx->buf, HUSKY_JIT_REX_W, 0x89, reg, HUSKY_JIT_MEM, HUSKY_JIT_SP, 1, ctx->off) ;
+  husky_jit_cache(ctx, reg, 0) ;
+}
+
+static void husky_jit_push_imm (husky_jit_ctx_t * ctx, u64_t imm)
+{
+  if ((i64_t)imm == (i32_t)imm) {
+    husky_jit_rm(&ctx->buf, HUSKY_JIT_REX_W, 0xC7, 0, HUSKY_JIT_MEM, HUSKY_JIT_SP, 1, ctx->off) ;
+    husky_jit_u32(&ctx->buf, (u32_t)imm) ;
+  } else {
+    husky_jit_mov_imm(&ctx->buf, HUSKY_JIT_RAX, imm) ;
+    husky_jit_rm(&ctx->buf, HUSKY_JIT_REX_W, 0x89, HUSKY_JIT_RAX, HUSKY_JIT_MEM, HUSKY_JIT_SP, 1, ctx->off) ;
+  }
+
+  husky_jit_cache(ctx, -1, imm) ;
+}
+
+/* Pops the top slot into a register, or returns -1 and its value in `imm`
+ * when it is a known constant and `imm` is not NULL. */
+static int husky_jit_pop_any (husky_jit_ctx_t * ctx, u64_t * imm)
+{
+  int reg ;
+
+  ctx->off -= sizeof(husky_object_t) ;
+
+  if (0 != ctx->cache_count) {
+    --ctx->cache_count ;
+
+    reg = ctx->cache_reg[ctx->cache_count] ;
+
+    if (0 <= reg) {
+      ctx->busy |= 1u << reg ;
+      return reg ;
+    }
+
+    if (NULL != imm) {
+      *imm = ctx->cache_imm[ctx->cache_count] ;
+      return -1 ;
+    }
+
+    reg = husky_jit_alloc(ctx) ;
+    husky_jit_mov_imm(&ctx->buf, reg, ctx->cache_imm[ctx->cache_count]) ;
+
+    return reg ;
+  }
+
+  reg = husky_jit_alloc(ctx) ;
+  husky_jit_rm(&ctx->buf, HUSKY_JIT_REX_W, 0x8B, reg, HUSKY_JIT_MEM, HUSKY_JIT_SP, 1, ctx->off) ;
+
+  return reg ;
+}
+
+static int husky_jit_pop_reg (husky_jit_ctx_t * ctx)
+{
+  return husky_jit_pop_any(ctx, NULL) ;
+}
+
+/* Leaves unless `reg + size` stays within the memory and off the stack
+ * guard page; `size` is nonzero. Guarded memory only masks `reg` to 32
+ * bits, the rest faults. */
+static void husky_jit_check (husky_jit_ctx_t * ctx, int reg, i64_t size)
+{
+  husky_t * husky = ctx->jit->husky ;
+
+  if (0 != husky->mem_guarded) {
+    husky_jit_rr(&ctx->buf, 0, 0x89, reg, reg) ;
+
+    if (0 != husky->stack_guard)
+      husky_jit_rm(&ctx->buf, HUSKY_JIT_REX_W, 0x8D, HUSKY_JIT_RAX, reg, -1, 0, size) ;
+  } else {
+    husky_jit_rr(&ctx->buf, HUSKY_JIT_REX_W, 0x89, reg, HUSKY_JIT_RAX) ;
+    husky_jit_rr(&ctx->buf, HUSKY_JIT_REX_W, 0x81, 0, HUSKY_JIT_RAX) ;
+    husky_jit_u32(&ctx->buf, (u32_t)size) ;
+    husky_jit_bail(ctx, HUSKY_JIT_CC_B) ;
+    husky_jit_rr(&ctx->buf, HUSKY_JIT_REX_W, 0x39, HUSKY_JIT_SIZE, HUSKY_JIT_RAX) ;
+    husky_jit_bail(ctx, HUSKY_JIT_CC_A) ;
+  }
+
+  /* `rax` is `reg + size`: the range is clear of the guard page when it
+   * ends at its start or begins past its end. */
+  if (0 != husky->stack_guard) {
+    husky_jit_rm(&ctx->buf, HUSKY_JIT_REX_W, 0x3B, HUSKY_JIT_RAX, HUSKY_JIT_STATE, -1, 0, offsetof(husky_jit_state_t, guard)) ;
+
+    u64_t clear = husky_jit_jump(&ctx->buf, HUSKY_JIT_CC_BE) ;
+
+    husky_jit_rm(&ctx->buf, HUSKY_JIT_REX_W, 0x3B, reg, HUSKY_JIT_STATE, -1, 0, offsetof(husky_jit_state_t, guard_end)) ;
+    husky_jit_bail(ctx, HUSKY_JIT_CC_B) ;
+    husky_jit_patch(&ctx->buf, clear, ctx->buf.size) ;
+  }
+}
+
+/* Leaves unless the slot `fp + rel` is within the stack. */
+static void husky_jit_check_fp (husky_jit_ctx_t * ctx, i64_t rel)
+{
+  if (rel < 0) {
+    husky_jit_rr(&ctx->buf, HUSKY_JIT_REX_W, 0x81, 7, HUSKY_JIT_FP) ;
+    husky_jit_u32(&ctx->buf, (u32_t)-rel) ;
+    husky_jit_bail(ctx, HUSKY_JIT_CC_B) ;
+  } else {
+    husky_jit_rm(&ctx->buf, HUSKY_JIT_REX_W, 0x8D, HUSKY_JIT_RAX, HUSKY_JIT_FP, -1, 0, rel + sizeof(husky_object_t)) ;
+    husky_jit_rm(&ctx->buf, HUSKY_JIT_REX_W, 0x3B, HUSKY_JIT_RAX, HUSKY_JIT_STATE, -1, 0, offsetof(husky_jit_state_t, end)) ;
+    husky_jit_bail(ctx, HUSKY_JIT_CC_A) ;
+  }
+}
+
+/* Leaves if `[reg, reg + size)` may overlap decoded code, which only the
+ * interpreter knows how to invalidate. */
+static void husky_jit_check_code (husky_jit_ctx_t * ctx, int reg, i64_t size)
+{
+  husky_jit_buffer_t * buf = &ctx->buf ;
+
+  husky_jit_rm(buf, HUSKY_JIT_REX_W, 0x8B, HUSKY_JIT_RDX, HUSKY_JIT_STATE, -1, 0, offsetof(husky_jit_state_t, pages)) ;
+
+  husky_jit_rm(buf, HUSKY_JIT_REX_W, 0x8D, HUSKY_JIT_RCX, reg, -1, 0, -(i64_t)(HUSKY_INSN_SIZE_MAX - 1)) ;
+  husky_jit_rr(buf, HUSKY_JIT_REX_W, 0x81, 7, reg) ;
+  husky_jit_u32(buf, HUSKY_INSN_SIZE_MAX - 1) ;
+  husky_jit_rr(buf, HUSKY_JIT_REX_W, 0x0F42, HUSKY_JIT_RCX, reg) ;
+  husky_jit_rr(buf, HUSKY_JIT_REX_W, 0xC1, 5, HUSKY_JIT_RCX) ;
+  husky_jit_u8(buf, HUSKY_INSN_PAGE_BITS) ;
+  husky_jit_rm(buf, HUSKY_JIT_REX_W, 0x83, 7, HUSKY_JIT_RDX, HUSKY_JIT_RCX, 8, 0) ;
+  husky_jit_u8(buf, 0) ;
+  husky_jit_bail(ctx, HUSKY_JIT_CC_NE) ;
+
+  husky_jit_rm(buf, HUSKY_JIT_REX_W, 0x8D, HUSKY_JIT_RCX, reg, -1, 0, size - 1) ;
+  husky_jit_rr(buf, HUSKY_JIT_REX_W, 0xC1, 5, HUSKY_JIT_RCX) ;
+  husky_jit_u8(buf, HUSKY_INSN_PAGE_BITS) ;
+  husky_jit_rm(buf, HUSKY_JIT_REX_W, 0x83, 7, HUSKY_JIT_RDX, HUSKY_JIT_RCX, 8, 0) ;
+  husky_jit_u8(buf, 0) ;
+  husky_jit_bail(ctx, HUSKY_JIT_CC_NE) ;
+}
+
+static void husky_jit_binop (husky_jit_ctx_t * ctx, u8_t opr_code)
+{
+  husky_jit_buffer_t * buf = &ctx->buf ;
+  u64_t                imm = 0 ;
+  int                  o_0 = husky_jit_pop_reg(ctx) ;
+  int                  o_1 = husky_jit_pop_any(ctx, &imm) ;
+  int                  cc  = -1 ;
+  int                  alu = -1 ;
+
+  switch (opr_code) {
+  case HUSKY_INST_ADD                 : alu = 0 ; break ;
+  case HUSKY_INST_BIT_OR              : alu = 1 ; break ;
+  case HUSKY_INST_BIT_AND             : alu = 4 ; break ;
+  case HUSKY_INST_SUBTRACT            : alu = 5 ; break ;
+  case HUSKY_INST_BIT_XOR             : alu = 6 ; break ;
+  case HUSKY_INST_IS_EQUAL            : alu = 7 ; cc = HUSKY_JIT_CC_E  ; break ;
+  case HUSKY_INST_IS_NOT_EQUAL        : alu = 7 ; cc = HUSKY_JIT_CC_NE ; break ;
+  case HUSKY_INST_IS_LESS             : alu = 7 ; cc = HUSKY_JIT_CC_B  ; break ;
+  case HUSKY_INST_IS_LESS_OR_EQUAL    : alu = 7 ; cc = HUSKY_JIT_CC_BE ; break ;
+  case HUSKY_INST_IS_GREATER          : alu = 7 ; cc = HUSKY_JIT_CC_A  ; break ;
+  case HUSKY_INST_IS_GREATER_OR_EQUAL : alu = 7 ; cc = HUSKY_JIT_CC_AE ; break ;
+  default                             : break ;
+  }
+
+  if (o_1 < 0 && 0 <= alu && (i64_t)imm == (i32_t)imm) {
+    husky_jit_rr(buf, HUSKY_JIT_REX_W, 0x81, alu, o_0) ;
+    husky_jit_u32(buf, (u32_t)imm) ;
+  } else {
+    if (o_1 < 0) {
+      o_1 = husky_jit_alloc(ctx) ;
+      husky_jit_mov_imm(buf, o_1, imm) ;
+    }
+
+    switch (opr_code) {
+    case HUSKY_INST_MULTIPLY     :
+    case HUSKY_INST_INT_MULTIPLY :
+      husky_jit_rr(buf, HUSKY_JIT_REX_W, 0x0FAF, o_0, o_1) ;
+      break ;
+
+    case HUSKY_INST_DIVIDE     :
+    case HUSKY_INST_MODULO     :
+    case HUSKY_INST_INT_DIVIDE :
+    case HUSKY_INST_INT_MODULO :
+      husky_jit_rr(buf, HUSKY_JIT_REX_W, 0x85, o_1, o_1) ;
+      husky_jit_bail(ctx, HUSKY_JIT_CC_E) ;
+      husky_jit_rr(buf, HUSKY_JIT_REX_W, 0x89, o_0, HUSKY_JIT_RAX) ;
+
+      if (HUSKY_INST_DIVIDE == opr_code || HUSKY_INST_MODULO == opr_code) {
+        husky_jit_rr(buf, 0, 0x31, HUSKY_JIT_RDX, HUSKY_JIT_RDX) ;
+        husky_jit_rr(buf, HUSKY_JIT_REX_W, 0xF7, 6, o_1) ;
+      } else {
+        husky_jit_u8(buf, HUSKY_JIT_REX_W) ;
+        husky_jit_u8(buf, 0x99) ;
+        husky_jit_rr(buf, HUSKY_JIT_REX_W, 0xF7, 7, o_1) ;
+      }
+
+      if (HUSKY_INST_DIVIDE == opr_code || HUSKY_INST_INT_DIVIDE == opr_code)
+        husky_jit_rr(buf, HUSKY_JIT_REX_W, 0x89, HUSKY_JIT_RAX, o_0) ;
+      else
+        husky_jit_rr(buf, HUSKY_JIT_REX_W, 0x89, HUSKY_JIT_RDX, o_0) ;
+      break ;
+
+    case HUSKY_INST_BIT_SHIFT_LEFT      :
+    case HUSKY_INST_BIT_SHIFT_RIGHT     :
+    case HUSKY_INST_BIT_INT_SHIFT_RIGHT :
+      if (HUSKY_INST_BIT_INT_SHIFT_RIGHT != opr_code) {
+        husky_jit_rr(buf, HUSKY_JIT_REX_W, 0x85, o_1, o_1) ;
+        husky_jit_bail(ctx, HUSKY_JIT_CC_E) ;
+      }
+
+      husky_jit_rr(buf, HUSKY_JIT_REX_W, 0x89, o_1, HUSKY_JIT_RCX) ;
+      husky_jit_rr(
+        buf                                                ,
+        HUSKY_JIT_REX_W                                    ,
+        0xD3                                               ,
+        HUSKY_INST_BIT_SHIFT_LEFT  == opr_code ? 4 :
+        HUSKY_INST_BIT_SHIFT_RIGHT == opr_code ? 5 : 7     ,
+        o_0
+      ) ;
+      break ;
+
+    default :
+      husky_jit_rr(buf, HUSKY_JIT_REX_W, (u32_t)(alu << 3 | 1), o_1, o_0) ;
+      break ;
+    }
+  }
+
+  if (0 <= cc) {
+    husky_jit_rr(buf, 0, 0x0F90 | cc, 0, HUSKY_JIT_RAX) ;
+    husky_jit_rr(buf, HUSKY_JIT_REX_W, 0x0FB6, o_0, HUSKY_JIT_RAX) ;
+  }
+
+  husky_jit_push_reg(ctx, o_0) ;
+}
+
+/* Emits one instruction; returns nonzero if nothing follows it in place. */
+static int husky_jit_insn (husky_jit_ctx_t * ctx, const husky_insn_t * insn)
+{
+  husky_jit_buffer_t * buf  = &ctx->buf ;
+  u8_t                 code = insn->opr_code ;
+  i64_t                rel  = (i64_t)insn->opr_data * (i64_t)sizeof(husky_object_t) ;
+  u64_t                imm  = 0 ;
+  int                  o_0, o_1 ;
+
+  switch (code) {
+  case HUSKY_INST_NOOP :
+    break ;
+
+  case HUSKY_INST_PUSH_8  :
+  case HUSKY_INST_PUSH_16 :
+  case HUSKY_INST_PUSH_32 :
+  case HUSKY_INST_PUSH_64 :
+    husky_jit_push_imm(ctx, insn->opr_data) ;
+    break ;
+
+  case HUSKY_INST_POP :
+    ctx->off -= sizeof(husky_object_t) ;
+
+    if (0 != ctx->cache_count)
+      --ctx->cache_count ;
+    break ;
+
+  case HUSKY_INST_GET_AT_FP :
+    husky_jit_check_fp(ctx, rel) ;
+
+    o_0 = husky_jit_alloc(ctx) ;
+    husky_jit_rm(buf, HUSKY_JIT_REX_W, 0x8B, o_0, HUSKY_JIT_MEM, HUSKY_JIT_FP, 1, rel) ;
+    husky_jit_push_reg(ctx, o_0) ;
+    break ;
+
+  case HUSKY_INST_SET_AT_FP :
+    o_0 = husky_jit_pop_reg(ctx) ;
+
+    husky_jit_check_fp(ctx, rel) ;
+    husky_jit_rm(buf, HUSKY_JIT_REX_W, 0x89, o_0, HUSKY_JIT_MEM, HUSKY_JIT_FP, 1, rel) ;
+    husky_jit_forget(ctx) ;
+    break ;
+
+  case HUSKY_INST_GET_AT_SP :
+    o_0 = husky_jit_alloc(ctx) ;
+    husky_jit_rm(buf, HUSKY_JIT_REX_W, 0x8B, o_0, HUSKY_JIT_MEM, HUSKY_JIT_SP, 1, ctx->off + rel) ;
+    husky_jit_push_reg(ctx, o_0) ;
+    break ;
+
+  case HUSKY_INST_SET_AT_SP :
+    o_0 = husky_jit_pop_reg(ctx) ;
+
+    husky_jit_rm(buf, HUSKY_JIT_REX_W, 0x89, o_0, HUSKY_JIT_MEM, HUSKY_JIT_SP, 1, ctx->off + rel) ;
+    husky_jit_forget(ctx) ;
+    break ;
+
+  case HUSKY_INST_EXCHANGE :
+    o_0 = husky_jit_pop_reg(ctx) ;
+    o_1 = husky_jit_alloc(ctx) ;
+
+    husky_jit_rm(buf, HUSKY_JIT_REX_W, 0x8B, o_1, HUSKY_JIT_MEM, HUSKY_JIT_SP, 1, ctx->off + rel) ;
+    husky_jit_rm(buf, HUSKY_JIT_REX_W, 0x89, o_0, HUSKY_JIT_MEM, HUSKY_JIT_SP, 1, ctx->off + rel) ;
+    husky_jit_forget(ctx) ;
+    husky_jit_push_reg(ctx, o_1) ;
+    break ;
+
+  case HUSKY_INST_LOAD_8  :
+  case HUSKY_INST_LOAD_16 :
+  case HUSKY_INST_LOAD_32 :
+  case HUSKY_INST_LOAD_64 :
+    o_0 = husky_jit_pop_reg(ctx) ;
+
+    husky_jit_check(ctx, o_0, 1 << (code - HUSKY_INST_LOAD_8)) ;
+
+    switch (code) {
+    case HUSKY_INST_LOAD_8  : husky_jit_rm(buf, HUSKY_JIT_REX_W, 0x0FB6, o_0, HUSKY_JIT_MEM, o_0, 1, 0) ; break ;
+    case HUSKY_INST_LOAD_16 : husky_jit_rm(buf, HUSKY_JIT_REX_W, 0x0FB7, o_0, HUSKY_JIT_MEM, o_0, 1, 0) ; break ;
+    case HUSKY_INST_LOAD_32 : husky_jit_rm(buf, 0,               0x8B,   o_0, HUSKY_JIT_MEM, o_0, 1, 0) ; break ;
+    default                 : husky_jit_rm(buf, HUSKY_JIT_REX_W, 0x8B,   o_0, HUSKY_JIT_MEM, o_0, 1, 0) ; break ;
+    }
+
+    husky_jit_push_reg(ctx, o_0) ;
+    break ;
+
+  case HUSKY_INST_STORE_8  :
+  case HUSKY_INST_STORE_16 :
+  case HUSKY_INST_STORE_32 :
+  case HUSKY_INST_STORE_64 :
+    o_0 = husky_jit_pop_reg(ctx) ;
+    o_1 = husky_jit_pop_reg(ctx) ;
+
+    husky_jit_check(ctx, o_0, 1 << (code - HUSKY_INST_STORE_8)) ;
+    husky_jit_check_code(ctx, o_0, 1 << (code - HUSKY_INST_STORE_8)) ;
+
+    switch (code) {
+    case HUSKY_INST_STORE_8  : husky_jit_rm(buf, HUSKY_JIT_REX, 0x88, o_1, HUSKY_JIT_MEM, o_0, 1, 0) ; break ;
+    case HUSKY_INST_STORE_16 : husky_jit_u8(buf, 0x66) ;
+                               husky_jit_rm(buf, 0,             0x89, o_1, HUSKY_JIT_MEM, o_0, 1, 0) ; break ;
+    case HUSKY_INST_STORE_32 : husky_jit_rm(buf, 0,             0x89, o_1, HUSKY_JIT_MEM, o_0, 1, 0) ; break ;
+    default                  : husky_jit_rm(buf, HUSKY_JIT_REX_W, 0x89, o_1, HUSKY_JIT_MEM, o_0, 1, 0) ; break ;
+    }
+
+    husky_jit_forget(ctx) ;
+    break ;
+
+  case HUSKY_INST_ENTER :
+    husky_jit_rm(buf, HUSKY_JIT_REX_W, 0x89, HUSKY_JIT_FP, HUSKY_JIT_MEM, HUSKY_JIT_SP, 1, ctx->off) ;
+    ctx->off += sizeof(husky_object_t) ;
+    husky_jit_rm(buf, HUSKY_JIT_REX_W, 0x8D, HUSKY_JIT_FP, HUSKY_JIT_SP, -1, 0, ctx->off) ;
+    ctx->off += rel ;
+    husky_jit_forget(ctx) ;
+    break ;
+
+  case HUSKY_INST_LEAVE :
+    husky_jit_rr(buf, HUSKY_JIT_REX_W, 0x81, 7, HUSKY_JIT_FP) ;
+    husky_jit_u32(buf, sizeof(husky_object_t)) ;
+    husky_jit_bail(ctx, HUSKY_JIT_CC_B) ;
+    husky_jit_rm(buf, HUSKY_JIT_REX_W, 0x8D, HUSKY_JIT_SP, HUSKY_JIT_FP, -1, 0, -(i64_t)sizeof(husky_object_t)) ;
+    husky_jit_rm(buf, HUSKY_JIT_REX_W, 0x8B, HUSKY_JIT_FP, HUSKY_JIT_MEM, HUSKY_JIT_SP, 1, 0) ;
+
+    ctx->off = 0 ;
+    husky_jit_forget(ctx) ;
+    break ;
+
+  case HUSKY_INST_IS_NULL_POINTER     :
+  case HUSKY_INST_IS_NOT_NULL_POINTER :
+    o_0 = husky_jit_pop_reg(ctx) ;
+
+    husky_jit_rr(buf, HUSKY_JIT_REX_W, 0x85, o_0, o_0) ;
+    husky_jit_rr(buf, 0, 0x0F90 | (HUSKY_INST_IS_NULL_POINTER == code ? HUSKY_JIT_CC_E : HUSKY_JIT_CC_NE), 0, HUSKY_JIT_RAX) ;
+    husky_jit_rr(buf, HUSKY_JIT_REX_W, 0x0FB6, o_0, HUSKY_JIT_RAX) ;
+    husky_jit_push_reg(ctx, o_0) ;
+    break ;
+
+  case HUSKY_INST_NEGATE  :
+  case HUSKY_INST_BIT_NOT :
+    o_0 = husky_jit_pop_reg(ctx) ;
+
+    husky_jit_rr(buf, HUSKY_JIT_REX_W, 0xF7, HUSKY_INST_NEGATE == code ? 3 : 2, o_0) ;
+    husky_jit_push_reg(ctx, o_0) ;
+    break ;
+
+  case HUSKY_INST_JUMP_IF_FALSE :
+  case HUSKY_INST_JUMP_IF_TRUE  :
+    o_0 = husky_jit_pop_any(ctx, &imm) ;
+
+    husky_jit_settle(ctx) ;
+
+    if (o_0 < 0) {
+      if ((0 == imm) == (HUSKY_INST_JUMP_IF_FALSE == code))
+        husky_jit_goto(ctx, HUSKY_JIT_CC_JMP, insn->opr_data) ;
+    } else {
+      husky_jit_rr(buf, HUSKY_JIT_REX_W, 0x85, o_0, o_0) ;
+      husky_jit_goto(ctx, HUSKY_INST_JUMP_IF_FALSE == code ? HUSKY_JIT_CC_E : HUSKY_JIT_CC_NE, insn->opr_data) ;
+    }
+    break ;
+
+  case HUSKY_INST_JUMP :
+    husky_jit_settle(ctx) ;
+    husky_jit_goto(ctx, HUSKY_JIT_CC_JMP, insn->opr_data) ;
+    return 1 ;
+
+  case HUSKY_INST_CALL : {
+    husky_jit_entry_t * entry = husky_jit_entry(ctx->jit, insn->opr_data) ;
+    u64_t               ret   = insn->addr + insn->size ;
+
+    if (NULL == entry) {
+      buf->failed = 1 ;
+      return 1 ;
+    }
+
+    husky_jit_push_imm(ctx, ret) ;
+    husky_jit_settle(ctx) ;
+
+    husky_jit_rm(buf, HUSKY_JIT_REX_W, 0x3B, HUSKY_JIT_RSP, HUSKY_JIT_STATE, -1, 0, offsetof(husky_jit_state_t, limit)) ;
+    husky_jit_exit(ctx, HUSKY_JIT_CC_B, insn->opr_data, 0, 0, HUSKY_JIT_EXIT_NONE, 0) ;
+
+    husky_jit_mov_imm(buf, HUSKY_JIT_RAX, (u64_t)(uintptr_t)&entry->code) ;
+    husky_jit_rm(buf, HUSKY_JIT_REX_W, 0x8B, HUSKY_JIT_RAX, HUSKY_JIT_RAX, -1, 0, 0) ;
+    husky_jit_rr(buf, HUSKY_JIT_REX_W, 0x85, HUSKY_JIT_RAX, HUSKY_JIT_RAX) ;
+    husky_jit_exit(ctx, HUSKY_JIT_CC_E, insn->opr_data, 0, 0, HUSKY_JIT_EXIT_CALL, 0) ;
+    husky_jit_rr(buf, 0, 0xFF, 2, HUSKY_JIT_RAX) ;
+
+    husky_jit_mov_imm(buf, HUSKY_JIT_RCX, ret) ;
+    husky_jit_rr(buf, HUSKY_JIT_REX_W, 0x39, HUSKY_JIT_RCX, HUSKY_JIT_RAX) ;
+    husky_jit_exit(ctx, HUSKY_JIT_CC_NE, 0, 0, 0, HUSKY_JIT_EXIT_NONE, 1) ;
+  } break ;
+
+  case HUSKY_INST_RETURN :
+    o_0 = husky_jit_pop_reg(ctx) ;
+
+    husky_jit_settle(ctx) ;
+    husky_jit_rr(buf, HUSKY_JIT_REX_W, 0x89, o_0, HUSKY_JIT_RAX) ;
+    husky_jit_u8(buf, 0xC3) ;
+    return 1 ;
+
+  default :
+    husky_jit_binop(ctx, code) ;
+    break ;
+  }
+
+  return 0 ;
+}
+
+static void husky_jit_region (husky_jit_ctx_t * ctx)
+{
+  husky_jit_buffer_t * buf   = &ctx->buf ;
+  u64_t                block = 0, index = 0, i ;
+
+  for (i = 0 ; i < ctx->count ; ++i) {
+    husky_jit_node_t * node = ctx->node + i ;
+
+    if (0 != node->leader) {
+      i64_t need = 0, grow = 0, move = 0, depth = 0 ;
+      u64_t j ;
+
+      husky_jit_settle(ctx) ;
+
+      for (block = 0, j = i ; j < ctx->count ; ++j) {
+        i64_t this_need, this_grow ;
+
+        if ((i != j && 0 != ctx->node[j].leader) || 0 != ctx->node[j].exit)
+          break ;
+
+        husky_jit_effect(&ctx->node[j].insn, &this_need, &this_grow, &move) ;
+
+        need   = need < this_need - depth ? this_need - depth : need ;
+        grow   = grow < this_grow + depth ? this_grow + depth : grow ;
+        depth += move ;
+
+        ++block ;
+
+        if (0 != ctx->node[j].last)
+          break ;
+      }
+
+      index = 0 ;
+      ctx->code[i] = buf->size ;
+
+      if (0 < need) {
+        husky_jit_rr(buf, HUSKY_JIT_REX_W, 0x81, 7, HUSKY_JIT_SP) ;
+        husky_jit_u32(buf, (u32_t)(need * sizeof(husky_object_t))) ;
+        husky_jit_exit(ctx, HUSKY_JIT_CC_B, node->insn.addr, 0, 0, HUSKY_JIT_EXIT_NONE, 0) ;
+      }
+
+      if (0 < grow) {
+        husky_jit_rm(buf, HUSKY_JIT_REX_W, 0x8D, HUSKY_JIT_RAX, HUSKY_JIT_SP, -1, 0, grow * sizeof(husky_object_t)) ;
+        husky_jit_rm(buf, HUSKY_JIT_REX_W, 0x3B, HUSKY_JIT_RAX, HUSKY_JIT_STATE, -1, 0, offsetof(husky_jit_state_t, end)) ;
+        husky_jit_exit(ctx, HUSKY_JIT_CC_A, node->insn.addr, 0, 0, HUSKY_JIT_EXIT_NONE, 0) ;
+      }
+
+      if (0 < block) {
+        husky_jit_rr(buf, HUSKY_JIT_REX_W, 0x81, 7, HUSKY_JIT_BUDGET) ;
+        husky_jit_u32(buf, (u32_t)block) ;
+        husky_jit_exit(ctx, HUSKY_JIT_CC_B, node->insn.addr, 0, 0, HUSKY_JIT_EXIT_NONE, 0) ;
+        husky_jit_rr(buf, HUSKY_JIT_REX_W, 0x81, 5, HUSKY_JIT_BUDGET) ;
+        husky_jit_u32(buf, (u32_t)block) ;
+      }
+    } else {
+      ctx->code[i] = buf->size ;
+    }
+
+    ctx->ip     = node->insn.addr ;
+    ctx->pre    = ctx->off ;
+    ctx->refund = block - index ;
+    ctx->busy   = 0 ;
+
+    if (0 != node->exit) {
+      husky_jit_bail(ctx, HUSKY_JIT_CC_JMP) ;
+      continue ;
+    }
+
+    ++index ;
+
+    if (husky_jit_insn(ctx, &node->insn))
+      continue ;
+
+    if (0 != node->last && 0 <= node->fall) {
+      husky_jit_settle(ctx) ;
+      husky_jit_goto(ctx, HUSKY_JIT_CC_JMP, ctx->node[node->fall].insn.addr) ;
+    }
+  }
+
+  for (i = 0 ; i < ctx->n_fixups ; i += 2)
+    husky_jit_patch(buf, ctx->fixups[i], ctx->code[ctx->fixups[i + 1]]) ;
+
+  for (i = 0 ; i < ctx->n_exits ; ++i) {
+    husky_jit_exit_t * exit = ctx->exits + i ;
+
+    husky_jit_patch(buf, exit->pos, buf->size) ;
+
+    if (0 != exit->off)
+      husky_jit_rm(buf, HUSKY_JIT_REX_W, 0x8D, HUSKY_JIT_SP, HUSKY_JIT_SP, -1, 0, exit->off) ;
+
+    if (0 != exit->refund) {
+      husky_jit_rr(buf, HUSKY_JIT_REX_W, 0x81, 0, HUSKY_JIT_BUDGET) ;
+      husky_jit_u32(buf, (u32_t)exit->refund) ;
+    }
+
+    if (HUSKY_JIT_EXIT_NONE != exit->reason) {
+      husky_jit_rm(buf, HUSKY_JIT_REX_W, 0xC7, 0, HUSKY_JIT_STATE, -1, 0, offsetof(husky_jit_state_t, reason)) ;
+      husky_jit_u32(buf, (u32_t)exit->reason) ;
+    }
+
+    if (0 == exit->dynamic)
+      husky_jit_mov_imm(buf, HUSKY_JIT_RAX, exit->ip) ;
+
+    husky_jit_rm(buf, 0, 0xFF, 4, HUSKY_JIT_STATE, -1, 0, offsetof(husky_jit_state_t, exit)) ;
+  }
+}
+
+static u32_t husky_jit_compile (husky_jit_t * jit, husky_jit_entry_t * entry)
+{
+  husky_jit_ctx_t ctx ;
+  u32_t           result = HUSKY_FAILURE ;
+
+  memset(&ctx, 0, sizeof(ctx)) ;
+
+  ctx.jit    = jit ;
+  ctx.node   = (husky_jit_node_t *)malloc(HUSKY_JIT_REGION_MAX * sizeof(husky_jit_node_t)) ;
+  ctx.code   = (u64_t *)malloc(HUSKY_JIT_REGION_MAX * sizeof(u64_t)) ;
+  ctx.hash   = (u32_t *)calloc(HUSKY_JIT_HASH_SIZE, sizeof(u32_t)) ;
+  ctx.exits  = (husky_jit_exit_t *)malloc(HUSKY_JIT_EXITS_MAX * sizeof(husky_jit_exit_t)) ;
+  ctx.fixups = (u64_t *)malloc(4 * HUSKY_JIT_REGION_MAX * sizeof(u64_t)) ;
+
+  if (NULL != ctx.node && NULL != ctx.code && NULL != ctx.hash && NULL != ctx.exits && NULL != ctx.fixups) {
+    husky_jit_discover(&ctx, entry->addr) ;
+
+    if (0 != ctx.count && 0 == ctx.node[0].exit) {
+      husky_jit_region(&ctx) ;
+
+      if (NULL != (entry->code = husky_jit_map(&ctx.buf, &entry->size)))
+        result = HUSKY_SUCCESS ;
+    }
+  }
+
+  free(ctx.buf.data) ;
+  free(ctx.node) ;
+  free(ctx.code) ;
+  free(ctx.hash) ;
+  free(ctx.exits) ;
+  free(ctx.fixups) ;
+
+  return result ;
+}
+
+/* Saves the callee-saved registers, loads the guest state and calls into a
+ * region; side exits land on `exit`, which drops whatever native frames the
+ * guest calls left before storing the state back. */
+static u32_t husky_jit_stub (husky_jit_t * jit)
+{
+  husky_jit_buffer_t buf ;
+  u64_t              done, pos ;
+
+  memset(&buf, 0, sizeof(buf)) ;
+
+  husky_jit_push(&buf, HUSKY_JIT_RBX) ;
+  husky_jit_push(&buf, HUSKY_JIT_RBP) ;
+  husky_jit_push(&buf, HUSKY_JIT_R12) ;
+  husky_jit_push(&buf, HUSKY_JIT_R13) ;
+  husky_jit_push(&buf, HUSKY_JIT_R14) ;
+  husky_jit_push(&buf, HUSKY_JIT_R15) ;
+
+  husky_jit_rr(&buf, HUSKY_JIT_REX_W, 0x89, HUSKY_JIT_RDI, HUSKY_JIT_STATE) ;
+  husky_jit_rm(&buf, HUSKY_JIT_REX_W, 0x8B, HUSKY_JIT_MEM,    HUSKY_JIT_STATE, -1, 0, offsetof(husky_jit_state_t, mem_data)) ;
+  husky_jit_rm(&buf, HUSKY_JIT_REX_W, 0x8B, HUSKY_JIT_SIZE,   HUSKY_JIT_STATE, -1, 0, offsetof(husky_jit_state_t, mem_size)) ;
+  husky_jit_rm(&buf, HUSKY_JIT_REX_W, 0x8B, HUSKY_JIT_SP,     HUSKY_JIT_STATE, -1, 0, offsetof(husky_jit_state_t, sp)) ;
+  husky_jit_rm(&buf, HUSKY_JIT_REX_W, 0x8B, HUSKY_JIT_FP,     HUSKY_JIT_STATE, -1, 0, offsetof(husky_jit_state_t, fp)) ;
+  husky_jit_rm(&buf, HUSKY_JIT_REX_W, 0x8B, HUSKY_JIT_BUDGET, HUSKY_JIT_STATE, -1, 0, offsetof(husky_jit_state_t, budget)) ;
+
+  husky_jit_rm(&buf, HUSKY_JIT_REX_W, 0x89, HUSKY_JIT_RSP, HUSKY_JIT_STATE, -1, 0, offsetof(husky_jit_state_t, stack)) ;
+  husky_jit_rm(&buf, HUSKY_JIT_REX_W, 0x8D, HUSKY_JIT_RAX, HUSKY_JIT_RSP,   -1, 0, -(i64_t)HUSKY_JIT_STACK_MAX) ;
+  husky_jit_rm(&buf, HUSKY_JIT_REX_W, 0x89, HUSKY_JIT_RAX, HUSKY_JIT_STATE, -1, 0, offsetof(husky_jit_state_t, limit)) ;
+  husky_jit_rr(&buf, 0, 0xFF, 2, HUSKY_JIT_RSI) ;
+
+  done = buf.size ;
+
+  husky_jit_rm(&buf, HUSKY_JIT_REX_W, 0x89, HUSKY_JIT_RAX,    HUSKY_JIT_STATE, -1, 0, offsetof(husky_jit_state_t, ip)) ;
+  husky_jit_rm(&buf, HUSKY_JIT_REX_W, 0x89, HUSKY_JIT_SP,     HUSKY_JIT_STATE, -1, 0, offsetof(husky_jit_state_t, sp)) ;
+  husky_jit_rm(&buf, HUSKY_JIT_REX_W, 0x89, HUSKY_JIT_FP,     HUSKY_JIT_STATE, -1, 0, offsetof(husky_jit_state_t, fp)) ;
+  husky_jit_rm(&buf, HUSKY_JIT_REX_W, 0x89, HUSKY_JIT_BUDGET, HUSKY_JIT_STATE, -1, 0, offsetof(husky_jit_state_t, budget)) ;
+
+  husky_jit_pop(&buf, HUSKY_JIT_R15) ;
+  husky_jit_pop(&buf, HUSKY_JIT_R14) ;
+  husky_jit_pop(&buf, HUSKY_JIT_R13) ;
+  husky_jit_pop(&buf, HUSKY_JIT_R12) ;
+  husky_jit_pop(&buf, HUSKY_JIT_RBP) ;
+  husky_jit_pop(&buf, HUSKY_JIT_RBX) ;
+  husky_jit_u8(&buf, 0xC3) ;
+
+  pos = buf.size ;
+
+  husky_jit_rm(&buf, HUSKY_JIT_REX_W, 0x8B, HUSKY_JIT_RSP, HUSKY_JIT_STATE, -1, 0, offsetof(husky_jit_state_t, stack)) ;
+  husky_jit_patch(&buf, husky_jit_jump(&buf, HUSKY_JIT_CC_JMP), done) ;
+
+  jit->stub = husky_jit_map(&buf, &jit->size) ;
+  free(buf.data) ;
+
+  if (NULL == jit->stub)
+    return HUSKY_FAILURE ;
+
+  jit->state.exit = jit->stub + pos ;
+
+  return HUSKY_SUCCESS ;
+}
+
+husky_jit_t * husky_jit_create (husky_t * husky)
+{
+  husky_jit_t * jit = (husky_jit_t *)calloc(1, sizeof(husky_jit_t)) ;
+
+  if (NULL == jit)
+    return NULL ;
+
+  jit->husky = husky ;
+  jit->mask  = 63 ;
+  jit->table = (husky_jit_entry_t **)calloc(jit->mask + 1, sizeof(husky_jit_entry_t *)) ;
+
+  if (NULL == jit->table || HUSKY_SUCCESS != husky_jit_stub(jit)) {
+    husky_jit_destroy(jit) ;
+    return NULL ;
+  }
+
+  return jit ;
+}
+
+void husky_jit_destroy (husky_jit_t * jit)
+{
+  u64_t i ;
+
+  if (NULL == jit)
+    return ;
+
+  for (i = 0 ; NULL != jit->table && i <= jit->mask ; ++i) {
+    husky_jit_entry_t * entry = jit->table[i] ;
+
+    if (NULL == entry)
+      continue ;
+
+    if (NULL != entry->code)
+      munmap(entry->code, entry->size) ;
+
+    free(entry) ;
+  }
+
+  if (NULL != jit->stub)
+    munmap(jit->stub, jit->size) ;
+
+  free(jit->table) ;
+  free(jit) ;
+}
+
+/* Called by the interpreter on a counting record that transfers to `addr`,
+ * with the state synced to `husky`. Runs compiled code for `addr` if it is
+ * hot enough and returns the budget left. */
+u64_t husky_jit_enter (husky_t * husky, husky_insn_t * insn, u64_t addr, u64_t budget)
+{
+  husky_jit_t *       jit   = husky->decode->jit ;
+  husky_jit_entry_t * entry = husky_jit_entry(jit, addr) ;
+
+  if (NULL == entry || HUSKY_JIT_FAILED == entry->state) {
+    insn->opr_code = insn->base ;
+    return budget ;
+  }
+
+  if (NULL == entry->code) {
+    if (++entry->count < HUSKY_JIT_THRESHOLD)
+      return budget ;
+
+    if (HUSKY_SUCCESS != husky_jit_compile(jit, entry)) {
+      entry->state   = HUSKY_JIT_FAILED ;
+      insn->opr_code = insn->base ;
+      return budget ;
+    }
+  }
+
+  husky_jit_state_t * state = &jit->state ;
+
+  state->mem_data  = husky->mem_data ;
+  state->mem_size  = husky->mem_size ;
+  state->end       = husky->stack_top ;
+  state->guard     = 0 != husky->stack_guard ? husky->stack_top : UINT64_MAX ;
+  state->guard_end = husky->stack_top + husky->stack_guard ;
+  state->sp        = husky->sp ;
+  state->fp        = husky->fp ;
+  state->budget    = budget ;
+  state->pages     = husky->decode->pages ;
+
+  for (;;) {
+    state->reason = HUSKY_JIT_EXIT_NONE ;
+
+    ((husky_jit_call_t)(uintptr_t)jit->stub)(state, entry->code) ;
+
+    /* A call to code that is not compiled yet counts as a call to it. */
+    if (HUSKY_JIT_EXIT_CALL != state->reason)
+      break ;
+
+    entry = husky_jit_entry(jit, state->ip) ;
+
+    if (NULL == entry || HUSKY_JIT_FAILED == entry->state)
+      break ;
+
+    if (NULL == entry->code) {
+      if (++entry->count < HUSKY_JIT_THRESHOLD)
+        break ;
+
+      if (HUSKY_SUCCESS != husky_jit_compile(jit, entry)) {
+        entry->state = HUSKY_JIT_FAILED ;
+        break ;
+      }
+    }
+  }
+
+  husky->ip = state->ip ;
+  husky->sp = state->sp ;
+  husky->fp = state->fp ;
+
+  return state->budget ;
+}
+
+#endif
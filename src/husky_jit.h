@@ -0,0 +1,14 @@
+#ifndef __HUSKY_JIT_H
+# define __HUSKY_JIT_H
+
+# include "husky.h"
+
+# define HUSKY_JIT_THRESHOLD 1000
+
+typedef struct husky_jit_s husky_jit_t ;
+
+husky_jit_t * husky_jit_create (husky_t * husky) ;
+void husky_jit_destroy (husky_jit_t * jit) ;
+u64_t husky_jit_enter (husky_t * husky, husky_insn_t * insn, u64_t addr, u64_t budget) ;
+
+#endif
@@ -1,12 +1,21 @@
 #include "husky.h"
+#include "husky_ngram.h"
+#include "husky_pool.h"
+#include "husky_profile.h"
 #include <string.h>
 #include <stdlib.h>
 #include <stdio.h>
 #include <inttypes.h>
 
+#ifndef _WIN32
+# include <unistd.h>
+#endif
+
 void usage (char * progname, int exit_code) ;
 void version (void) ;
 void help (char * progname, char * pagename, int exit_code) ;
+int pool (husky_config_t * config, u32_t threads, u64_t quantum, char * list_name) ;
+void pool_done (husky_job_t * job) ;
 
 int main (int argc, char ** argv)
 {
@@ -16,21 +25,36 @@ int main (int argc, char ** argv)
   if (1 == argc)
     usage(argv[0], EXIT_SUCCESS) ;
 
-  husky_t husky ;
-
-  husky.err_code = HUSKY_SUCCESS ;
-  husky.state    = HUSKY_STATE_HALTED ;
-  husky.ip       = 0 ;
-  husky.fp       = 0 ;
-  husky.sp       = 0 ;
-  husky.ptr      = 0 ;
-  husky.mem_size = HUSKY_MEMORY_SIZE_DEFAULT ;
-  husky.mem_data = NULL ;
-  husky.err_func = NULL ;
-  husky.verbose  = 0 ;
+  husky_config_t config ;
+
+  config.mem_size  = HUSKY_MEMORY_SIZE_DEFAULT ;
+  config.verbose   = 0 ;
+  config.jit       = 0 ;
+  config.huge      = 0 ;
+  config.guard     = 0 ;
+  config.ptr       = NULL ;
+  config.err_func  = NULL ;
+  config.out_func  = NULL ;
+  config.log_func  = NULL ;
+  config.out_size  = 0 ;
+
+  /* Like `stdout` itself: by lines to a terminal, by blocks otherwise. */
+#ifndef _WIN32
+  config.out_flush = isatty(STDOUT_FILENO) ? HUSKY_FLUSH_LINE : HUSKY_FLUSH_FULL ;
+#else
+  config.out_flush = HUSKY_FLUSH_LINE ;
+#endif
 
   int i ;
   char * image_name = NULL ;
+  u64_t ngrams = 0 ;
+  int resident = 0 ;
+  int threads = -1 ;
+  u64_t quantum = 0 ;
+  char * profile_name = NULL ;
+  u64_t interval = 0 ;
+  char * save_name = NULL ;
+  int restore = 0 ;
 
   for (i = 1 ; i < argc ; ++i) {
     if (0 == strcmp(argv[i], "-v") || 0 == strcmp(argv[i], "--version"))
@@ -43,7 +67,47 @@ int main (int argc, char ** argv)
       help(argv[0], argv[i] + 7, EXIT_SUCCESS) ;
 
     if (0 == strcmp(argv[i], "--verbose")) {
-      husky.verbose = 1 ;
+      config.verbose = 1 ;
+    } else if (0 == strcmp(argv[i], "--jit")) {
+      config.jit = 1 ;
+    } else if (0 == strcmp(argv[i], "--huge-pages")) {
+      config.huge = 1 ;
+    } else if (0 == strcmp(argv[i], "--guard")) {
+      config.guard = 1 ;
+    } else if (0 == strcmp(argv[i], "--resident")) {
+      resident = 1 ;
+    } else if (0 == strcmp(argv[i], "--restore")) {
+      restore = 1 ;
+    } else if (0 == strcmp(argv[i], "--save")) {
+      if (argc == i + 1)
+        break ;
+
+      save_name = argv[++i] ;
+    } else if (0 == strcmp(argv[i], "--pool")) {
+      if (argc == i + 1)
+        break ;
+
+      threads = strtoul(argv[++i], NULL, 0) ;
+    } else if (0 == strcmp(argv[i], "--quantum")) {
+      if (argc == i + 1)
+        break ;
+
+      quantum = strtoull(argv[++i], NULL, 0) ;
+    } else if (0 == strcmp(argv[i], "--ngrams")) {
+      if (argc == i + 1)
+        break ;
+
+      ngrams = strtoull(argv[++i], NULL, 0) ;
+    } else if (0 == strcmp(argv[i], "--profile")) {
+      if (argc == i + 1)
+        break ;
+
+      profile_name = argv[++i] ;
+    } else if (0 == strcmp(argv[i], "--interval")) {
+      if (argc == i + 1)
+        break ;
+
+      interval = strtoull(argv[++i], NULL, 0) ;
     } else if (0 == strcmp(argv[i], "-m") || 0 == strcmp(argv[i], "--memory")) {
       if (argc == i + 1)
         break ;
@@ -51,15 +115,15 @@ int main (int argc, char ** argv)
       ++i ;
 
       char * endptr = NULL ;
-      husky.mem_size = strtoull(argv[i], &endptr, 0) ;
+      config.mem_size = strtoull(argv[i], &endptr, 0) ;
 
       if (NULL != endptr) {
         if (0 == strcmp(endptr, "_KiB")) {
-          husky.mem_size <<= 10 ;
+          config.mem_size <<= 10 ;
         } else if (0 == strcmp(endptr, "_MiB")) {
-          husky.mem_size <<= 20 ;
+          config.mem_size <<= 20 ;
         } else if (0 == strcmp(endptr, "_GiB")) {
-          husky.mem_size <<= 30 ;
+          config.mem_size <<= 30 ;
         }
       }
     } else {
@@ -73,120 +137,246 @@ int main (int argc, char ** argv)
     exit(EXIT_FAILURE) ;
   }
 
-  if (0 == husky.mem_size) {
+  if (0 == config.mem_size) {
     fprintf(stderr, "Error: Ivalid memory size.\n") ;
     exit(EXIT_FAILURE) ;
   }
 
-  u64_t argv_size = 0 ;
+  if (0 <= threads)
+    exit(pool(&config, threads, quantum, image_name)) ;
+
   int j = i ;
 
-  for (; i < argc ; ++i) {
-    argv_size += strlen(argv[i]) + 1 ;
-  }
+  config.mem_size += husky_args_size(argc - j, argv + j) ;
 
-  u64_t mem_size = husky.mem_size ;
-  husky.mem_size += argv_size ;
-  husky.mem_data = (u8_t *)calloc(husky.mem_size, sizeof(u8_t)) ;
+  husky_t * husky = husky_create(&config) ;
 
-  if (NULL == husky.mem_data) {
+  if (NULL == husky) {
     fprintf(stderr, "Error: Cannot allocate the memory.\n") ;
     exit(EXIT_FAILURE) ;
   }
 
-  if (0 != husky.verbose) {
+  if (0 != husky->verbose) {
     fprintf(stderr, "Loading `%s`...\n", image_name) ;
   }
 
-  if (HUSKY_SUCCESS != husky_image_load(&husky, image_name)) {
-    free(husky.mem_data) ;
+  if (0 != restore) {
+    if (HUSKY_SUCCESS != husky_snapshot_load(husky, image_name)) {
+      husky_destroy(husky) ;
+      exit(EXIT_FAILURE) ;
+    }
+  } else if (HUSKY_SUCCESS != husky_image_load(husky, image_name)) {
+    husky_destroy(husky) ;
+    exit(EXIT_FAILURE) ;
+  }
+
+  if (0 == restore && HUSKY_SUCCESS != husky_args_push(husky, argc - j, argv + j)) {
+    fprintf(stderr, "Error: %s\n", husky_error_as_string(husky->err_code)) ;
+    husky_destroy(husky) ;
     exit(EXIT_FAILURE) ;
   }
 
-  if (0 != husky.verbose) {
-    fprintf(stderr, "Loading %d arguments...\n", argc - j) ;
+  if (0 != husky->verbose) {
+    fprintf(stderr, "Running `%s` at 0x%012" PRIX64 "...\n", image_name, husky->ip) ;
   }
 
-  u64_t argv_addr = husky.mem_size ;
+  int exit_code = EXIT_SUCCESS ;
+  husky_ngram_t * ngram = NULL ;
 
-  for (i = argc - 1 ; j <= i ; --i) {
-    u64_t size = strlen(argv[i]) + 1 ;
-    
-    if (argv_addr < size) {
-      fprintf(stderr, "Error: Not enough memory to store the arguments\n") ;
-      free(husky.mem_data) ;
-      exit(EXIT_FAILURE) ;
+  if (0 != ngrams && NULL == (ngram = husky_ngram_create())) {
+    fprintf(stderr, "Error: Cannot allocate the n-gram table.\n") ;
+    husky_destroy(husky) ;
+    exit(EXIT_FAILURE) ;
+  }
+
+  husky_profile_t * profile = NULL ;
+
+  if (NULL != profile_name && NULL == (profile = husky_profile_create(interval))) {
+    fprintf(stderr, "Error: Cannot allocate the profile.\n") ;
+    husky_ngram_destroy(ngram) ;
+    husky_destroy(husky) ;
+    exit(EXIT_FAILURE) ;
+  }
+
+  while (HUSKY_STATE_HALTED != husky_state_get(husky)) {
+    u32_t result ;
+
+    if (NULL != ngram) {
+      result = husky_ngram_run(husky, ngram, HUSKY_STEPS_UNLIMITED) ;
+    } else if (NULL != profile) {
+      result = husky_profile_run(husky, profile, HUSKY_STEPS_UNLIMITED) ;
+    } else {
+      result = husky_run(husky, HUSKY_STEPS_UNLIMITED) ;
     }
-    
-    argv_addr -= size ;
-
-    if (0 != husky.verbose) {
-      fprintf(stderr, "Writing `%s` at 0x%012" PRIX64 "...\n", argv[i], argv_addr) ;
-      fprintf(stderr, "  * Argument Address = 0x%012" PRIX64 "\n", argv_addr) ;
-      fprintf(stderr, "  * Argument size    = %lu\n", size) ;
-      fprintf(stderr, "  * Memory Size      = %lu\n", husky.mem_size) ;
+
+    if (HUSKY_SUCCESS != result) {
+      fprintf(stderr, "Error: %s.\n", husky_error_as_string(husky->err_code)) ;
+      exit_code = EXIT_FAILURE ;
+      break ;
     }
 
-    if (HUSKY_SUCCESS != husky_memory_write(&husky, argv_addr, size, argv[i])) {
-      fprintf(stderr, "Error: %s\n", husky_error_as_string(husky.err_code)) ;
-      free(husky.mem_data) ;
-      exit(EXIT_FAILURE) ;
+    if (NULL != save_name && HUSKY_STATE_BREAKED == husky_state_get(husky)) {
+      if (HUSKY_SUCCESS != husky_snapshot_save(husky, save_name))
+        exit_code = EXIT_FAILURE ;
+
+      break ;
     }
   }
 
-  argv_addr = husky.mem_size ;
+  if (NULL != ngram) {
+    husky_ngram_dump(ngram, stderr, ngrams) ;
+    husky_ngram_destroy(ngram) ;
+  }
 
-  husky_object_t object ;
-  object.p = NULL ;
+  if (NULL != profile) {
+    FILE * fileptr = fopen(profile_name, "w") ;
 
-  if (HUSKY_SUCCESS != husky_stack_push(&husky, object)) {
-    free(husky.mem_data) ;
-    exit(EXIT_FAILURE) ;
+    if (NULL == fileptr) {
+      fprintf(stderr, "Error: Cannot open `%s`.\n", profile_name) ;
+      exit_code = EXIT_FAILURE ;
+    } else {
+      husky_profile_fold(profile, fileptr) ;
+      fclose(fileptr) ;
+    }
+
+    husky_profile_dump(profile, stderr, 16) ;
+    husky_profile_destroy(profile) ;
   }
 
-  for (i = argc - 1 ; j <= i ; --i) {
-    u64_t size = strlen(argv[i]) + 1 ;
-    
-    argv_addr -= size ;
+  if (0 != husky->verbose) {
+    fprintf(stderr, "Executed %" PRIu64 " instructions.\n", husky->steps) ;
+  }
 
-    if (0 != husky.verbose) {
-      fprintf(stderr, "Pushing `%s`...\n", argv[i]) ;
-    }
-    
-    object.u = argv_addr ;
+  if (0 != resident || 0 != husky->verbose) {
+    u64_t resident_size, reserved_size ;
 
-    if (HUSKY_SUCCESS != husky_stack_push(&husky, object)) {
-      fprintf(stderr, "Error: %s\n", husky_error_as_string(husky.err_code)) ;
-      free(husky.mem_data) ;
-      exit(EXIT_FAILURE) ;
-    }
+    husky_memory_usage(husky, &resident_size, &reserved_size) ;
+    fprintf(
+      stderr                                                            ,
+      "Memory: %" PRIu64 " KiB resident of %" PRIu64 " KiB reserved.\n" ,
+      resident_size >> 10                                               ,
+      reserved_size >> 10
+    ) ;
   }
 
-  object.u = argc - j ;
+  husky_destroy(husky) ;
 
-  if (HUSKY_SUCCESS != husky_stack_push(&husky, object)) {
-    fprintf(stderr, "Error: %s\n", husky_error_as_string(husky.err_code)) ;
-    free(husky.mem_data) ;
-    exit(EXIT_FAILURE) ;
+  exit(exit_code) ;
+}
+
+/* Runs every line of `list_name`, or of `stdin` for `-`, as a job of the
+ * form `IMAGE [arguments...]` and reports each one as it ends. */
+int pool (husky_config_t * config, u32_t threads, u64_t quantum, char * list_name)
+{
+  FILE * fileptr = stdin ;
+
+  if (0 != strcmp(list_name, "-") && NULL == (fileptr = fopen(list_name, "r"))) {
+    fprintf(stderr, "Error: Cannot open `%s`.\n", list_name) ;
+    return EXIT_FAILURE ;
   }
 
-  if (0 != husky.verbose) {
-    fprintf(stderr, "Running `%s` at 0x%012" PRIX64 "...\n", image_name, husky.ip) ;
+  husky_pool_t * husky_pool = husky_pool_create(threads, quantum) ;
+
+  if (NULL == husky_pool) {
+    fprintf(stderr, "Error: Cannot start the pool.\n") ;
+    return EXIT_FAILURE ;
   }
 
-  while (HUSKY_STATE_HALTED != husky_state_get(&husky)) {
-    husky_clock(&husky) ;
+  husky_job_t ** jobs      = NULL ;
+  u64_t          count     = 0 ;
+  int            exit_code = EXIT_SUCCESS ;
+  char           line [4096] ;
+  u64_t          i ;
+
+  while (NULL != fgets(line, sizeof(line), fileptr)) {
+    const char * delims = " \t\r\n" ;
+    u64_t        size   = strlen(line) + 1 ;
+    int          argc   = 0 ;
+    int          j ;
+
+    for (j = 0 ; 0 != line[j] ; ++j) {
+      if (NULL == strchr(delims, line[j]) && (0 == j || NULL != strchr(delims, line[j - 1])))
+        ++argc ;
+    }
+
+    if (0 == argc || '#' == line[strspn(line, delims)])
+      continue ;
+
+    husky_job_t *  job   = (husky_job_t *)calloc(1, sizeof(husky_job_t) + (argc + 1) * sizeof(char *) + size) ;
+    husky_job_t ** array = (husky_job_t **)realloc(jobs, (count + 1) * sizeof(husky_job_t *)) ;
+
+    if (NULL != array)
+      jobs = array ;
 
-    if (HUSKY_SUCCESS != husky_error_get(&husky)) {
-      fprintf(stderr, "Error: %s.\n", husky_error_as_string(husky.err_code)) ;
+    if (NULL == job || NULL == array) {
+      fprintf(stderr, "Error: Cannot allocate the job.\n") ;
+      free(job) ;
+      exit_code = EXIT_FAILURE ;
+      break ;
+    }
+
+    char ** argv = (char **)(job + 1) ;
+    char *  text = (char *)(argv + argc + 1) ;
+
+    memcpy(text, line, size) ;
+
+    for (j = 0, text = strtok(text, delims) ; NULL != text ; text = strtok(NULL, delims)) {
+      argv[j++] = text ;
     }
+
+    job->config    = *config ;
+    job->filename  = argv[0] ;
+    job->argc      = argc ;
+    job->argv      = argv ;
+    job->ptr       = (ptr_t)(uintptr_t)(count + 1) ;
+    job->done_func = pool_done ;
+
+    if (HUSKY_SUCCESS != husky_pool_submit(husky_pool, job)) {
+      fprintf(stderr, "Error: Cannot submit the job.\n") ;
+      free(job) ;
+      exit_code = EXIT_FAILURE ;
+      break ;
+    }
+
+    jobs[count++] = job ;
   }
 
-  if (NULL != husky.mem_data) {
-    free(husky.mem_data) ;
+  husky_pool_wait(husky_pool) ;
+  husky_pool_destroy(husky_pool) ;
+
+  if (stdin != fileptr)
+    fclose(fileptr) ;
+
+  for (i = 0 ; i < count ; ++i) {
+    if (HUSKY_SUCCESS != jobs[i]->result)
+      exit_code = EXIT_FAILURE ;
+
+    free(jobs[i]) ;
   }
 
-  exit(EXIT_SUCCESS) ;
+  free(jobs) ;
+
+  return exit_code ;
+}
+
+/* Reports a job from the worker that ran it. */
+void pool_done (husky_job_t * job)
+{
+  u32_t err_code = job->result ;
+
+  if (HUSKY_SUCCESS != err_code && HUSKY_SUCCESS != job->err_code)
+    err_code = job->err_code ;
+
+  fprintf(
+    stderr                                                                         ,
+    "Job %" PRIu64 " `%s`: %s, %" PRIu64 " steps, %" PRIu64 ".%06" PRIu64 " s.\n" ,
+    (u64_t)(uintptr_t)job->ptr                                                     ,
+    job->filename                                                                  ,
+    husky_error_as_string(err_code)                                                ,
+    job->steps                                                                     ,
+    job->time / 1000000000                                                         ,
+    job->time / 1000 % 1000000
+  ) ;
 }
 
 void usage (char * progname, int exit_code)
@@ -223,9 +413,33 @@ void help (char * progname, char * pagename, int exit_code)
       "  -v , --version     --- Print the version.\n"
       "  -m , --memory SIZE --- Set the amount of memory.\n"
       "       --verbose     --- Print misc information.\n"
+      "       --jit         --- Compile hot code to native code (x86-64).\n"
+      "       --ngrams N    --- Print the N most frequent opcode sequences.\n"
+      "       --profile OUT --- Write sampled call stacks to OUT.\n"
+      "       --interval N  --- Sample every N steps on average.\n"
+      "       --huge-pages  --- Back the memory with huge pages if possible.\n"
+      "       --guard       --- Bound loads and stores with guard pages.\n"
+      "       --resident    --- Print the resident and reserved memory at exit.\n"
+      "       --save OUT    --- Save a snapshot to OUT at the first breakpoint.\n"
+      "       --restore     --- Start from the snapshot IMAGE instead.\n"
+      "       --pool N      --- Run the jobs listed in IMAGE on N threads.\n"
+      "       --quantum N   --- Preempt pool jobs every N steps.\n"
       "Notes:\n"
       "  * SIZE is an unsigned integer. You can also append\n"
       "         `_KiB`, `_MiB` or `_GiB`.\n"
+      "  * With `--pool` each line of IMAGE, or of `stdin` for `-`,\n"
+      "         is a job `IMAGE [arguments...]`. N = 0 uses one\n"
+      "         thread per processor.\n"
+      "  * With `--profile` the steps per opcode and the hottest\n"
+      "         addresses go to `stderr` and OUT takes the folded\n"
+      "         stacks of `flamegraph.pl`. N = 1 counts every step,\n"
+      "         the default is 10000.\n"
+      "  * With `--save` the run stops at the snapshot; with\n"
+      "         `--restore` it goes on from there, with the memory\n"
+      "         size and the arguments of the snapshot.\n"
+      "  * With `--guard` loads and stores only take the low\n"
+      "         32 bits of their address when the memory is at\n"
+      "         most 4 GiB, which is rounded up to whole pages.\n"
     ) ;
   } else {
     exit_code = EXIT_FAILURE ;
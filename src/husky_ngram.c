@@ -0,0 +1,214 @@
+#include "husky_ngram.h"
+#include "husky_decode.h"
+#include <stdlib.h>
+#include <string.h>
+#include <inttypes.h>
+
+/* Counts the opcode sequences of 2 to 4 instructions a program runs, so
+ * the fusion table can be tuned against real workloads. Instructions are
+ * run one at a time and a sequence only spans straight-line code: a taken
+ * branch, call or return starts a new one, as fusion cannot cross them. */
+
+# define HUSKY_NGRAM_TABLE_SIZE 1024
+
+typedef struct husky_ngram_entry_s husky_ngram_entry_t ;
+
+struct husky_ngram_entry_s {
+  u64_t key   ;
+  u64_t count ;
+} ;
+
+struct husky_ngram_s {
+  husky_ngram_entry_t * table  ;
+  u64_t                 size   ;
+  u64_t                 used   ;
+  u8_t                  window [HUSKY_NGRAM_SIZE_MAX] ;
+  u32_t                 length ;
+} ;
+
+/* A key packs the opcodes in its low bytes, newest first, and the length
+ * above them, so that it is never 0 and 0 can mark empty entries. */
+static u64_t husky_ngram_key (husky_ngram_t * ngram, u32_t size)
+{
+  u64_t key = (u64_t)size << 32 ;
+  u32_t i ;
+
+  for (i = 0 ; i < size ; ++i)
+    key |= (u64_t)ngram->window[ngram->length - 1 - i] << (8 * i) ;
+
+  return key ;
+}
+
+static husky_ngram_entry_t * husky_ngram_find (husky_ngram_entry_t * table, u64_t size, u64_t key)
+{
+  u64_t hash = (key * 0x9E3779B97F4A7C15ULL) >> 32 ;
+
+  for (;;) {
+    husky_ngram_entry_t * entry = table + (hash & (size - 1)) ;
+
+    if (0 == entry->key || key == entry->key)
+      return entry ;
+
+    ++hash ;
+  }
+}
+
+static u32_t husky_ngram_grow (husky_ngram_t * ngram)
+{
+  u64_t                 size  = ngram->size << 1 ;
+  husky_ngram_entry_t * table = (husky_ngram_entry_t *)calloc(size, sizeof(husky_ngram_entry_t)) ;
+  u64_t                 i ;
+
+  if (NULL == table)
+    return HUSKY_ERROR_OUT_OF_MEMORY ;
+
+  for (i = 0 ; i < ngram->size ; ++i) {
+    if (0 != ngram->table[i].key)
+      *husky_ngram_find(table, size, ngram->table[i].key) = ngram->table[i] ;
+  }
+
+  free(ngram->table) ;
+
+  ngram->table = table ;
+  ngram->size  = size ;
+
+  return HUSKY_SUCCESS ;
+}
+
+static u32_t husky_ngram_count (husky_ngram_t * ngram, u8_t opr_code)
+{
+  u32_t size ;
+
+  if (HUSKY_NGRAM_SIZE_MAX == ngram->length) {
+    memmove(ngram->window, ngram->window + 1, HUSKY_NGRAM_SIZE_MAX - 1) ;
+    --ngram->length ;
+  }
+
+  ngram->window[ngram->length++] = opr_code ;
+
+  for (size = HUSKY_NGRAM_SIZE_MIN ; size <= ngram->length ; ++size) {
+    if (ngram->size <= (ngram->used + 1) << 1 && HUSKY_SUCCESS != husky_ngram_grow(ngram))
+      return HUSKY_ERROR_OUT_OF_MEMORY ;
+
+    u64_t                 key   = husky_ngram_key(ngram, size) ;
+    husky_ngram_entry_t * entry = husky_ngram_find(ngram->table, ngram->size, key) ;
+
+    if (0 == entry->key) {
+      entry->key = key ;
+      ++ngram->used ;
+    }
+
+    ++entry->count ;
+  }
+
+  return HUSKY_SUCCESS ;
+}
+
+husky_ngram_t * husky_ngram_create (void)
+{
+  husky_ngram_t * ngram = (husky_ngram_t *)calloc(1, sizeof(husky_ngram_t)) ;
+
+  if (NULL == ngram)
+    return NULL ;
+
+  ngram->size  = HUSKY_NGRAM_TABLE_SIZE ;
+  ngram->table = (husky_ngram_entry_t *)calloc(ngram->size, sizeof(husky_ngram_entry_t)) ;
+
+  if (NULL == ngram->table) {
+    free(ngram) ;
+    return NULL ;
+  }
+
+  return ngram ;
+}
+
+void husky_ngram_destroy (husky_ngram_t * ngram)
+{
+  if (NULL == ngram)
+    return ;
+
+  free(ngram->table) ;
+  free(ngram) ;
+}
+
+/* Runs like `husky_run`, one instruction at a time, counting the opcodes
+ * of the image rather than the records they were decoded to. */
+u32_t husky_ngram_run (husky_t * husky, husky_ngram_t * ngram, u64_t max_steps)
+{
+  if (HUSKY_STATE_HALTED == husky->state)
+    return husky_error_get(husky) ;
+
+  husky->state = HUSKY_STATE_READY ;
+
+  u32_t result = HUSKY_SUCCESS ;
+
+  for (; 0 != max_steps && HUSKY_STATE_READY == husky->state ; --max_steps) {
+    husky_insn_t * insn = husky_insn_lookup(husky, husky->ip) ;
+
+    if (NULL == insn)
+      return husky_run(husky, 1) ;
+
+    u64_t next = insn->addr + insn->size ;
+    u8_t  base = insn->base ;
+
+    if (HUSKY_SUCCESS != (result = husky_run(husky, 1)))
+      break ;
+
+    if (HUSKY_SUCCESS != husky_ngram_count(ngram, base))
+      return husky_error_set(husky, HUSKY_ERROR_OUT_OF_MEMORY) ;
+
+    if (next != husky->ip)
+      ngram->length = 0 ;
+  }
+
+  return result ;
+}
+
+static int husky_ngram_compare (const void * a, const void * b)
+{
+  const husky_ngram_entry_t * entry_a = (const husky_ngram_entry_t *)a ;
+  const husky_ngram_entry_t * entry_b = (const husky_ngram_entry_t *)b ;
+
+  if (entry_a->count != entry_b->count)
+    return entry_a->count < entry_b->count ? 1 : -1 ;
+
+  return entry_a->key < entry_b->key ? -1 : entry_a->key > entry_b->key ;
+}
+
+/* Prints the `count` most frequent sequences, most frequent first. */
+void husky_ngram_dump (husky_ngram_t * ngram, FILE * fileptr, u64_t count)
+{
+  husky_ngram_entry_t * entries = (husky_ngram_entry_t *)malloc(ngram->used * sizeof(husky_ngram_entry_t) + 1) ;
+  u64_t                 i ;
+  u64_t                 j = 0 ;
+
+  if (NULL == entries)
+    return ;
+
+  for (i = 0 ; i < ngram->size ; ++i) {
+    if (0 != ngram->table[i].key)
+      entries[j++] = ngram->table[i] ;
+  }
+
+  qsort(entries, j, sizeof(husky_ngram_entry_t), husky_ngram_compare) ;
+
+  if (count > j)
+    count = j ;
+
+  for (i = 0 ; i < count ; ++i) {
+    u64_t key  = entries[i].key ;
+    u32_t size = key >> 32 ;
+
+    fprintf(fileptr, "%12" PRIu64, entries[i].count) ;
+
+    while (0 != size--) {
+      const char * name = husky_inst_as_string((key >> (8 * size)) & 0xFF) ;
+
+      fprintf(fileptr, " %s", NULL == name ? "?" : name) ;
+    }
+
+    fprintf(fileptr, "\n") ;
+  }
+
+  free(entries) ;
+}
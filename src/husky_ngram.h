@@ -0,0 +1,17 @@
+#ifndef __HUSKY_NGRAM_H
+# define __HUSKY_NGRAM_H
+
+# include "husky.h"
+# include <stdio.h>
+
+# define HUSKY_NGRAM_SIZE_MIN 2
+# define HUSKY_NGRAM_SIZE_MAX 4
+
+typedef struct husky_ngram_s husky_ngram_t ;
+
+husky_ngram_t * husky_ngram_create (void) ;
+void husky_ngram_destroy (husky_ngram_t * ngram) ;
+u32_t husky_ngram_run (husky_t * husky, husky_ngram_t * ngram, u64_t max_steps) ;
+void husky_ngram_dump (husky_ngram_t * ngram, FILE * fileptr, u64_t count) ;
+
+#endif
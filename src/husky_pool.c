@@ -0,0 +1,350 @@
+#include "husky_pool.h"
+#include <pthread.h>
+#include <stdlib.h>
+#include <time.h>
+#include <unistd.h>
+
+/* Jobs run on a fixed set of threads, each with its own queue. A worker
+ * runs the job at the head of its queue for one quantum of steps and, if
+ * it has not ended, puts it back at the tail, so long jobs share the thread
+ * with short ones instead of holding it. A worker with an empty queue
+ * steals from the tail of another one before going to sleep. */
+
+typedef struct husky_queue_s  husky_queue_t  ;
+typedef struct husky_worker_s husky_worker_t ;
+
+struct husky_queue_s {
+  pthread_mutex_t lock  ;
+  husky_job_t **  jobs  ;
+  u64_t           size  ;
+  u64_t           head  ;
+  u64_t           count ;
+} ;
+
+struct husky_worker_s {
+  husky_pool_t *  pool   ;
+  husky_queue_t   queue  ;
+  pthread_t       thread ;
+  u32_t           index  ;
+} ;
+
+struct husky_pool_s {
+  pthread_mutex_t  lock    ;
+  pthread_cond_t   wake    ;
+  pthread_cond_t   done    ;
+  u64_t            queued  ;
+  u64_t            pending ;
+  u32_t            stop    ;
+  u32_t            next    ;
+  u64_t            quantum ;
+  u32_t            count   ;
+  u32_t            started ;
+  husky_worker_t * workers ;
+} ;
+
+static u64_t husky_pool_clock (void)
+{
+  struct timespec now ;
+
+  clock_gettime(CLOCK_MONOTONIC, &now) ;
+
+  return (u64_t)now.tv_sec * 1000000000 + now.tv_nsec ;
+}
+
+static u32_t husky_queue_push (husky_queue_t * queue, husky_job_t * job)
+{
+  pthread_mutex_lock(&queue->lock) ;
+
+  if (queue->count == queue->size) {
+    u64_t          size = 0 == queue->size ? 16 : queue->size << 1 ;
+    husky_job_t ** jobs = (husky_job_t **)malloc(size * sizeof(husky_job_t *)) ;
+    u64_t          i ;
+
+    if (NULL == jobs) {
+      pthread_mutex_unlock(&queue->lock) ;
+      return HUSKY_ERROR_OUT_OF_MEMORY ;
+    }
+
+    for (i = 0 ; i < queue->count ; ++i) {
+      jobs[i] = queue->jobs[(queue->head + i) % queue->size] ;
+    }
+
+    free(queue->jobs) ;
+
+    queue->jobs = jobs ;
+    queue->size = size ;
+    queue->head = 0 ;
+  }
+
+  queue->jobs[(queue->head + queue->count++) % queue->size] = job ;
+
+  pthread_mutex_unlock(&queue->lock) ;
+
+  return HUSKY_SUCCESS ;
+}
+
+/* The owner takes from the head and thieves from the tail. */
+static husky_job_t * husky_queue_pop (husky_queue_t * queue, u32_t steal)
+{
+  husky_job_t * job = NULL ;
+
+  pthread_mutex_lock(&queue->lock) ;
+
+  if (0 != queue->count) {
+    if (0 != steal) {
+      job = queue->jobs[(queue->head + --queue->count) % queue->size] ;
+    } else {
+      job = queue->jobs[queue->head] ;
+
+      queue->head = (queue->head + 1) % queue->size ;
+      --queue->count ;
+    }
+  }
+
+  pthread_mutex_unlock(&queue->lock) ;
+
+  return job ;
+}
+
+static husky_job_t * husky_pool_take (husky_worker_t * worker)
+{
+  husky_pool_t * pool = worker->pool ;
+  husky_job_t *  job  = husky_queue_pop(&worker->queue, 0) ;
+  u32_t          i ;
+
+  for (i = 1 ; NULL == job && i < pool->count ; ++i) {
+    job = husky_queue_pop(&pool->workers[(worker->index + i) % pool->count].queue, 1) ;
+  }
+
+  if (NULL != job) {
+    pthread_mutex_lock(&pool->lock) ;
+    --pool->queued ;
+    pthread_mutex_unlock(&pool->lock) ;
+  }
+
+  return job ;
+}
+
+static u32_t husky_pool_put (husky_pool_t * pool, husky_queue_t * queue, husky_job_t * job)
+{
+  if (HUSKY_SUCCESS != husky_queue_push(queue, job))
+    return HUSKY_ERROR_OUT_OF_MEMORY ;
+
+  pthread_mutex_lock(&pool->lock) ;
+  ++pool->queued ;
+  pthread_cond_signal(&pool->wake) ;
+  pthread_mutex_unlock(&pool->lock) ;
+
+  return HUSKY_SUCCESS ;
+}
+
+/* Sets up the instance of a job on its first quantum. */
+static u32_t husky_job_start (husky_job_t * job)
+{
+  husky_config_t config = job->config ;
+
+  job->start = husky_pool_clock() ;
+
+  if (0 == config.mem_size)
+    config.mem_size = HUSKY_MEMORY_SIZE_DEFAULT ;
+
+  config.mem_size += husky_args_size(job->argc, job->argv) ;
+
+  if (NULL == (job->husky = husky_create(&config)))
+    return HUSKY_ERROR_OUT_OF_MEMORY ;
+
+  if (HUSKY_SUCCESS != husky_image_load(job->husky, job->filename))
+    return HUSKY_FAILURE ;
+
+  return husky_args_push(job->husky, job->argc, job->argv) ;
+}
+
+static void husky_job_finish (husky_pool_t * pool, husky_job_t * job, u32_t result)
+{
+  job->time   = husky_pool_clock() - job->start ;
+  job->result = result ;
+
+  if (NULL != job->husky) {
+    job->steps    = job->husky->steps ;
+    job->state    = job->husky->state ;
+    job->err_code = job->husky->err_code ;
+
+    husky_destroy(job->husky) ;
+    job->husky = NULL ;
+  } else {
+    job->steps    = 0 ;
+    job->state    = HUSKY_STATE_HALTED ;
+    job->err_code = result ;
+  }
+
+  if (NULL != job->done_func)
+    job->done_func(job) ;
+
+  pthread_mutex_lock(&pool->lock) ;
+
+  if (0 == --pool->pending)
+    pthread_cond_broadcast(&pool->done) ;
+
+  pthread_mutex_unlock(&pool->lock) ;
+}
+
+static void * husky_pool_work (void * arg)
+{
+  husky_worker_t * worker = (husky_worker_t *)arg ;
+  husky_pool_t *   pool   = worker->pool ;
+
+  for (;;) {
+    husky_job_t * job = husky_pool_take(worker) ;
+
+    if (NULL == job) {
+      pthread_mutex_lock(&pool->lock) ;
+
+      while (0 == pool->queued && 0 == pool->stop) {
+        pthread_cond_wait(&pool->wake, &pool->lock) ;
+      }
+
+      u32_t stop = 0 == pool->queued && 0 != pool->stop ;
+
+      pthread_mutex_unlock(&pool->lock) ;
+
+      if (0 != stop)
+        break ;
+
+      continue ;
+    }
+
+    u32_t result = HUSKY_SUCCESS ;
+
+    if (NULL == job->husky)
+      result = husky_job_start(job) ;
+
+    if (HUSKY_SUCCESS == result)
+      result = husky_run(job->husky, pool->quantum) ;
+
+    if (HUSKY_SUCCESS != result || HUSKY_STATE_HALTED == husky_state_get(job->husky)) {
+      husky_job_finish(pool, job, result) ;
+      continue ;
+    }
+
+    if (HUSKY_SUCCESS != husky_pool_put(pool, &worker->queue, job))
+      husky_job_finish(pool, job, HUSKY_ERROR_OUT_OF_MEMORY) ;
+  }
+
+  return NULL ;
+}
+
+/* Returns a pool of `threads` workers, one per online processor when 0,
+ * that preempt jobs every `quantum` steps, or NULL on failure. */
+husky_pool_t * husky_pool_create (u32_t threads, u64_t quantum)
+{
+  husky_pool_t * pool = (husky_pool_t *)calloc(1, sizeof(husky_pool_t)) ;
+  u32_t          i ;
+
+  if (NULL == pool)
+    return NULL ;
+
+  if (0 == threads) {
+    long online = sysconf(_SC_NPROCESSORS_ONLN) ;
+
+    threads = 0 < online ? online : 1 ;
+  }
+
+  pool->quantum = 0 == quantum ? HUSKY_POOL_QUANTUM_DEFAULT : quantum ;
+  pool->workers = (husky_worker_t *)calloc(threads, sizeof(husky_worker_t)) ;
+
+  if (NULL == pool->workers) {
+    free(pool) ;
+    return NULL ;
+  }
+
+  pthread_mutex_init(&pool->lock, NULL) ;
+  pthread_cond_init(&pool->wake, NULL) ;
+  pthread_cond_init(&pool->done, NULL) ;
+
+  pool->count = threads ;
+
+  for (i = 0 ; i < threads ; ++i) {
+    husky_worker_t * worker = pool->workers + i ;
+
+    worker->pool  = pool ;
+    worker->index = i ;
+
+    pthread_mutex_init(&worker->queue.lock, NULL) ;
+  }
+
+  for (i = 0 ; i < threads ; ++i) {
+    if (0 != pthread_create(&pool->workers[i].thread, NULL, husky_pool_work, pool->workers + i))
+      break ;
+
+    pool->started = i + 1 ;
+  }
+
+  if (0 == pool->started) {
+    husky_pool_destroy(pool) ;
+    return NULL ;
+  }
+
+  return pool ;
+}
+
+/* Runs the jobs still queued to their end, then stops the workers. */
+void husky_pool_destroy (husky_pool_t * pool)
+{
+  u32_t i ;
+
+  if (NULL == pool)
+    return ;
+
+  pthread_mutex_lock(&pool->lock) ;
+  pool->stop = 1 ;
+  pthread_cond_broadcast(&pool->wake) ;
+  pthread_mutex_unlock(&pool->lock) ;
+
+  for (i = 0 ; i < pool->started ; ++i) {
+    pthread_join(pool->workers[i].thread, NULL) ;
+  }
+
+  for (i = 0 ; i < pool->count ; ++i) {
+    pthread_mutex_destroy(&pool->workers[i].queue.lock) ;
+    free(pool->workers[i].queue.jobs) ;
+  }
+
+  pthread_cond_destroy(&pool->done) ;
+  pthread_cond_destroy(&pool->wake) ;
+  pthread_mutex_destroy(&pool->lock) ;
+
+  free(pool->workers) ;
+  free(pool) ;
+}
+
+u32_t husky_pool_submit (husky_pool_t * pool, husky_job_t * job)
+{
+  job->husky = NULL ;
+
+  pthread_mutex_lock(&pool->lock) ;
+  ++pool->pending ;
+  u32_t next = pool->next++ % pool->count ;
+  pthread_mutex_unlock(&pool->lock) ;
+
+  if (HUSKY_SUCCESS != husky_pool_put(pool, &pool->workers[next].queue, job)) {
+    pthread_mutex_lock(&pool->lock) ;
+    --pool->pending ;
+    pthread_mutex_unlock(&pool->lock) ;
+
+    return HUSKY_ERROR_OUT_OF_MEMORY ;
+  }
+
+  return HUSKY_SUCCESS ;
+}
+
+/* Waits until every submitted job has ended. */
+void husky_pool_wait (husky_pool_t * pool)
+{
+  pthread_mutex_lock(&pool->lock) ;
+
+  while (0 != pool->pending) {
+    pthread_cond_wait(&pool->done, &pool->lock) ;
+  }
+
+  pthread_mutex_unlock(&pool->lock) ;
+}
@@ -0,0 +1,41 @@
+#ifndef __HUSKY_POOL_H
+# define __HUSKY_POOL_H
+
+# include "husky.h"
+
+# define HUSKY_POOL_QUANTUM_DEFAULT 100000
+
+typedef struct husky_job_s  husky_job_t  ;
+typedef struct husky_pool_s husky_pool_t ;
+
+/* A job runs the image at `filename` with `argv`, in an instance made from
+ * `config` with room added for the arguments. When it ends, `time` holds
+ * the nanoseconds from its first quantum to its end, `steps`, `state` and
+ * `err_code` those of the instance and `result` what the last call
+ * returned, and `done_func` is called on the worker that ran it. The pool
+ * does not touch the job after that, so `done_func` may free it. */
+struct husky_job_s {
+  husky_config_t config   ;
+  char *         filename ;
+  int            argc     ;
+  char **        argv     ;
+  ptr_t          ptr      ;
+
+  void ( * done_func ) (husky_job_t *) ;
+
+  u64_t          time     ;
+  u64_t          steps    ;
+  u32_t          state    ;
+  u32_t          err_code ;
+  u32_t          result   ;
+
+  husky_t *      husky    ;
+  u64_t          start    ;
+} ;
+
+husky_pool_t * husky_pool_create (u32_t threads, u64_t quantum) ;
+void husky_pool_destroy (husky_pool_t * pool) ;
+u32_t husky_pool_submit (husky_pool_t * pool, husky_job_t * job) ;
+void husky_pool_wait (husky_pool_t * pool) ;
+
+#endif
@@ -0,0 +1,413 @@
+#include "husky_profile.h"
+#include <stdlib.h>
+#include <string.h>
+#include <inttypes.h>
+
+/* Samples where a program spends its steps. The program runs in slices of
+ * about `interval` steps at full speed, and before each slice the profiler
+ * takes the `ip` about to run and the call stack above it, then charges
+ * the steps of the slice to them. Slice lengths are drawn at random around
+ * `interval`, so that a loop whose length divides it is not always caught
+ * at the same point; with an interval of 1 every step is its own sample
+ * and the counts are exact.
+ *
+ * The call stack is found by walking the `fp` chain that `ENTER` builds:
+ * below each frame lie the caller's `fp` and the return address of the
+ * call. Frames are named by the return addresses, the innermost by the
+ * sampled `ip`, and the walk stops at the `fp` of the first run, so code
+ * that does not use `ENTER` shows up as flat. */
+
+# define HUSKY_PROFILE_TABLE_SIZE 1024
+# define HUSKY_PROFILE_TRUNCATED  UINT64_MAX
+
+typedef struct husky_profile_entry_s husky_profile_entry_t ;
+typedef struct husky_profile_stack_s husky_profile_stack_t ;
+
+struct husky_profile_entry_s {
+  u64_t key   ;
+  u64_t count ;
+} ;
+
+struct husky_profile_stack_s {
+  u64_t hash   ;
+  u64_t count  ;
+  u64_t offset ;
+  u64_t depth  ;
+} ;
+
+struct husky_profile_s {
+  u64_t                   interval                             ;
+  u64_t                   random                               ;
+  u64_t                   floor                                ;
+  u64_t                   steps                                ;
+  u64_t                   samples                              ;
+  u64_t                   opcodes [HUSKY_N_INSTS + 1]          ;
+  husky_profile_entry_t * ips                                  ;
+  u64_t                   ip_size                              ;
+  u64_t                   ip_used                              ;
+  husky_profile_stack_t * stacks                               ;
+  u64_t                   stack_size                           ;
+  u64_t                   stack_used                           ;
+  u64_t *                 frames                               ;
+  u64_t                   frame_count                          ;
+  u64_t                   frame_size                           ;
+  u64_t                   sample [HUSKY_PROFILE_DEPTH_MAX + 1] ;
+  u64_t                   depth                                ;
+  u8_t                    opr_code                             ;
+} ;
+
+static u64_t husky_profile_hash (const u64_t * frames, u64_t depth)
+{
+  u64_t hash = 0xCBF29CE484222325ULL ;
+  u64_t i ;
+
+  for (i = 0 ; i < depth ; ++i)
+    hash = (hash ^ frames[i]) * 0x100000001B3ULL ;
+
+  return hash ;
+}
+
+/* Entries are empty while their count is 0, as every sample charges at
+ * least one step. */
+static husky_profile_entry_t * husky_profile_find_ip (husky_profile_entry_t * table, u64_t size, u64_t key)
+{
+  u64_t hash = (key * 0x9E3779B97F4A7C15ULL) >> 32 ;
+
+  for (;;) {
+    husky_profile_entry_t * entry = table + (hash & (size - 1)) ;
+
+    if (0 == entry->count || key == entry->key)
+      return entry ;
+
+    ++hash ;
+  }
+}
+
+static husky_profile_stack_t * husky_profile_find_stack (husky_profile_t * profile, husky_profile_stack_t * table, u64_t size, u64_t hash, const u64_t * frames, u64_t depth)
+{
+  u64_t slot = hash ;
+
+  for (;;) {
+    husky_profile_stack_t * stack = table + (slot & (size - 1)) ;
+
+    if (0 == stack->count)
+      return stack ;
+
+    if (hash == stack->hash && depth == stack->depth && 0 == memcmp(profile->frames + stack->offset, frames, depth * sizeof(u64_t)))
+      return stack ;
+
+    ++slot ;
+  }
+}
+
+static u32_t husky_profile_grow (husky_profile_t * profile)
+{
+  u64_t i ;
+
+  if (profile->ip_size <= (profile->ip_used + 1) << 1) {
+    u64_t                   size  = profile->ip_size << 1 ;
+    husky_profile_entry_t * table = (husky_profile_entry_t *)calloc(size, sizeof(husky_profile_entry_t)) ;
+
+    if (NULL == table)
+      return HUSKY_ERROR_OUT_OF_MEMORY ;
+
+    for (i = 0 ; i < profile->ip_size ; ++i) {
+      if (0 != profile->ips[i].count)
+        *husky_profile_find_ip(table, size, profile->ips[i].key) = profile->ips[i] ;
+    }
+
+    free(profile->ips) ;
+
+    profile->ips     = table ;
+    profile->ip_size = size ;
+  }
+
+  if (profile->stack_size <= (profile->stack_used + 1) << 1) {
+    u64_t                   size  = profile->stack_size << 1 ;
+    husky_profile_stack_t * table = (husky_profile_stack_t *)calloc(size, sizeof(husky_profile_stack_t)) ;
+
+    if (NULL == table)
+      return HUSKY_ERROR_OUT_OF_MEMORY ;
+
+    for (i = 0 ; i < profile->stack_size ; ++i) {
+      husky_profile_stack_t * stack = profile->stacks + i ;
+
+      if (0 != stack->count)
+        *husky_profile_find_stack(profile, table, size, stack->hash, profile->frames + stack->offset, stack->depth) = *stack ;
+    }
+
+    free(profile->stacks) ;
+
+    profile->stacks     = table ;
+    profile->stack_size = size ;
+  }
+
+  if (profile->frame_size - profile->frame_count < profile->depth) {
+    u64_t   size   = profile->frame_size << 1 ;
+    u64_t * frames = (u64_t *)realloc(profile->frames, size * sizeof(u64_t)) ;
+
+    if (NULL == frames)
+      return HUSKY_ERROR_OUT_OF_MEMORY ;
+
+    profile->frames     = frames ;
+    profile->frame_size = size ;
+  }
+
+  return HUSKY_SUCCESS ;
+}
+
+/* Takes the `ip`, its opcode and the call stack the next slice starts
+ * from. */
+static void husky_profile_sample (husky_t * husky, husky_profile_t * profile)
+{
+  u64_t fp = husky->fp ;
+
+  profile->opr_code = husky->ip < husky->mem_size ? husky->mem_data[husky->ip] : HUSKY_N_INSTS ;
+
+  if (HUSKY_N_INSTS < profile->opr_code)
+    profile->opr_code = HUSKY_N_INSTS ;
+
+  profile->depth = 0 ;
+  profile->sample[profile->depth++] = husky->ip ;
+
+  while (profile->floor < fp && 2 * sizeof(husky_object_t) <= fp && fp <= husky->mem_size) {
+    husky_object_t saved, ret ;
+
+    if (HUSKY_PROFILE_DEPTH_MAX == profile->depth) {
+      profile->sample[profile->depth++] = HUSKY_PROFILE_TRUNCATED ;
+      break ;
+    }
+
+    /* A frame the guest pointed at the guard page ends the walk. */
+    if (husky_memory_guarded(husky, fp - 2 * sizeof(husky_object_t), 2 * sizeof(husky_object_t)))
+      break ;
+
+    memcpy(&saved, husky->mem_data + fp - 1 * sizeof(husky_object_t), sizeof(husky_object_t)) ;
+    memcpy(&ret,   husky->mem_data + fp - 2 * sizeof(husky_object_t), sizeof(husky_object_t)) ;
+
+    profile->sample[profile->depth++] = ret.u ;
+
+    if (fp <= saved.u)
+      break ;
+
+    fp = saved.u ;
+  }
+}
+
+/* Charges `steps` to the sample taken before the slice that ran them. */
+static u32_t husky_profile_count (husky_profile_t * profile, u64_t steps)
+{
+  u64_t ip = profile->sample[0] ;
+
+  if (HUSKY_SUCCESS != husky_profile_grow(profile))
+    return HUSKY_ERROR_OUT_OF_MEMORY ;
+
+  profile->steps                      += steps ;
+  profile->opcodes[profile->opr_code] += steps ;
+  ++profile->samples ;
+
+  husky_profile_entry_t * entry = husky_profile_find_ip(profile->ips, profile->ip_size, ip) ;
+
+  if (0 == entry->count) {
+    entry->key = ip ;
+    ++profile->ip_used ;
+  }
+
+  entry->count += steps ;
+
+  u64_t                   hash  = husky_profile_hash(profile->sample, profile->depth) ;
+  husky_profile_stack_t * stack = husky_profile_find_stack(profile, profile->stacks, profile->stack_size, hash, profile->sample, profile->depth) ;
+
+  if (0 == stack->count) {
+    memcpy(profile->frames + profile->frame_count, profile->sample, profile->depth * sizeof(u64_t)) ;
+
+    stack->hash   = hash ;
+    stack->offset = profile->frame_count ;
+    stack->depth  = profile->depth ;
+
+    profile->frame_count += profile->depth ;
+    ++profile->stack_used ;
+  }
+
+  stack->count += steps ;
+
+  return HUSKY_SUCCESS ;
+}
+
+/* Draws the next slice length, uniform in [1, 2 * interval - 1]. */
+static u64_t husky_profile_slice (husky_profile_t * profile)
+{
+  if (profile->interval <= 1)
+    return 1 ;
+
+  profile->random ^= profile->random << 13 ;
+  profile->random ^= profile->random >> 7 ;
+  profile->random ^= profile->random << 17 ;
+
+  return 1 + profile->random % (2 * profile->interval - 1) ;
+}
+
+husky_profile_t * husky_profile_create (u64_t interval)
+{
+  husky_profile_t * profile = (husky_profile_t *)calloc(1, sizeof(husky_profile_t)) ;
+
+  if (NULL == profile)
+    return NULL ;
+
+  profile->interval   = 0 == interval ? HUSKY_PROFILE_INTERVAL_DEFAULT : interval ;
+  profile->random     = 0x9E3779B97F4A7C15ULL ;
+  profile->floor      = UINT64_MAX ;
+  profile->ip_size    = HUSKY_PROFILE_TABLE_SIZE ;
+  profile->stack_size = HUSKY_PROFILE_TABLE_SIZE ;
+  profile->frame_size = HUSKY_PROFILE_TABLE_SIZE * 4 ;
+  profile->ips        = (husky_profile_entry_t *)calloc(profile->ip_size, sizeof(husky_profile_entry_t)) ;
+  profile->stacks     = (husky_profile_stack_t *)calloc(profile->stack_size, sizeof(husky_profile_stack_t)) ;
+  profile->frames     = (u64_t *)malloc(profile->frame_size * sizeof(u64_t)) ;
+
+  if (NULL == profile->ips || NULL == profile->stacks || NULL == profile->frames) {
+    husky_profile_destroy(profile) ;
+    return NULL ;
+  }
+
+  return profile ;
+}
+
+void husky_profile_destroy (husky_profile_t * profile)
+{
+  if (NULL == profile)
+    return ;
+
+  free(profile->ips) ;
+  free(profile->stacks) ;
+  free(profile->frames) ;
+  free(profile) ;
+}
+
+/* Runs like `husky_run`, in slices, sampling before each one. */
+u32_t husky_profile_run (husky_t * husky, husky_profile_t * profile, u64_t max_steps)
+{
+  if (HUSKY_STATE_HALTED == husky->state)
+    return husky_error_get(husky) ;
+
+  husky->state = HUSKY_STATE_READY ;
+
+  if (UINT64_MAX == profile->floor)
+    profile->floor = husky->fp ;
+
+  u32_t result = HUSKY_SUCCESS ;
+
+  while (0 != max_steps && HUSKY_STATE_READY == husky->state) {
+    u64_t slice = husky_profile_slice(profile) ;
+    u64_t steps = husky->steps ;
+
+    if (slice > max_steps)
+      slice = max_steps ;
+
+    husky_profile_sample(husky, profile) ;
+
+    result     = husky_run(husky, slice) ;
+    steps      = husky->steps - steps ;
+    max_steps -= slice ;
+
+    if (0 != steps && HUSKY_SUCCESS != husky_profile_count(profile, steps))
+      return husky_error_set(husky, HUSKY_ERROR_OUT_OF_MEMORY) ;
+
+    if (HUSKY_SUCCESS != result)
+      break ;
+  }
+
+  return result ;
+}
+
+static int husky_profile_compare (const void * a, const void * b)
+{
+  const husky_profile_entry_t * entry_a = (const husky_profile_entry_t *)a ;
+  const husky_profile_entry_t * entry_b = (const husky_profile_entry_t *)b ;
+
+  if (entry_a->count != entry_b->count)
+    return entry_a->count < entry_b->count ? 1 : -1 ;
+
+  return entry_a->key < entry_b->key ? -1 : entry_a->key > entry_b->key ;
+}
+
+static void husky_profile_line (husky_profile_t * profile, FILE * fileptr, u64_t count)
+{
+  fprintf(fileptr, "%12" PRIu64 " %6.2f%% ", count, 100.0 * count / profile->steps) ;
+}
+
+/* Prints the steps charged to each opcode and to the `count` hottest
+ * addresses, most first. */
+void husky_profile_dump (husky_profile_t * profile, FILE * fileptr, u64_t count)
+{
+  husky_profile_entry_t   opcodes [HUSKY_N_INSTS + 1] ;
+  husky_profile_entry_t * entries = (husky_profile_entry_t *)malloc(profile->ip_used * sizeof(husky_profile_entry_t) + 1) ;
+  u64_t                   i ;
+  u64_t                   j = 0 ;
+
+  if (NULL == entries)
+    return ;
+
+  fprintf(fileptr, "Profile: %" PRIu64 " steps in %" PRIu64 " samples.\n", profile->steps, profile->samples) ;
+
+  for (i = 0 ; i <= HUSKY_N_INSTS ; ++i) {
+    opcodes[i].key   = i ;
+    opcodes[i].count = profile->opcodes[i] ;
+  }
+
+  qsort(opcodes, HUSKY_N_INSTS + 1, sizeof(husky_profile_entry_t), husky_profile_compare) ;
+
+  for (i = 0 ; i <= HUSKY_N_INSTS && 0 != opcodes[i].count ; ++i) {
+    const char * name = husky_inst_as_string(opcodes[i].key) ;
+
+    husky_profile_line(profile, fileptr, opcodes[i].count) ;
+    fprintf(fileptr, "%s\n", NULL == name ? "?" : name) ;
+  }
+
+  for (i = 0 ; i < profile->ip_size ; ++i) {
+    if (0 != profile->ips[i].count)
+      entries[j++] = profile->ips[i] ;
+  }
+
+  qsort(entries, j, sizeof(husky_profile_entry_t), husky_profile_compare) ;
+
+  if (count > j)
+    count = j ;
+
+  for (i = 0 ; i < count ; ++i) {
+    husky_profile_line(profile, fileptr, entries[i].count) ;
+    fprintf(fileptr, "0x%012" PRIX64 "\n", entries[i].key) ;
+  }
+
+  free(entries) ;
+}
+
+/* Writes one line per call stack in the folded format of `flamegraph.pl`
+ * and most other flame graph tools: the frames from the outermost in,
+ * separated by `;`, and the steps charged to the stack. */
+void husky_profile_fold (husky_profile_t * profile, FILE * fileptr)
+{
+  u64_t i ;
+
+  for (i = 0 ; i < profile->stack_size ; ++i) {
+    husky_profile_stack_t * stack  = profile->stacks + i ;
+    const u64_t *           frames = profile->frames + stack->offset ;
+    u64_t                   depth  = stack->depth ;
+
+    if (0 == stack->count)
+      continue ;
+
+    while (0 != depth--) {
+      if (HUSKY_PROFILE_TRUNCATED == frames[depth]) {
+        fprintf(fileptr, "[truncated]") ;
+      } else {
+        fprintf(fileptr, "0x%012" PRIX64, frames[depth]) ;
+      }
+
+      if (0 != depth) {
+        fprintf(fileptr, ";") ;
+      } else {
+        fprintf(fileptr, " %" PRIu64 "\n", stack->count) ;
+      }
+    }
+  }
+}
@@ -0,0 +1,18 @@
+#ifndef __HUSKY_PROFILE_H
+# define __HUSKY_PROFILE_H
+
+# include "husky.h"
+# include <stdio.h>
+
+# define HUSKY_PROFILE_INTERVAL_DEFAULT 10000
+# define HUSKY_PROFILE_DEPTH_MAX        128
+
+typedef struct husky_profile_s husky_profile_t ;
+
+husky_profile_t * husky_profile_create (u64_t interval) ;
+void husky_profile_destroy (husky_profile_t * profile) ;
+u32_t husky_profile_run (husky_t * husky, husky_profile_t * profile, u64_t max_steps) ;
+void husky_profile_dump (husky_profile_t * profile, FILE * fileptr, u64_t count) ;
+void husky_profile_fold (husky_profile_t * profile, FILE * fileptr) ;
+
+#endif
@@ -0,0 +1,215 @@
+#include "husky_vector.h"
+#include <string.h>
+
+#if (defined(__GNUC__) || defined(__clang__)) && defined(__x86_64__) && !defined(HUSKY_NO_SIMD)
+# define HUSKY_VECTOR_X86
+#endif
+
+/* The kernels are written once against a vector type `__vector` of
+ * `__lane` elements and built for each instruction set; the plain build
+ * uses the lane type itself as its vector. Lanes are loaded with `memcpy`,
+ * so guest arrays need no alignment, and what does not fill a whole vector
+ * is done one lane at a time. Operations are passed around by name, so the
+ * same one can be expanded for vectors and for single lanes. */
+
+#define _SCALAR_MASK(__lane, __type, __expr) ((__type)((__lane)0 - (__lane)(__expr)))
+#define _VECTOR_MASK(__lane, __type, __expr) ((__type)(__expr))
+
+#define _ADD(__lane, __type, __mask, __x, __y) ((__x) + (__y))
+#define _SUB(__lane, __type, __mask, __x, __y) ((__x) - (__y))
+#define _MUL(__lane, __type, __mask, __x, __y) ((__x) * (__y))
+#define _AND(__lane, __type, __mask, __x, __y) ((__x) & (__y))
+#define _ORR(__lane, __type, __mask, __x, __y) ((__x) | (__y))
+#define _XOR(__lane, __type, __mask, __x, __y) ((__x) ^ (__y))
+#define _IEQ(__lane, __type, __mask, __x, __y) __mask(__lane, __type, (__x) == (__y))
+#define _INE(__lane, __type, __mask, __x, __y) __mask(__lane, __type, (__x) != (__y))
+#define _ILS(__lane, __type, __mask, __x, __y) __mask(__lane, __type, (__x) <  (__y))
+#define _IGT(__lane, __type, __mask, __x, __y) __mask(__lane, __type, (__x) >  (__y))
+#define _MIN(__lane, __type, __mask, __x, __y) (((__y) & _ILS(__lane, __type, __mask, __y, __x)) | ((__x) & ~_ILS(__lane, __type, __mask, __y, __x)))
+#define _MAX(__lane, __type, __mask, __x, __y) (((__y) & _IGT(__lane, __type, __mask, __y, __x)) | ((__x) & ~_IGT(__lane, __type, __mask, __y, __x)))
+
+#define _MAP_LOOP(__lane, __vector, __mask, __op)                       \
+  {                                                                     \
+    const u64_t step = sizeof(__vector) / sizeof(__lane) ;              \
+    u64_t       i    = 0 ;                                              \
+                                                                        \
+    for (; step <= count - i ; i += step) {                             \
+      __vector x, y, z ;                                                \
+                                                                        \
+      memcpy(&x, src_0 + i * sizeof(__lane), sizeof(__vector)) ;        \
+      memcpy(&y, src_1 + i * sizeof(__lane), sizeof(__vector)) ;        \
+      z = (__vector)__op(__lane, __vector, __mask, x, y) ;              \
+      memcpy(dst + i * sizeof(__lane), &z, sizeof(__vector)) ;          \
+    }                                                                   \
+                                                                        \
+    for (; i < count ; ++i) {                                           \
+      __lane x, y, z ;                                                  \
+                                                                        \
+      memcpy(&x, src_0 + i * sizeof(__lane), sizeof(__lane)) ;          \
+      memcpy(&y, src_1 + i * sizeof(__lane), sizeof(__lane)) ;          \
+      z = (__lane)__op(__lane, __lane, _SCALAR_MASK, x, y) ;            \
+      memcpy(dst + i * sizeof(__lane), &z, sizeof(__lane)) ;            \
+    }                                                                   \
+  }
+
+/* Folds whole vectors lane-wise first, then their lanes and the rest of
+ * the array one by one. `__ones` tells whether the identity of the
+ * operation is all ones rather than zero. */
+#define _REDUCE_LOOP(__lane, __vector, __mask, __op, __ones)            \
+  {                                                                     \
+    const u64_t step = sizeof(__vector) / sizeof(__lane) ;              \
+    u64_t       i    = 0 ;                                              \
+    __vector    x ;                                                     \
+    __lane      y ;                                                     \
+    u64_t       j ;                                                     \
+    __lane      lanes [sizeof(__vector) / sizeof(__lane)] ;             \
+                                                                        \
+    memset(&x, __ones ? 0xFF : 0x00, sizeof(__vector)) ;                \
+    memset(&y, __ones ? 0xFF : 0x00, sizeof(__lane)) ;                  \
+                                                                        \
+    for (; step <= count - i ; i += step) {                             \
+      __vector z ;                                                      \
+                                                                        \
+      memcpy(&z, src + i * sizeof(__lane), sizeof(__vector)) ;          \
+      x = (__vector)__op(__lane, __vector, __mask, x, z) ;              \
+    }                                                                   \
+                                                                        \
+    memcpy(lanes, &x, sizeof(__vector)) ;                               \
+                                                                        \
+    for (j = 0 ; j < step ; ++j) {                                      \
+      y = (__lane)__op(__lane, __lane, _SCALAR_MASK, y, lanes[j]) ;     \
+    }                                                                   \
+                                                                        \
+    for (; i < count ; ++i) {                                           \
+      __lane z ;                                                        \
+                                                                        \
+      memcpy(&z, src + i * sizeof(__lane), sizeof(__lane)) ;            \
+      y = (__lane)__op(__lane, __lane, _SCALAR_MASK, y, z) ;            \
+    }                                                                   \
+                                                                        \
+    *result = y ;                                                       \
+  }
+
+#define _KERNELS(__name, __attr, __lane, __vector, __mask)                                                        \
+  __attr static void husky_vector_map_##__name (u8_t * dst, const u8_t * src_0, const u8_t * src_1, u64_t count, u32_t op) \
+  {                                                                                                               \
+    switch (op) {                                                                                                 \
+    case HUSKY_VECTOR_ADD          : _MAP_LOOP(__lane, __vector, __mask, _ADD) ; break ;                         \
+    case HUSKY_VECTOR_SUBTRACT     : _MAP_LOOP(__lane, __vector, __mask, _SUB) ; break ;                         \
+    case HUSKY_VECTOR_MULTIPLY     : _MAP_LOOP(__lane, __vector, __mask, _MUL) ; break ;                         \
+    case HUSKY_VECTOR_BIT_AND      : _MAP_LOOP(__lane, __vector, __mask, _AND) ; break ;                         \
+    case HUSKY_VECTOR_BIT_OR       : _MAP_LOOP(__lane, __vector, __mask, _ORR) ; break ;                         \
+    case HUSKY_VECTOR_BIT_XOR      : _MAP_LOOP(__lane, __vector, __mask, _XOR) ; break ;                         \
+    case HUSKY_VECTOR_IS_EQUAL     : _MAP_LOOP(__lane, __vector, __mask, _IEQ) ; break ;                         \
+    case HUSKY_VECTOR_IS_NOT_EQUAL : _MAP_LOOP(__lane, __vector, __mask, _INE) ; break ;                         \
+    case HUSKY_VECTOR_IS_LESS      : _MAP_LOOP(__lane, __vector, __mask, _ILS) ; break ;                         \
+    case HUSKY_VECTOR_IS_GREATER   : _MAP_LOOP(__lane, __vector, __mask, _IGT) ; break ;                         \
+    default                        : break ;                                                                     \
+    }                                                                                                             \
+  }                                                                                                               \
+                                                                                                                  \
+  __attr static void husky_vector_reduce_##__name (const u8_t * src, u64_t count, u32_t op, u64_t * result)        \
+  {                                                                                                               \
+    switch (op) {                                                                                                 \
+    case HUSKY_REDUCE_ADD     : _REDUCE_LOOP(__lane, __vector, __mask, _ADD, 0) ; break ;                        \
+    case HUSKY_REDUCE_BIT_AND : _REDUCE_LOOP(__lane, __vector, __mask, _AND, 1) ; break ;                        \
+    case HUSKY_REDUCE_BIT_OR  : _REDUCE_LOOP(__lane, __vector, __mask, _ORR, 0) ; break ;                        \
+    case HUSKY_REDUCE_BIT_XOR : _REDUCE_LOOP(__lane, __vector, __mask, _XOR, 0) ; break ;                        \
+    case HUSKY_REDUCE_MINIMUM : _REDUCE_LOOP(__lane, __vector, __mask, _MIN, 1) ; break ;                        \
+    case HUSKY_REDUCE_MAXIMUM : _REDUCE_LOOP(__lane, __vector, __mask, _MAX, 0) ; break ;                        \
+    default                   : break ;                                                                          \
+    }                                                                                                             \
+  }
+
+typedef void ( * husky_vector_map_t ) (u8_t *, const u8_t *, const u8_t *, u64_t, u32_t) ;
+typedef void ( * husky_vector_reduce_t ) (const u8_t *, u64_t, u32_t, u64_t *) ;
+
+#ifdef HUSKY_VECTOR_X86
+
+typedef u8_t  husky_v16_u8_t  __attribute__ (( vector_size(16) )) ;
+typedef u16_t husky_v16_u16_t __attribute__ (( vector_size(16) )) ;
+typedef u32_t husky_v16_u32_t __attribute__ (( vector_size(16) )) ;
+typedef u64_t husky_v16_u64_t __attribute__ (( vector_size(16) )) ;
+typedef u8_t  husky_v32_u8_t  __attribute__ (( vector_size(32) )) ;
+typedef u16_t husky_v32_u16_t __attribute__ (( vector_size(32) )) ;
+typedef u32_t husky_v32_u32_t __attribute__ (( vector_size(32) )) ;
+typedef u64_t husky_v32_u64_t __attribute__ (( vector_size(32) )) ;
+
+# define _SSE2 __attribute__ (( target("sse2") ))
+# define _AVX2 __attribute__ (( target("avx2") ))
+
+_KERNELS( sse2_8  , _SSE2 , u8_t  , husky_v16_u8_t  , _VECTOR_MASK )
+_KERNELS( sse2_16 , _SSE2 , u16_t , husky_v16_u16_t , _VECTOR_MASK )
+_KERNELS( sse2_32 , _SSE2 , u32_t , husky_v16_u32_t , _VECTOR_MASK )
+_KERNELS( sse2_64 , _SSE2 , u64_t , husky_v16_u64_t , _VECTOR_MASK )
+_KERNELS( avx2_8  , _AVX2 , u8_t  , husky_v32_u8_t  , _VECTOR_MASK )
+_KERNELS( avx2_16 , _AVX2 , u16_t , husky_v32_u16_t , _VECTOR_MASK )
+_KERNELS( avx2_32 , _AVX2 , u32_t , husky_v32_u32_t , _VECTOR_MASK )
+_KERNELS( avx2_64 , _AVX2 , u64_t , husky_v32_u64_t , _VECTOR_MASK )
+
+static const husky_vector_map_t husky_vector_maps [2][HUSKY_N_LANES] = {
+  { husky_vector_map_sse2_8 , husky_vector_map_sse2_16 , husky_vector_map_sse2_32 , husky_vector_map_sse2_64 } ,
+  { husky_vector_map_avx2_8 , husky_vector_map_avx2_16 , husky_vector_map_avx2_32 , husky_vector_map_avx2_64 }
+} ;
+
+static const husky_vector_reduce_t husky_vector_reduces [2][HUSKY_N_LANES] = {
+  { husky_vector_reduce_sse2_8 , husky_vector_reduce_sse2_16 , husky_vector_reduce_sse2_32 , husky_vector_reduce_sse2_64 } ,
+  { husky_vector_reduce_avx2_8 , husky_vector_reduce_avx2_16 , husky_vector_reduce_avx2_32 , husky_vector_reduce_avx2_64 }
+} ;
+
+/* The feature bits are read once by the compiler runtime at startup. */
+# define _ISA() (__builtin_cpu_supports("avx2") ? 1 : 0)
+
+#else
+
+_KERNELS( plain_8  , , u8_t  , u8_t  , _SCALAR_MASK )
+_KERNELS( plain_16 , , u16_t , u16_t , _SCALAR_MASK )
+_KERNELS( plain_32 , , u32_t , u32_t , _SCALAR_MASK )
+_KERNELS( plain_64 , , u64_t , u64_t , _SCALAR_MASK )
+
+static const husky_vector_map_t husky_vector_maps [1][HUSKY_N_LANES] = {
+  { husky_vector_map_plain_8 , husky_vector_map_plain_16 , husky_vector_map_plain_32 , husky_vector_map_plain_64 }
+} ;
+
+static const husky_vector_reduce_t husky_vector_reduces [1][HUSKY_N_LANES] = {
+  { husky_vector_reduce_plain_8 , husky_vector_reduce_plain_16 , husky_vector_reduce_plain_32 , husky_vector_reduce_plain_64 }
+} ;
+
+# define _ISA() 0
+
+#endif
+
+/* Whether `[a, a + size)` and `[b, b + size)` overlap without being the
+ * same array. */
+static int husky_vector_overlap (const u8_t * a, const u8_t * b, u64_t size)
+{
+  return a != b && a < b + size && b < a + size ;
+}
+
+/* `dst[i] = src_0[i] op src_1[i]` for `count` lanes. The destination may be
+ * either source, but one it only partly overlaps is an invalid address:
+ * each kernel would read lanes it has already written at another point. */
+u32_t husky_vector_map (u8_t * dst, const u8_t * src_0, const u8_t * src_1, u64_t count, u8_t mode)
+{
+  u64_t size = count << (mode & 3) ;
+
+  if (HUSKY_N_VECTORS <= mode >> 2)
+    return HUSKY_ERROR_UNDEFINED_INST ;
+
+  if (husky_vector_overlap(dst, src_0, size) || husky_vector_overlap(dst, src_1, size))
+    return HUSKY_ERROR_INVALID_ADDRESS ;
+
+  husky_vector_maps[_ISA()][mode & 3](dst, src_0, src_1, count, mode >> 2) ;
+
+  return HUSKY_SUCCESS ;
+}
+
+u32_t husky_vector_reduce (const u8_t * src, u64_t count, u8_t mode, u64_t * result)
+{
+  if (HUSKY_N_REDUCES <= mode >> 2)
+    return HUSKY_ERROR_UNDEFINED_INST ;
+
+  husky_vector_reduces[_ISA()][mode & 3](src, count, mode >> 2, result) ;
+
+  return HUSKY_SUCCESS ;
+}
@@ -0,0 +1,59 @@
+#ifndef __HUSKY_VECTOR_H
+# define __HUSKY_VECTOR_H
+
+# include "husky.h"
+
+/* `VECTOR` and `VECTOR_REDUCE` work on arrays of `count` lanes of 8, 16, 32
+ * or 64 bits in guest memory. Their operand byte holds the operation in
+ * its upper six bits and the log2 of the lane size in bytes in its lower
+ * two, see `HUSKY_VECTOR_MODE`. Arithmetic wraps at the lane size,
+ * comparisons are unsigned and give all ones for true, and reductions fold
+ * with the lane operation, so their result wraps at the lane size too.
+ * The destination of `VECTOR` may be one of its sources, but partly
+ * overlapping one raises `HUSKY_ERROR_INVALID_ADDRESS`.
+ *
+ * On x86-64 the kernels come in SSE2 and AVX2 builds and the AVX2 one is
+ * used when the processor has it; elsewhere, or with `HUSKY_NO_SIMD`
+ * defined, they are plain loops. */
+
+# define HUSKY_VECTOR_MODE(__op, __lane) (((__op) << 2) | (__lane))
+
+enum {
+  HUSKY_VECTOR_8  ,
+  HUSKY_VECTOR_16 ,
+  HUSKY_VECTOR_32 ,
+  HUSKY_VECTOR_64 ,
+
+  HUSKY_N_LANES
+} ;
+
+enum {
+  HUSKY_VECTOR_ADD          ,
+  HUSKY_VECTOR_SUBTRACT     ,
+  HUSKY_VECTOR_MULTIPLY     ,
+  HUSKY_VECTOR_BIT_AND      ,
+  HUSKY_VECTOR_BIT_OR       ,
+  HUSKY_VECTOR_BIT_XOR      ,
+  HUSKY_VECTOR_IS_EQUAL     ,
+  HUSKY_VECTOR_IS_NOT_EQUAL ,
+  HUSKY_VECTOR_IS_LESS      ,
+  HUSKY_VECTOR_IS_GREATER   ,
+
+  HUSKY_N_VECTORS
+} ;
+
+enum {
+  HUSKY_REDUCE_ADD     ,
+  HUSKY_REDUCE_BIT_AND ,
+  HUSKY_REDUCE_BIT_OR  ,
+  HUSKY_REDUCE_BIT_XOR ,
+  HUSKY_REDUCE_MINIMUM ,
+  HUSKY_REDUCE_MAXIMUM ,
+
+  HUSKY_N_REDUCES
+} ;
+
+u32_t husky_vector_map (u8_t * dst, const u8_t * src_0, const u8_t * src_1, u64_t count, u8_t mode) ;
+u32_t husky_vector_reduce (const u8_t * src, u64_t count, u8_t mode, u64_t * result) ;
+
+#endif